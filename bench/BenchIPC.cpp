@@ -0,0 +1,290 @@
+/**
+ * @file BenchIPC.cpp
+ * @brief Microbenchmarks for the shared memory IPC layer (s2sgeo_ipc_bench)
+ *
+ * Single-threaded benchmarks take the ring capacity as their argument so
+ * ring layouts can be compared; each reports p50/p99/p999 in TSC cycles
+ * sampled per operation (x86 only). The cross-process benchmark forks
+ * 1, 4 or 16 readers and reports publish-to-read latency percentiles in ns.
+ */
+
+#include "IPCManager.hpp"
+#include "IPCReader.hpp"
+#include "IPCWriter.hpp"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace s2sgeo;
+
+namespace {
+
+SharedMemoryManager& benchSegment() {
+    return SharedMemoryManager::getInstance("bench");
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(nowNs());
+#endif
+}
+
+/**
+ * @brief Nearest-rank percentile of `samples` (sorted in place)
+ */
+uint64_t percentile(std::vector<uint64_t>& samples, double q) {
+    if (samples.empty()) return 0;
+    size_t rank = static_cast<size_t>(q * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+void reportPercentiles(benchmark::State& state, std::vector<uint64_t>& samples, const char* unit) {
+    std::string suffix = std::string("_") + unit;
+    state.counters["p50" + suffix] = static_cast<double>(percentile(samples, 0.50));
+    state.counters["p99" + suffix] = static_cast<double>(percentile(samples, 0.99));
+    state.counters["p999" + suffix] = static_cast<double>(percentile(samples, 0.999));
+}
+
+/**
+ * @brief Per-operation cycle samples, bounded so long runs stay cheap
+ */
+class CycleSampler {
+public:
+    static constexpr size_t MAX_SAMPLES = 1 << 20;
+    
+    CycleSampler() { samples_.reserve(MAX_SAMPLES); }
+    
+    template <typename Op>
+    void measure(Op&& op) {
+        uint64_t start = cycles();
+        op();
+        uint64_t elapsed = cycles() - start;
+        if (samples_.size() < MAX_SAMPLES) samples_.push_back(elapsed);
+        total_ += elapsed;
+        count_++;
+    }
+    
+    void report(benchmark::State& state) {
+        state.counters["cycles_per_op"] = count_ ? static_cast<double>(total_) / count_ : 0.0;
+        reportPercentiles(state, samples_, "cycles");
+    }
+    
+private:
+    std::vector<uint64_t> samples_;
+    uint64_t total_ = 0;
+    uint64_t count_ = 0;
+};
+
+bool setUpSegment(benchmark::State& state, uint32_t ring_capacity) {
+    SharedMemoryOptions options;
+    options.ring_capacity = ring_capacity;
+    if (!benchSegment().initializeServer(options)) {
+        state.SkipWithError("Cannot create the shared memory segment");
+        return false;
+    }
+    IPCWriter::signalAlive(benchSegment());
+    return true;
+}
+
+WorldState sampleState(uint32_t k) {
+    WorldState state{};
+    state.smoothed_lat = 37.7749 + k * 1e-6;
+    state.smoothed_lon = -122.4194;
+    state.s2_cell_id = 0x808580000000000ULL;
+    state.s2_cell_level = 16;
+    state.step_count = k;
+    state.last_update_ms = k;
+    return state;
+}
+
+void BM_WriteState(benchmark::State& state) {
+    if (!setUpSegment(state, static_cast<uint32_t>(state.range(0)))) return;
+    
+    // Unchanged context: the common 10 Hz case, deduplicated against the slab
+    ContextFrame context{};
+    std::strcpy(context.road_name, "Market Street");
+    CycleSampler sampler;
+    uint32_t k = 0;
+    for (auto _ : state) {
+        WorldState world = sampleState(++k);
+        sampler.measure([&] { IPCWriter::writeState(world, context, benchSegment()); });
+    }
+    sampler.report(state);
+    state.SetItemsProcessed(state.iterations());
+    benchSegment().cleanup();
+}
+
+void BM_UpdateLocation(benchmark::State& state) {
+    if (!setUpSegment(state, static_cast<uint32_t>(state.range(0)))) return;
+    IPCWriter::writeState(sampleState(0), ContextFrame{}, benchSegment());
+    
+    CycleSampler sampler;
+    uint32_t k = 0;
+    for (auto _ : state) {
+        ++k;
+        sampler.measure([&] {
+            IPCWriter::updateLocation(37.7749 + k * 1e-6, -122.4194, 50.0, k, benchSegment());
+        });
+    }
+    sampler.report(state);
+    state.SetItemsProcessed(state.iterations());
+    benchSegment().cleanup();
+}
+
+void BM_ReadLatestState(benchmark::State& state) {
+    if (!setUpSegment(state, static_cast<uint32_t>(state.range(0)))) return;
+    ContextFrame context{};
+    std::strcpy(context.road_name, "Market Street");
+    IPCWriter::writeState(sampleState(1), context, benchSegment());
+    
+    WorldState world;
+    ContextFrame read_context;
+    CycleSampler sampler;
+    for (auto _ : state) {
+        sampler.measure([&] {
+            benchmark::DoNotOptimize(IPCReader::readLatestState(world, read_context, benchSegment()));
+        });
+    }
+    sampler.report(state);
+    state.SetItemsProcessed(state.iterations());
+    benchSegment().cleanup();
+}
+
+void BM_ReadLatestPosition(benchmark::State& state) {
+    if (!setUpSegment(state, static_cast<uint32_t>(state.range(0)))) return;
+    IPCWriter::writeState(sampleState(1), ContextFrame{}, benchSegment());
+    IPCWriter::updateLocation(37.7750, -122.4194, 50.0, 2, benchSegment());
+    
+    PositionData position;
+    CycleSampler sampler;
+    for (auto _ : state) {
+        sampler.measure([&] {
+            benchmark::DoNotOptimize(IPCReader::readLatestPosition(position, nullptr, benchSegment()));
+        });
+    }
+    sampler.report(state);
+    state.SetItemsProcessed(state.iterations());
+    benchSegment().cleanup();
+}
+
+/**
+ * @struct CrossProcessShared
+ * @brief Anonymous shared mapping between the benchmark and its reader processes
+ */
+struct CrossProcessShared {
+    static constexpr size_t MAX_READERS = 16;
+    static constexpr size_t MAX_SAMPLES = 1 << 16;  // Per reader
+    
+    struct alignas(64) Reader {
+        std::atomic<uint64_t> seen;     // Newest sequence this reader has read
+        std::atomic<uint64_t> samples;  // Latencies recorded so far
+    };
+    
+    std::atomic<bool> stop;
+    Reader readers[MAX_READERS];
+    uint64_t latency_ns[MAX_READERS][MAX_SAMPLES];
+};
+
+[[noreturn]] void runReader(CrossProcessShared* shared, size_t index) {
+    auto& mgr = benchSegment();
+    auto& self = shared->readers[index];
+    uint64_t last = 0;
+    while (!shared->stop.load(std::memory_order_acquire)) {
+        if (!IPCReader::waitForUpdate(last, std::chrono::milliseconds(10), mgr)) continue;
+        
+        PositionData position;
+        uint64_t sequence = 0;
+        if (!IPCReader::readLatestPosition(position, &sequence, mgr)) continue;
+        
+        // last_update_ms carries the writer's steady_clock timestamp in ns
+        uint64_t n = self.samples.load(std::memory_order_relaxed);
+        shared->latency_ns[index][n % CrossProcessShared::MAX_SAMPLES] =
+            static_cast<uint64_t>(nowNs() - position.last_update_ms);
+        self.samples.store(n + 1, std::memory_order_relaxed);
+        self.seen.store(sequence, std::memory_order_release);
+        last = sequence;
+    }
+    _exit(0);
+}
+
+void BM_CrossProcessPublish(benchmark::State& state) {
+    size_t reader_count = static_cast<size_t>(state.range(0));
+    if (!setUpSegment(state, SharedMemoryHeader::RING_BUFFER_SIZE)) return;
+    
+    void* memory = mmap(nullptr, sizeof(CrossProcessShared), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        state.SkipWithError("Cannot map the reader sample area");
+        benchSegment().cleanup();
+        return;
+    }
+    auto* shared = new (memory) CrossProcessShared();
+    
+    std::vector<pid_t> readers;
+    for (size_t i = 0; i < reader_count; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) runReader(shared, i);
+        if (pid > 0) readers.push_back(pid);
+    }
+    
+    // One iteration = publish, then wait until every reader has read it
+    uint32_t k = 0;
+    for (auto _ : state) {
+        WorldState world = sampleState(++k);
+        world.last_update_ms = nowNs();
+        IPCWriter::writePosition(world, benchSegment());
+        uint64_t sequence = IPCReader::latestSequence(benchSegment());
+        for (size_t i = 0; i < readers.size(); ++i) {
+            while (shared->readers[i].seen.load(std::memory_order_acquire) < sequence) {
+                sched_yield();
+            }
+        }
+    }
+    
+    shared->stop.store(true, std::memory_order_release);
+    for (pid_t pid : readers) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+    }
+    
+    std::vector<uint64_t> samples;
+    for (size_t i = 0; i < readers.size(); ++i) {
+        size_t n = std::min<uint64_t>(shared->readers[i].samples.load(),
+                                      CrossProcessShared::MAX_SAMPLES);
+        samples.insert(samples.end(), shared->latency_ns[i], shared->latency_ns[i] + n);
+    }
+    reportPercentiles(state, samples, "ns");
+    state.SetItemsProcessed(state.iterations());
+    
+    munmap(memory, sizeof(CrossProcessShared));
+    benchSegment().cleanup();
+}
+
+} // namespace
+
+BENCHMARK(BM_WriteState)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_UpdateLocation)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_ReadLatestState)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_ReadLatestPosition)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_CrossProcessPublish)->ArgName("readers")->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+BENCHMARK_MAIN();
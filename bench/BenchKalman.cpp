@@ -0,0 +1,138 @@
+/**
+ * @file BenchKalman.cpp
+ * @brief Fleet-scale Kalman update throughput (s2sgeo_kalman_bench)
+ *
+ * Each iteration gives every one of N tracks a fix, either through one
+ * KalmanFilter object per track or through KalmanBatch on each SimdPath.
+ * items_per_second is track updates per second on one core.
+ *
+ * The IMU benchmarks feed one track a second of 200 Hz IMU and one GPS fix
+ * per iteration, either pre-integrated into 10 predicts or with a filter
+ * predict per sample; items_per_second is IMU samples per second.
+ * BM_StepDetector runs the same second of samples through a StepDetector.
+ */
+
+#include "KalmanBatch.hpp"
+#include "KalmanFilter.hpp"
+#include "StepDetector.hpp"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+using namespace s2sgeo;
+
+namespace {
+
+LocationFix fleetFix(uint32_t track, int64_t tick) {
+    LocationFix fix(37.7749 + track * 1e-4 + tick * 1e-6, -122.4194, 1000 + tick * 100);
+    fix.accuracy = 5.0 + track % 10;
+    return fix;
+}
+
+void BM_KalmanFilterFleet(benchmark::State& state) {
+    size_t count = static_cast<size_t>(state.range(0));
+    std::vector<KalmanFilter> filters(count);
+    int64_t tick = 0;
+    for (auto _ : state) {
+        ++tick;
+        for (uint32_t t = 0; t < count; ++t) {
+            filters[t].update(fleetFix(t, tick));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+void BM_KalmanBatchFleet(benchmark::State& state, SimdPath path, bool sparse) {
+    size_t count = static_cast<size_t>(state.range(0));
+    KalmanBatch batch(count);
+    if (!batch.setSimdPath(path)) {
+        state.SkipWithError("SIMD path not supported on this CPU");
+        return;
+    }
+    for (size_t t = 0; t < count; ++t) {
+        batch.addTrack();
+    }
+    
+    // Sparse: every other track updated this tick, so lanes are gathered
+    std::vector<uint32_t> tracks(sparse ? count / 2 : count);
+    for (uint32_t i = 0; i < tracks.size(); ++i) {
+        tracks[i] = sparse ? 2 * i : i;
+    }
+    std::vector<LocationFix> fixes(tracks.size());
+    int64_t tick = 0;
+    for (auto _ : state) {
+        ++tick;
+        for (size_t i = 0; i < tracks.size(); ++i) {
+            fixes[i] = fleetFix(tracks[i], tick);
+        }
+        batch.update(tracks, fixes);
+    }
+    state.SetItemsProcessed(state.iterations() * tracks.size());
+}
+
+constexpr int IMU_RATE_HZ = 200;
+
+void BM_ImuFusion(benchmark::State& state, bool preintegrated) {
+    // One second of a weaving ride; only the timestamps change per iteration
+    std::vector<ImuSample> samples(IMU_RATE_HZ);
+    for (int i = 0; i < IMU_RATE_HZ; ++i) {
+        double t = static_cast<double>(i) / IMU_RATE_HZ;
+        samples[i] = {static_cast<int64_t>(t * 1e6), 0.2 * std::cos(t), 1.2 * std::sin(t), 9.81,
+                      0.0, 0.0, 0.2 * std::sin(t)};
+    }
+    
+    KalmanFilter filter;
+    ImuPreintegrator imu;
+    int64_t second = 1;
+    for (auto _ : state) {
+        for (int i = 0; i < IMU_RATE_HZ; ++i) {
+            ImuSample sample = samples[i];
+            sample.timestamp_us += second * 1000000;
+            imu.add(sample);
+            if (!preintegrated || i % (IMU_RATE_HZ / 10) == IMU_RATE_HZ / 10 - 1) {
+                filter.predictImu(imu.take());
+            }
+        }
+        filter.update(fleetFix(0, second * 10));
+        ++second;
+    }
+    state.SetItemsProcessed(state.iterations() * IMU_RATE_HZ);
+}
+
+void BM_StepDetector(benchmark::State& state) {
+    // One second of walking per iteration, delivered in HAL-sized chunks of 50
+    std::vector<ImuSample> samples(IMU_RATE_HZ);
+    for (int i = 0; i < IMU_RATE_HZ; ++i) {
+        double t = static_cast<double>(i) / IMU_RATE_HZ;
+        samples[i] = {static_cast<int64_t>(t * 1e6), 0.3 * std::cos(t), 0.0,
+                      9.81 + 3.0 * std::sin(2.0 * std::numbers::pi * 1.8 * t), 0.0, 0.0, 0.0};
+    }
+    
+    StepDetector detector;
+    std::vector<StepEvent> events;
+    for (auto _ : state) {
+        for (ImuSample& sample : samples) {
+            sample.timestamp_us += 1000000;
+        }
+        for (int i = 0; i < IMU_RATE_HZ; i += 50) {
+            events.clear();
+            detector.process(std::span(samples).subspan(i, 50), events);
+        }
+        benchmark::DoNotOptimize(events.data());
+    }
+    state.SetItemsProcessed(state.iterations() * IMU_RATE_HZ);
+}
+
+} // namespace
+
+BENCHMARK(BM_KalmanFilterFleet)->Arg(1000)->Arg(10000);
+BENCHMARK_CAPTURE(BM_KalmanBatchFleet, scalar, SimdPath::Scalar, false)->Arg(1000)->Arg(10000);
+BENCHMARK_CAPTURE(BM_KalmanBatchFleet, avx2, SimdPath::AVX2, false)->Arg(1000)->Arg(10000);
+BENCHMARK_CAPTURE(BM_KalmanBatchFleet, avx512, SimdPath::AVX512, false)->Arg(1000)->Arg(10000);
+BENCHMARK_CAPTURE(BM_KalmanBatchFleet, avx2_sparse, SimdPath::AVX2, true)->Arg(1000)->Arg(10000);
+BENCHMARK_CAPTURE(BM_ImuFusion, preintegrated, true);
+BENCHMARK_CAPTURE(BM_ImuFusion, per_sample, false);
+BENCHMARK(BM_StepDetector);
+
+BENCHMARK_MAIN();
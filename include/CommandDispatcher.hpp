@@ -7,6 +7,7 @@
 #define S2SGEO_COMMAND_DISPATCHER_HPP
 
 #include "IGeoProvider.hpp"
+#include "IPCManager.hpp"
 #include <string>
 #include <memory>
 
@@ -25,8 +26,19 @@ class CommandDispatcher {
 public:
     /**
      * @brief Process a voice command or text keyword
+     * @param mgr Tenant whose accuracy level the command adjusts
      */
-    static bool processCommand(const std::string& command);
+    static bool processCommand(const std::string& command,
+                               SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Apply a typed command received over the command ring
+     * @details Handles ActivateProvider and SetAccuracy; returns false for
+     *          commands that act on a track (SetS2Level, ForceRefresh) so the
+     *          caller can apply them, and for invalid commands.
+     */
+    static bool execute(const CommandRecord& command,
+                        SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
     
     /**
      * @brief Get current active plugin
@@ -36,7 +48,8 @@ public:
     /**
      * @brief Set accuracy level (0.0 - 1.0)
      */
-    static void setAccuracyLevel(double level);
+    static void setAccuracyLevel(double level,
+                                 SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
 };
 
 } // namespace s2sgeo
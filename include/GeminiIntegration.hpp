@@ -6,6 +6,7 @@
 #ifndef S2SGEO_GEMINI_INTEGRATION_HPP
 #define S2SGEO_GEMINI_INTEGRATION_HPP
 
+#include "IPCManager.hpp"
 #include "SharedMemoryStructs.hpp"
 #include "S2SClient.hpp"
 #include <thread>
@@ -20,7 +21,10 @@ namespace s2sgeo {
  */
 class GeminiIntegration {
 public:
-    GeminiIntegration();
+    /**
+     * @param shm Segment of the tenant whose context is injected
+     */
+    explicit GeminiIntegration(SharedMemoryManager& shm = SharedMemoryManager::getInstance());
     ~GeminiIntegration();
     
     /**
@@ -34,11 +38,13 @@ public:
     void stop();
     
 private:
+    SharedMemoryManager& shm_;
     std::unique_ptr<S2SClient> s2s_client_;
     std::atomic<bool> running_ = false;
     std::thread context_update_thread_;
     
     uint64_t last_context_hash_ = 0;
+    uint32_t last_context_id_ = 0;
     
     /**
      * @brief Monitor location service and inject context updates
@@ -8,8 +8,11 @@
 #define S2SGEO_IGEO_PROVIDER_HPP
 
 #include "SharedMemoryStructs.hpp"
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace s2sgeo {
 
@@ -103,6 +106,18 @@ public:
      * @brief Reset filter
      */
     virtual void reset() = 0;
+    
+    /**
+     * @brief Serialize the complete filter state into a versioned binary blob
+     */
+    virtual std::vector<uint8_t> checkpoint() const = 0;
+    
+    /**
+     * @brief Continue from checkpoint() bytes of the same filter type
+     * @return false, leaving the filter unchanged, if the bytes are not a
+     *         valid checkpoint this build can read
+     */
+    virtual bool restore(std::span<const uint8_t> checkpoint) = 0;
 };
 
 } // namespace s2sgeo
@@ -0,0 +1,70 @@
+/**
+ * @file IPCCommandRing.hpp
+ * @brief Control commands from the adapter to the daemon over shared memory
+ */
+
+#ifndef S2SGEO_IPC_COMMAND_RING_HPP
+#define S2SGEO_IPC_COMMAND_RING_HPP
+
+#include "IPCManager.hpp"
+#include "SharedMemoryStructs.hpp"
+#include <string_view>
+
+namespace s2sgeo {
+
+/**
+ * @class IPCCommandRing
+ * @brief Lock-free SPSC command queue in the shared segment
+ *
+ * The adapter pushes typed commands, the daemon pops them in its service
+ * loop. Single producer: if several adapter processes attach to the same
+ * tenant, only one of them may send commands.
+ */
+class IPCCommandRing {
+public:
+    /**
+     * @brief Enqueue a command (adapter side)
+     * @return false if shared memory is not ready or the ring is full
+     */
+    static bool push(const CommandRecord& command,
+                     SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Dequeue the oldest command (daemon side)
+     * @return false if the ring is empty
+     */
+    static bool pop(CommandRecord& command,
+                    SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Whether commands are waiting (daemon side; two loads, no dequeue)
+     */
+    static bool pending(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Ask the daemon to activate a context provider
+     */
+    static bool activateProvider(std::string_view name,
+                                 SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Ask the daemon to change the accuracy level (0.0 - 1.0)
+     */
+    static bool setAccuracy(double level,
+                            SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Ask the daemon to index positions at another S2 cell level (0 - 30)
+     */
+    static bool setS2Level(int level,
+                           SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Ask the daemon to republish the context on its next tick
+     */
+    static bool forceRefresh(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+};
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_IPC_COMMAND_RING_HPP
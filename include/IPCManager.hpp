@@ -7,61 +7,235 @@
 #define S2SGEO_IPC_MANAGER_HPP
 
 #include "SharedMemoryStructs.hpp"
+#include <memory>
 #include <string>
-#include <boost/interprocess/managed_shared_memory.hpp>
+#include <vector>
+#include <boost/interprocess/mapped_region.hpp>
 
-using boost::interprocess::managed_shared_memory;
+using boost::interprocess::mapped_region;
 
 namespace s2sgeo {
 
+/**
+ * @struct SegmentLayout
+ * @brief Byte offsets of every region of the segment
+ * @details Computed from the ring capacity alone, so daemon and adapter can
+ *          each derive it and cross-check the header at attach time.
+ */
+struct SegmentLayout {
+    uint32_t ring_capacity = 0;
+    size_t restart_state_offset = 0;
+    size_t ring_offset = 0;
+    size_t context_slab_offset = 0;
+    size_t consumer_table_offset = 0;
+    size_t command_ring_offset = 0;
+    size_t stats_offset = 0;
+    size_t total_size = 0;  // Rounded up to a whole number of pages
+    
+    static SegmentLayout compute(uint32_t ring_capacity, size_t page_size);
+};
+
+/**
+ * @struct SharedMemoryOptions
+ * @brief How the segment is sized and backed
+ */
+struct SharedMemoryOptions {
+    uint32_t ring_capacity = SharedMemoryHeader::RING_BUFFER_SIZE;  // Power of two
+    std::string backing_file;             // Map this file instead of POSIX shm (e.g. on hugetlbfs)
+    bool transparent_huge_pages = false;  // madvise(MADV_HUGEPAGE) on the mapping
+    bool prefault = true;                 // Touch every page at attach time
+    bool lock_pages = false;              // mlock() the mapping (needs RLIMIT_MEMLOCK)
+    bool resume = false;                  // Server: reattach to a valid existing segment
+    bool read_only = false;               // Client: map read-only (monitoring tools)
+};
+
 /**
  * @class SharedMemoryManager
  * @brief Manages the shared memory ring buffer
+ *
+ * One instance per tenant (tracked device). Each tenant has its own named
+ * segment, `s2sgeo_shm.<tenant>`; the default tenant ("") uses `s2sgeo_shm`.
  */
 class SharedMemoryManager {
 public:
     static constexpr const char* SHARED_MEMORY_NAME = "s2sgeo_shm";
-    static constexpr size_t SHARED_MEMORY_SIZE = 1024 * 1024;  // 1 MB
+    static constexpr size_t MAX_TENANT_NAME = 64;
     
+    /**
+     * @brief Manager of the default tenant
+     */
     static SharedMemoryManager& getInstance();
     
+    /**
+     * @brief Manager of `tenant`, created on first use
+     * @details Instances live for the rest of the process. Tenant names are
+     *          limited to [A-Za-z0-9_-] and MAX_TENANT_NAME characters;
+     *          other names fail at initializeServer()/connectClient().
+     */
+    static SharedMemoryManager& getInstance(const std::string& tenant);
+    
+    /**
+     * @brief Tenants that have a manager in this process
+     */
+    static std::vector<std::string> tenants();
+    
+    /**
+     * @brief Segment name used for `tenant`
+     */
+    static std::string segmentNameFor(const std::string& tenant);
+    
+    const std::string& tenant() const { return tenant_; }
+    const std::string& segmentName() const { return segment_name_; }
+    
     /**
      * @brief Initialize shared memory (server side)
+     * @details Sizes the segment from options.ring_capacity, backs it with
+     *          POSIX shm or options.backing_file (page size taken from the
+     *          file system, so a hugetlbfs mount yields huge pages), applies
+     *          the page policy and validates the resulting layout.
+     *
+     *          With options.resume, an existing segment (POSIX shm or
+     *          backing file) that passes the ABI and layout checks and has
+     *          the requested ring capacity is reattached as is: the ring,
+     *          context slab, consumer table and RestartState survive and
+     *          attached adapters keep reading. Otherwise a fresh segment is
+     *          created. See wasResumed().
      */
-    bool initializeServer();
+    bool initializeServer(const SharedMemoryOptions& options = {});
     
     /**
      * @brief Connect to existing shared memory (client side)
+     * @details Fails if the segment was created by a daemon with a different
+     *          ABI version or layout hash, or if the header does not describe
+     *          a valid layout for the mapping. Only backing_file, read_only
+     *          and the page policy are used. A read-only client may only
+     *          load from the header and the StatsBlock: IPCReader calls
+     *          update counters in the segment.
      */
-    bool connectClient();
+    bool connectClient(const SharedMemoryOptions& options = {});
     
     /**
      * @brief Clean up shared memory
      */
     void cleanup();
     
+    /**
+     * @brief Unmap the segment but leave it in place for a later resume
+     * @details Clears location_service_alive and wakes blocked readers, like
+     *          cleanup(), without removing the segment or backing file.
+     */
+    void detach();
+    
+    /**
+     * @brief Whether the last initializeServer() reattached an existing segment
+     */
+    bool wasResumed() const { return resumed_; }
+    
     /**
      * @brief Get access to shared memory header
      */
     SharedMemoryHeader* getHeader();
     
     /**
-     * @brief Get access to ring buffer
+     * @brief Get access to the daemon's restart state
      */
-    RingBufferEntry* getRingBuffer();
+    RestartState* getRestartState();
+    
+    /**
+     * @brief Get access to the position ring
+     */
+    PositionRecord* getRingBuffer();
+    
+    /**
+     * @brief Get access to the context slab
+     */
+    ContextSlot* getContextSlab();
+    
+    /**
+     * @brief Get access to the consumer registration table
+     */
+    ConsumerSlot* getConsumerTable();
+    
+    /**
+     * @brief Get access to the adapter-to-daemon command ring
+     */
+    CommandRing* getCommandRing();
+    
+    /**
+     * @brief Get access to the daemon's instrumentation block
+     */
+    StatsBlock* getStats();
+    
+    /**
+     * @brief Number of slots in the position ring (power of two)
+     */
+    uint32_t getRingCapacity() const { return ring_capacity_; }
     
     /**
      * @brief Check if initialization was successful
      */
     bool isReady() const { return is_ready_; }
     
+    /**
+     * @brief Segment size needed for a ring of `ring_capacity` slots
+     */
+    static size_t requiredSegmentSize(uint32_t ring_capacity);
+    
 private:
-    SharedMemoryManager() = default;
+    explicit SharedMemoryManager(std::string tenant);
+    
+    /**
+     * @brief Reattach an existing segment for initializeServer()
+     * @return false if there is none or it cannot be reused as is
+     */
+    bool resumeServer(const SharedMemoryOptions& options);
+    
+    /**
+     * @brief Point the region accessors at the offsets stored in the header
+     */
+    void mapRegions();
+    
+    /**
+     * @brief Check that the tenant name is usable in a segment name
+     */
+    bool checkTenantName() const;
+    
+    /**
+     * @brief Check magic, ABI version and layout hash of an attached header
+     * @details Logs the reason on mismatch.
+     */
+    bool checkAbi(size_t mapped_size) const;
+    
+    /**
+     * @brief Check the header against the layout derived from its ring capacity
+     */
+    bool validateLayout(size_t mapped_size) const;
+    
+    /**
+     * @brief Apply huge page advice, prefaulting and locking to the mapping
+     */
+    void applyPagePolicy(const SharedMemoryOptions& options, bool is_server);
+    
+    /**
+     * @brief Drop the current mapping without removing the segment
+     */
+    void releaseMapping();
     
-    std::unique_ptr<managed_shared_memory> segment_;
+    std::string tenant_;
+    std::string segment_name_;
+    std::unique_ptr<mapped_region> region_;
+    std::string backing_file_;
     SharedMemoryHeader* header_ = nullptr;
-    RingBufferEntry* ring_buffer_ = nullptr;
+    RestartState* restart_state_ = nullptr;
+    PositionRecord* ring_buffer_ = nullptr;
+    ContextSlot* context_slab_ = nullptr;
+    ConsumerSlot* consumer_table_ = nullptr;
+    CommandRing* command_ring_ = nullptr;
+    StatsBlock* stats_ = nullptr;
+    uint32_t ring_capacity_ = 0;
     bool is_ready_ = false;
+    bool resumed_ = false;
+    bool read_only_ = false;
 };
 
 } // namespace s2sgeo
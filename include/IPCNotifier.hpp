@@ -0,0 +1,45 @@
+/**
+ * @file IPCNotifier.hpp
+ * @brief Cross-process wait/wake on a 32-bit word in shared memory
+ */
+
+#ifndef S2SGEO_IPC_NOTIFIER_HPP
+#define S2SGEO_IPC_NOTIFIER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace s2sgeo {
+
+/**
+ * @class IPCNotifier
+ * @brief Futex-style notification primitive for the shared memory ring
+ *
+ * On Linux this is a shared (non-private) futex, so waiters and wakers may
+ * live in different processes that map the same word. Other platforms fall
+ * back to a 1 ms sleep-poll on the word.
+ */
+class IPCNotifier {
+public:
+    /**
+     * @brief Sleep while `word` still equals `expected`
+     * @return false on timeout; true if woken or the word already changed
+     *         (callers must re-check their condition either way)
+     */
+    static bool wait(std::atomic<uint32_t>& word, uint32_t expected,
+                     std::chrono::nanoseconds timeout);
+    
+    /**
+     * @brief Wake every process sleeping on `word`
+     */
+    static void wakeAll(std::atomic<uint32_t>& word);
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+              std::atomic<uint32_t>::is_always_lock_free,
+              "futex word must be a plain lock-free 32-bit integer");
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_IPC_NOTIFIER_HPP
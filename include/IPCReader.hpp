@@ -6,35 +6,361 @@
 #ifndef S2SGEO_IPC_READER_HPP
 #define S2SGEO_IPC_READER_HPP
 
+#include "IPCManager.hpp"
 #include "SharedMemoryStructs.hpp"
+#include <chrono>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace s2sgeo {
 
+/**
+ * @struct IPCUpdate
+ * @brief One published ring entry, tagged with its global sequence
+ * @details Position records are returned merged with their base record
+ *          (position.record_type stays RecordType::Position, base_offset
+ *          becomes 0). If the base was already overwritten the raw delta is
+ *          returned: its base_offset is nonzero and only its own fields are
+ *          valid.
+ *          Use IPCReader::readContext(position.context_id, ...) to fetch the
+ *          context when the id changes.
+ */
+struct IPCUpdate {
+    uint64_t sequence = 0;
+    PositionData position;
+};
+
+/**
+ * @struct DrainResult
+ * @brief Outcome of a batch drain
+ */
+struct DrainResult {
+    size_t count = 0;            // Entries copied into the output span
+    uint64_t lapped = 0;         // Entries overwritten before they could be read
+    uint64_t last_sequence = 0;  // Cursor to pass to the next readSince() call
+};
+
+/**
+ * @class RecordView
+ * @brief Read-only view of a ring record, in place in shared memory
+ * @details Nothing is copied. The writer may reuse the slot while the caller
+ *          reads it, so copy out the fields you need, then call validate():
+ *          if it returns false, discard them and take a new view.
+ */
+class RecordView {
+public:
+    RecordView() = default;
+    
+    /**
+     * @brief Global sequence of the record when the view was taken
+     */
+    uint64_t sequence() const { return sequence_; }
+    
+    /**
+     * @brief Fields of the record (unvalidated until validate() succeeds)
+     * @details Raw record: for RecordType::Position only the position fields
+     *          and context_id are meaningful.
+     */
+    const PositionData& data() const { return record_->data; }
+    
+    /**
+     * @brief Check that the slot still holds the record the view was taken on
+     * @details Call after reading, never before.
+     */
+    bool validate() const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return record_ && record_->sequence.load(std::memory_order_relaxed) == 2 * sequence_;
+    }
+    
+private:
+    friend class IPCReader;
+    
+    const PositionRecord* record_ = nullptr;
+    uint64_t sequence_ = 0;
+};
+
+/**
+ * @class ContextView
+ * @brief Read-only view of a context slab entry, in place in shared memory
+ * @details Same validate-after-use contract as RecordView.
+ */
+class ContextView {
+public:
+    ContextView() = default;
+    
+    uint32_t contextId() const { return context_id_; }
+    const ContextPayload& payload() const { return slot_->payload; }
+    const ContextFrame& frame() const { return slot_->payload.frame; }
+    
+    /**
+     * @brief Check that the slab entry still holds this context
+     */
+    bool validate() const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot_ && slot_->sequence.load(std::memory_order_relaxed) ==
+                        2 * static_cast<uint64_t>(context_id_);
+    }
+    
+private:
+    friend class IPCReader;
+    
+    const ContextSlot* slot_ = nullptr;
+    uint32_t context_id_ = 0;
+};
+
 /**
  * @class IPCReader
  * @brief Lock-free reader for the ring buffer
+ * @details Every call reads from `mgr`, the default tenant unless given.
  */
 class IPCReader {
 public:
     /**
      * @brief Read latest state from ring buffer
+     * @return false if nothing was published yet or the slot kept changing
+     *         under the reader for MAX_READ_RETRIES attempts
+     */
+    static bool readLatestState(WorldState& state, ContextFrame& context,
+                                SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Read only the newest position record (one cache line)
+     * @param sequence Optional: receives the record's global sequence
+     * @details A Position record is merged with its base record, so the
+     *          result always carries the full state.
+     */
+    static bool readLatestPosition(PositionData& position, uint64_t* sequence = nullptr,
+                                   SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Read a context from the slab by id
+     * @return false if `context_id` is 0 or has already been recycled
+     */
+    static bool readContext(uint32_t context_id, ContextPayload& payload,
+                            SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Take a view of the newest record
+     * @return false if nothing was published yet or the slot stayed mid-write
+     *         for MAX_READ_RETRIES attempts
+     */
+    static bool viewLatest(RecordView& view, SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Take a view of context `context_id` in the slab
+     * @return false if `context_id` is 0, recycled or not yet published
+     */
+    static bool viewContext(uint32_t context_id, ContextView& view,
+                            SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Apply `project` to the newest record in place, retrying until the
+     *        result comes from a consistent record
+     * @param project Callable taking `const PositionData&`; it must only copy
+     *        values out (it may see a torn record and is then re-run)
+     * @return std::nullopt if no consistent record was read
+     * @details Full records are projected in place; Position records are
+     *          first merged with their base into a local copy.
      */
-    static bool readLatestState(WorldState& state, ContextFrame& context);
+    template <typename Projection>
+    static auto readProjected(Projection&& project, SharedMemoryManager& mgr = SharedMemoryManager::getInstance())
+        -> std::optional<std::invoke_result_t<Projection&, const PositionData&>> {
+        for (uint32_t attempt = 0; attempt < SharedMemoryHeader::MAX_READ_RETRIES; ++attempt) {
+            RecordView view;
+            if (!viewLatest(view, mgr)) return std::nullopt;
+            
+            if (view.data().record_type == RecordType::Position) {
+                PositionData position;
+                if (!readLatestPosition(position, nullptr, mgr)) return std::nullopt;
+                return project(position);
+            }
+            
+            auto result = project(view.data());
+            if (view.validate()) return result;
+            noteRetry(mgr);
+        }
+        noteFailedRead(mgr);
+        return std::nullopt;
+    }
+    
+    /**
+     * @brief Read a single field of the newest record, e.g.
+     *        readLatestField(&PositionData::s2_cell_id)
+     */
+    template <typename T>
+    static std::optional<T> readLatestField(T PositionData::* field,
+                                            SharedMemoryManager& mgr = SharedMemoryManager::getInstance()) {
+        return readProjected([field](const PositionData& data) { return data.*field; }, mgr);
+    }
+    
+    /**
+     * @brief Apply `project` to context `context_id` in place, retrying while
+     *        the slot is being rewritten
+     * @return std::nullopt if the context is unavailable or was recycled
+     */
+    template <typename Projection>
+    static auto readContextProjected(uint32_t context_id, Projection&& project,
+                                     SharedMemoryManager& mgr = SharedMemoryManager::getInstance())
+        -> std::optional<std::invoke_result_t<Projection&, const ContextPayload&>> {
+        for (uint32_t attempt = 0; attempt < SharedMemoryHeader::MAX_READ_RETRIES; ++attempt) {
+            ContextView view;
+            if (!viewContext(context_id, view, mgr)) return std::nullopt;
+            
+            auto result = project(view.payload());
+            if (view.validate()) return result;
+            noteRetry(mgr);
+        }
+        noteFailedRead(mgr);
+        return std::nullopt;
+    }
+    
+    /**
+     * @brief Drain every entry published after `last_seq`, oldest first
+     * @param last_seq Sequence of the last entry the caller consumed (0 = none)
+     * @param out Destination; at most out.size() entries are copied
+     * @details Entries the writer lapped before they could be copied are
+     *          skipped and counted in DrainResult::lapped. If the daemon
+     *          restarted (last_seq is ahead of the ring) the drain starts
+     *          over from the oldest entry still in the ring.
+     */
+    static DrainResult readSince(uint64_t last_seq, std::span<IPCUpdate> out,
+                                 SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Sequence of the newest published entry (0 = none)
+     */
+    static uint64_t latestSequence(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Block until an entry newer than `last_seq` is published
+     * @return true if latestSequence() > last_seq, false on timeout or if the
+     *         service shut down while waiting
+     * @details Sleeps on a futex in the shared header; no polling.
+     */
+    static bool waitForUpdate(uint64_t last_seq, std::chrono::nanoseconds timeout,
+                              SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Claim a slot in the consumer table for this process
+     * @param name Label shown in lag reports (truncated to 31 characters)
+     * @return Slot index, or -1 if the table is full
+     * @details Slots left behind by exited processes are reclaimed by the
+     *          daemon (IPCWriter::publishConsumerLag).
+     */
+    static int32_t registerConsumer(std::string_view name, SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Record progress: newest sequence consumed and entries lapped since
+     *        the last report. Also refreshes the heartbeat.
+     */
+    static void reportConsumed(int32_t slot, uint64_t last_seq, uint64_t lapped,
+                               SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Release a slot claimed with registerConsumer()
+     */
+    static void unregisterConsumer(int32_t slot, SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Lag of the slowest registered consumer, as last published by the daemon
+     */
+    static uint64_t maxConsumerLag(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
     
     /**
      * @brief Check if location service is alive
      */
-    static bool isLocationServiceAlive();
+    static bool isLocationServiceAlive(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
     
     /**
      * @brief Get active plugin name
      */
-    static std::string getActivePlugin();
+    static std::string getActivePlugin(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
     
     /**
      * @brief Get accuracy level
      */
-    static double getAccuracyLevel();
+    static double getAccuracyLevel(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+private:
+    /**
+     * @brief Count a seqlock retry / abandoned read in the shared header
+     */
+    static void noteRetry(SharedMemoryManager& mgr);
+    static void noteFailedRead(SharedMemoryManager& mgr);
+};
+
+/**
+ * @class IPCCursor
+ * @brief Per-consumer position in the ring for batch draining
+ *
+ * Cursors are process-local, so any number of consumers can drain the
+ * same ring independently.
+ */
+class IPCCursor {
+public:
+    /**
+     * @brief Create a cursor positioned after `start_seq`
+     * @param start_seq 0 replays everything still in the ring;
+     *        IPCReader::latestSequence() skips history
+     */
+    explicit IPCCursor(uint64_t start_seq = 0,
+                       SharedMemoryManager& mgr = SharedMemoryManager::getInstance())
+        : mgr_(&mgr), last_seq_(start_seq) {}
+    
+    ~IPCCursor() { detach(); }
+    
+    IPCCursor(const IPCCursor&) = delete;
+    IPCCursor& operator=(const IPCCursor&) = delete;
+    
+    /**
+     * @brief Register this cursor in the consumer table so the daemon can see
+     *        its lag and overruns
+     * @return false if the table is full (the cursor still works unregistered)
+     */
+    bool attach(std::string_view name) {
+        detach();
+        consumer_slot_ = IPCReader::registerConsumer(name, *mgr_);
+        if (consumer_slot_ >= 0) {
+            IPCReader::reportConsumed(consumer_slot_, last_seq_, 0, *mgr_);
+        }
+        return consumer_slot_ >= 0;
+    }
+    
+    /**
+     * @brief Release the consumer table slot, if any
+     */
+    void detach() {
+        if (consumer_slot_ >= 0) {
+            IPCReader::unregisterConsumer(consumer_slot_, *mgr_);
+            consumer_slot_ = -1;
+        }
+    }
+    
+    /**
+     * @brief Drain new entries into `out` and advance the cursor
+     */
+    DrainResult drain(std::span<IPCUpdate> out) {
+        DrainResult result = IPCReader::readSince(last_seq_, out, *mgr_);
+        last_seq_ = result.last_sequence;
+        total_lapped_ += result.lapped;
+        if (consumer_slot_ >= 0) {
+            IPCReader::reportConsumed(consumer_slot_, last_seq_, result.lapped, *mgr_);
+        }
+        return result;
+    }
+    
+    uint64_t position() const { return last_seq_; }
+    uint64_t totalLapped() const { return total_lapped_; }
+    int32_t consumerSlot() const { return consumer_slot_; }
+    
+private:
+    SharedMemoryManager* mgr_;
+    uint64_t last_seq_;
+    uint64_t total_lapped_ = 0;
+    int32_t consumer_slot_ = -1;
 };
 
 } // namespace s2sgeo
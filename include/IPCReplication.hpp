@@ -0,0 +1,190 @@
+/**
+ * @file IPCReplication.hpp
+ * @brief Replicate the position ring to other hosts over UDP
+ */
+
+#ifndef S2SGEO_IPC_REPLICATION_HPP
+#define S2SGEO_IPC_REPLICATION_HPP
+
+#include "IPCManager.hpp"
+#include "IPCReader.hpp"
+#include "SharedMemoryStructs.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+namespace s2sgeo {
+
+/**
+ * @struct ReplicationPacketHeader
+ * @brief Start of every replication datagram
+ * @details Followed by a ContextPayload if FLAG_HAS_CONTEXT is set, then
+ *          `record_count` ReplicationRecords. Every record of a packet
+ *          refers to `context_id`. Fields are in host byte order: both ends
+ *          must share endianness and this build's PositionData layout
+ *          (`layout_hash`).
+ */
+struct ReplicationPacketHeader {
+    static constexpr uint32_t MAGIC = 0x52473253;  // "S2GR" little-endian
+    static constexpr uint16_t VERSION = 1;
+    static constexpr uint16_t FLAG_HAS_CONTEXT = 1;
+    
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t layout_hash;      // sharedMemoryLayoutHash() of the sender
+    uint64_t packet_sequence;  // Per-sender datagram counter; 0 = sender (re)started
+    uint32_t context_id;       // Sender-side context id of every record
+    uint32_t record_count;
+};
+
+/**
+ * @struct ReplicationRecord
+ * @brief One ring entry on the wire: its source sequence and full state
+ */
+struct ReplicationRecord {
+    uint64_t sequence;
+    PositionData position;  // Always full state; Position deltas are resolved by the sender
+};
+
+static_assert(sizeof(ReplicationPacketHeader) == 32, "Replication header layout changed");
+static_assert(sizeof(ReplicationRecord) == 64, "Replication record layout changed");
+
+/**
+ * @struct ReplicationOptions
+ * @brief Batching policy of a ReplicationSender
+ */
+struct ReplicationOptions {
+    size_t max_batch = 16;                      // Records per datagram (16 fits a 1500 B MTU)
+    std::chrono::microseconds batch_window{0};  // Hold a partial batch this long (0 = send on every poll)
+    uint32_t context_refresh = 64;              // Resend the context every N datagrams
+};
+
+/**
+ * @struct ReplicationStats
+ * @brief Counters of one end of a replication link
+ */
+struct ReplicationStats {
+    uint64_t packets = 0;        // Datagrams sent / accepted
+    uint64_t records = 0;        // Ring entries sent / republished
+    uint64_t bytes = 0;
+    uint64_t contexts = 0;       // Context payloads sent / republished
+    uint64_t lapped = 0;         // Sender: entries overwritten before the bridge read them
+    uint64_t unresolved = 0;     // Sender: deltas whose base was overwritten (not sent)
+    uint64_t send_errors = 0;    // Sender: datagrams the socket refused
+    uint64_t gaps = 0;           // Receiver: source entries missing or dropped for a missing context
+    uint64_t lost_packets = 0;   // Receiver: datagrams missing from the stream
+    uint64_t stale_records = 0;  // Receiver: duplicates or entries arriving after newer ones
+    uint64_t malformed = 0;      // Receiver: datagrams that failed validation
+};
+
+/**
+ * @class ReplicationSender
+ * @brief Drains a local ring and sends it to a ReplicationReceiver
+ *
+ * Registers as consumer "bridge", so the daemon reports its lag like any
+ * adapter's. Only full states are sent: a Position delta whose base was
+ * overwritten before the bridge read it is dropped, and the receiver sees
+ * a gap. Packets are split wherever the context changes; the context
+ * payload travels with the first packet under a new context and again
+ * every ReplicationOptions::context_refresh packets.
+ */
+class ReplicationSender {
+public:
+    ReplicationSender(boost::asio::io_context& io,
+                      const boost::asio::ip::udp::endpoint& destination,
+                      const ReplicationOptions& options = {},
+                      SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Drain new ring entries and send every batch that is due
+     * @return Ring entries drained
+     */
+    size_t poll();
+    
+    /**
+     * @brief Send the buffered partial batch, if any
+     */
+    void flush();
+    
+    /**
+     * @brief Wait for ring updates and forward them until `running` is cleared
+     */
+    void run(const std::atomic<bool>& running);
+    
+    const ReplicationStats& stats() const { return stats_; }
+    
+private:
+    void append(const IPCUpdate& update);
+    void sendBatch();
+    
+    boost::asio::ip::udp::socket socket_;
+    boost::asio::ip::udp::endpoint destination_;
+    ReplicationOptions options_;
+    SharedMemoryManager* mgr_;
+    IPCCursor cursor_;
+    
+    std::vector<ReplicationRecord> batch_;
+    uint32_t batch_context_id_ = 0;
+    std::chrono::steady_clock::time_point batch_started_;
+    uint32_t sent_context_id_ = 0;
+    uint32_t packets_since_context_ = 0;
+    uint64_t packet_sequence_ = 0;
+    std::vector<char> buffer_;
+    ReplicationStats stats_;
+};
+
+/**
+ * @class ReplicationReceiver
+ * @brief Republishes replicated entries into a local ring through IPCWriter
+ *
+ * `mgr` must be initialized as a server: the receiver is the producer of
+ * its local ring. Local sequences are dense; source sequences are only used
+ * to detect gaps, duplicates and reordering. Stale entries are dropped, and
+ * so are entries whose context has not been received yet.
+ */
+class ReplicationReceiver {
+public:
+    /**
+     * @param listen Local endpoint; port 0 picks a free one (see port())
+     */
+    ReplicationReceiver(boost::asio::io_context& io,
+                        const boost::asio::ip::udp::endpoint& listen,
+                        SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Republish every pending datagram, waiting up to `timeout` for the first
+     * @return Records republished
+     */
+    size_t poll(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+    
+    /**
+     * @brief Receive and republish until `running` is cleared
+     */
+    void run(const std::atomic<bool>& running);
+    
+    uint16_t port() const;
+    const ReplicationStats& stats() const { return stats_; }
+    
+private:
+    /**
+     * @brief Validate and republish one datagram
+     * @return Records republished
+     */
+    size_t handleDatagram(const char* data, size_t size);
+    
+    boost::asio::ip::udp::socket socket_;
+    SharedMemoryManager* mgr_;
+    std::vector<char> buffer_;
+    uint64_t last_sequence_ = 0;       // Newest source entry republished
+    uint64_t next_packet_ = 0;         // Expected packet_sequence
+    uint32_t remote_context_id_ = 0;   // Sender-side id of the context now published
+    ReplicationStats stats_;
+};
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_IPC_REPLICATION_HPP
@@ -0,0 +1,90 @@
+/**
+ * @file IPCStats.hpp
+ * @brief Daemon latency histograms and counters in shared memory
+ */
+
+#ifndef S2SGEO_IPC_STATS_HPP
+#define S2SGEO_IPC_STATS_HPP
+
+#include "IPCManager.hpp"
+#include "SharedMemoryStructs.hpp"
+#include <array>
+#include <cstdint>
+
+namespace s2sgeo {
+
+/**
+ * @struct HistogramSnapshot
+ * @brief Copy of one LatencyHistogram taken by a reader
+ */
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    uint64_t max_ns = 0;
+    std::array<uint64_t, LatencyHistogram::BUCKETS> buckets{};
+    
+    /**
+     * @brief Upper bound of the bucket holding quantile `q` (0.0 - 1.0)
+     * @details Accurate to a factor of two, never above max_ns; 0 if empty.
+     */
+    uint64_t percentileNs(double q) const;
+    
+    double meanNs() const { return count ? static_cast<double>(sum_ns) / count : 0.0; }
+};
+
+/**
+ * @struct StatsSnapshot
+ * @brief Copy of a StatsBlock taken by a reader
+ */
+struct StatsSnapshot {
+    std::array<HistogramSnapshot, StatsBlock::NUM_HISTOGRAMS> histograms{};
+    std::array<uint64_t, StatsBlock::NUM_COUNTERS> counters{};
+    
+    const HistogramSnapshot& histogram(LatencyMetric metric) const {
+        return histograms[static_cast<size_t>(metric)];
+    }
+    
+    uint64_t counter(StatCounter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+};
+
+/**
+ * @class IPCStats
+ * @brief Lock-free instrumentation published by the daemon
+ * @details The daemon records into the StatsBlock of each tenant segment;
+ *          tools such as s2sgeo_stat take snapshots from a read-only mapping.
+ */
+class IPCStats {
+public:
+    /**
+     * @brief Add one latency sample (daemon side)
+     */
+    static void recordLatency(LatencyMetric metric, uint64_t nanoseconds,
+                              SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Bump an event counter (daemon side)
+     */
+    static void increment(StatCounter counter, uint64_t count = 1,
+                          SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Copy every histogram and counter
+     * @return false if shared memory is not ready
+     */
+    static bool snapshot(StatsSnapshot& out,
+                         SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Bucket of a sample: bit_width(nanoseconds), clamped to the last bucket
+     */
+    static size_t bucketFor(uint64_t nanoseconds);
+    
+    static const char* metricName(LatencyMetric metric);
+    static const char* counterName(StatCounter counter);
+};
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_IPC_STATS_HPP
@@ -6,30 +6,100 @@
 #ifndef S2SGEO_IPC_WRITER_HPP
 #define S2SGEO_IPC_WRITER_HPP
 
+#include "IPCManager.hpp"
 #include "SharedMemoryStructs.hpp"
+#include <string>
+#include <string_view>
 
 namespace s2sgeo {
 
+/**
+ * @struct ConsumerLagReport
+ * @brief Snapshot of the consumer table taken by the daemon
+ */
+struct ConsumerLagReport {
+    uint32_t active_consumers = 0;
+    uint32_t reclaimed_slots = 0;    // Slots freed because their process exited
+    uint64_t max_lag = 0;            // Entries the slowest consumer is behind the head
+    uint64_t total_overruns = 0;     // Entries lapped, summed over live consumers
+    int64_t max_heartbeat_age_ms = 0;
+    std::string slowest_consumer;
+};
+
 /**
  * @class IPCWriter
  * @brief Lock-free writer for the ring buffer
+ * @details Every call targets `mgr`, the default tenant unless given.
  */
 class IPCWriter {
 public:
     /**
      * @brief Write a new state to the ring buffer
+     * @details Publishes `context` to the context slab only if it differs from
+     *          the current one, then writes a position record referencing it.
      */
-    static void writeState(const WorldState& state, const ContextFrame& context);
+    static void writeState(const WorldState& state, const ContextFrame& context,
+                           SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Publish a context to the context slab
+     * @return Id of the context now in effect (unchanged if identical to the
+     *         current one), 0 if shared memory is not ready
+     */
+    static uint32_t publishContext(const ContextFrame& context,
+                                   std::string_view context_json = {},
+                                   SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Write a full-state position record referencing the current context
+     * @details Hot path: copies one cache line into the ring. Tagged
+     *          RecordType::ContextChanged when the context id differs from the
+     *          previous record's.
+     */
+    static void writePosition(const WorldState& state,
+                              SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
     
     /**
      * @brief Update location only (fast path)
+     * @details Writes a RecordType::Position record holding just the position
+     *          and the current context id; readers take cell, steps and motion
+     *          from the full record it points back to. A full record is written
+     *          instead when the context changed or the chain would exceed
+     *          min(MAX_DELTA_CHAIN, ring_capacity / 2).
+     */
+    static void updateLocation(double lat, double lon, double alt, int64_t timestamp,
+                               SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Scan the consumer table, reclaim slots of exited processes and
+     *        publish the slowest consumer's lag in the header
+     */
+    static ConsumerLagReport publishConsumerLag(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Publish the name of the active context provider
+     */
+    static void setActivePlugin(std::string_view name, SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Save the filter state that belongs with the newest ring entry
+     * @details Daemon-private; lets a daemon that resumes this segment
+     *          continue from the converged filter instead of reinitializing.
+     */
+    static void saveFilterSnapshot(const FilterSnapshot& snapshot,
+                                   SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
+    
+    /**
+     * @brief Load the filter state saved by a previous daemon
+     * @return false if none was saved or the save was interrupted
      */
-    static void updateLocation(double lat, double lon, double alt, int64_t timestamp);
+    static bool loadFilterSnapshot(FilterSnapshot& snapshot,
+                                   SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
     
     /**
      * @brief Signal that location service is alive
      */
-    static void signalAlive();
+    static void signalAlive(SharedMemoryManager& mgr = SharedMemoryManager::getInstance());
 };
 
 } // namespace s2sgeo
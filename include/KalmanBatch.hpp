@@ -0,0 +1,139 @@
+/**
+ * @file KalmanBatch.hpp
+ * @brief Structure-of-arrays Kalman engine for many tracks at once
+ */
+
+#ifndef S2SGEO_KALMAN_BATCH_HPP
+#define S2SGEO_KALMAN_BATCH_HPP
+
+#include "KalmanFilter.hpp"
+#include "LocalTangentFrame.hpp"
+#include "SharedMemoryStructs.hpp"
+#include "SimdDispatch.hpp"
+#include <Eigen/Dense>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace s2sgeo {
+
+/**
+ * @class KalmanBatch
+ * @brief Runs KalmanFilter's constant-velocity model for N tracks in SIMD lanes
+ *
+ * Every state and (upper-triangle) covariance entry is its own array
+ * indexed by track, so one vector load covers 4 or 8 tracks. update() gathers
+ * the tracks that received a fix into contiguous lanes (skipped when they are
+ * already contiguous), runs predict + correct with the widest SimdPath the
+ * CPU supports, and scatters the result back. Each track has its own
+ * LocalTangentFrame and follows exactly the arithmetic of
+ * KalmanFilter::update, including the innovation gate and the restart after
+ * too many gated fixes, minus PDR step counting, adaptive R/Q (the adaptive
+ * estimates are per-track state the kernels do not carry) and velocity
+ * fusion: a fix's HAS_SPEED/HAS_HEADING measurements are ignored, where
+ * KalmanFilter applies them through correctVelocity.
+ *
+ * Storage grows only in addTrack() and the first update() of a given size.
+ */
+class KalmanBatch {
+public:
+    explicit KalmanBatch(size_t capacity = 0);
+    
+    /**
+     * @brief Add a track in the reset state
+     * @return Track index for update() and the accessors
+     */
+    uint32_t addTrack();
+    
+    size_t size() const { return last_update_ms_.size(); }
+    
+    /**
+     * @brief Apply fixes[i] to tracks[i]
+     * @details A track may appear at most once per call.
+     */
+    void update(std::span<const uint32_t> tracks, std::span<const LocationFix> fixes);
+    
+    /**
+     * @brief Same as KalmanFilter::getSmoothedState for one track
+     */
+    WorldState getSmoothedState(uint32_t track) const;
+    
+    /**
+     * @brief Forget one track's state (e.g., when its GPS signal is lost)
+     */
+    void resetTrack(uint32_t track);
+    
+    Eigen::Vector4d state(uint32_t track) const;
+    Eigen::Matrix4d covariance(uint32_t track) const;
+    
+    /**
+     * @brief Set process noise for every track (see KalmanFilter::setProcessNoise)
+     */
+    void setProcessNoise(double q);
+    
+    /**
+     * @brief Set the measurement noise floor for every track
+     */
+    void setMeasurementNoise(double r) { r_floor_ = r; }
+    
+    /**
+     * @brief Set the gate for every track; the adaptive_* and velocity_measurements settings are ignored
+     */
+    void setTuning(const KalmanTuning& tuning);
+    
+    /**
+     * @brief Fix outcomes summed over all tracks
+     */
+    const KalmanCounters& counters() const { return counters_; }
+    
+    /**
+     * @brief Force a kernel, e.g. to compare paths
+     * @return false if this CPU or build cannot run `path` (selection unchanged)
+     */
+    bool setSimdPath(SimdPath path);
+    
+    SimdPath simdPath() const { return simd_path_; }
+    
+    /**
+     * @enum Field
+     * @brief Per-track arrays: state [east, north, east_vel, north_vel] and P's upper triangle
+     */
+    enum Field : uint8_t {
+        X0, X1, V0, V1,
+        P00, P01, P02, P03, P11, P12, P13, P22, P23, P33,
+        STATE_FIELDS,
+        // Per-update inputs and the NIS output, only in the lanes
+        DT = STATE_FIELDS, Z0, Z1, R, NIS,
+        LANE_FIELDS
+    };
+    
+private:
+    std::array<std::vector<double>, STATE_FIELDS> tracks_;
+    std::vector<int64_t> last_update_ms_;
+    std::vector<LocalTangentFrame> frames_;  // Only touched outside the kernels
+    std::vector<uint32_t> rejections_;  // Consecutive gated fixes
+    std::array<std::vector<double>, LANE_FIELDS> lanes_;  // Gathered tracks of one update()
+    
+    double q_position_;
+    double q_velocity_;
+    double r_floor_ = 100.0;  // GPS accuracy ~10m std
+    double gate_;
+    uint32_t max_consecutive_rejections_;
+    KalmanCounters counters_;
+    SimdPath simd_path_;
+    
+    /**
+     * @brief x = 0, P = 1e6 I (frame and timestamp untouched)
+     */
+    void clearState(uint32_t track);
+    
+    /**
+     * @brief Restart a track at a fix, as KalmanFilter does after too many gated fixes
+     */
+    void reinitialize(uint32_t track, const LocationFix& fix);
+};
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_KALMAN_BATCH_HPP
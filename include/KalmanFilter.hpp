@@ -8,22 +8,266 @@
 
 #include "SharedMemoryStructs.hpp"
 #include "IGeoProvider.hpp"
+#include "ImuPreintegrator.hpp"
+#include "LocalTangentFrame.hpp"
 #include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <span>
+#include <vector>
 
 namespace s2sgeo {
 
 /**
- * @class KalmanFilter
- * @brief 2D position Kalman filter with adaptive process/measurement noise
+ * @brief Predict step for a fix: seconds since the last update, clamped to
+ *        [0.01, 1]; 0.1 for the first fix after a reset (last_update_ms == 0)
+ */
+inline double filterStepSeconds(int64_t last_update_ms, int64_t timestamp_ms) {
+    if (last_update_ms <= 0) return 0.1;
+    return std::clamp((timestamp_ms - last_update_ms) / 1000.0, 0.01, 1.0);
+}
+
+/**
+ * @struct ConstantVelocityModel
+ * @brief Constant-velocity motion with direct position measurements
+ * 
+ * State Vector: [p_0 .. p_{Axes-1}, v_0 .. v_{Axes-1}]
+ * Measurement: [p_0 .. p_{Axes-1}]
+ * Positions are (east, north[, up]) in metres in a LocalTangentFrame,
+ * velocities in m/s, so Q and R share the units of a fix's accuracy.
  * 
- * State Vector: [x, y, vx, vy]
- * Measurement: [x, y] from GPS
+ * A = [I dt*I; 0 I] and H = [I 0] are applied blockwise: a predict costs
+ * three Axes x Axes block updates instead of two dense StateDim products.
+ * Horizontal velocity (east, north) sits at VELOCITY, VELOCITY + 1; the
+ * filter's speed/course updates read only that block.
+ */
+template <int Axes>
+struct ConstantVelocityModel {
+    static_assert(Axes == 2 || Axes == 3, "Axes are (east, north) or (east, north, up)");
+    
+    static constexpr int STATE_DIM = 2 * Axes;
+    static constexpr int MEAS_DIM = Axes;
+    static constexpr int VELOCITY = Axes;
+    static constexpr double MOVING_SPEED_MPS = 0.5;  // Below this, GPS noise alone can explain the motion
+    
+    using State = Eigen::Matrix<double, STATE_DIM, 1>;
+    using Covariance = Eigen::Matrix<double, STATE_DIM, STATE_DIM>;
+    using Measurement = Eigen::Matrix<double, MEAS_DIM, 1>;
+    using MeasurementCovariance = Eigen::Matrix<double, MEAS_DIM, MEAS_DIM>;
+    using CrossCovariance = Eigen::Matrix<double, STATE_DIM, MEAS_DIM>;
+    
+    /**
+     * @brief x = A x, P = A P A^T (process noise is added by the filter)
+     */
+    static void predict(State& x, Covariance& P, double dt) {
+        x.template head<Axes>() += dt * x.template tail<Axes>();
+        
+        // Position block first: it reads the cross terms before they change
+        P.template topLeftCorner<Axes, Axes>() +=
+            dt * (P.template topRightCorner<Axes, Axes>() + P.template bottomLeftCorner<Axes, Axes>()) +
+            dt * dt * P.template bottomRightCorner<Axes, Axes>();
+        P.template topRightCorner<Axes, Axes>() += dt * P.template bottomRightCorner<Axes, Axes>();
+        P.template bottomLeftCorner<Axes, Axes>() += dt * P.template bottomRightCorner<Axes, Axes>();
+    }
+    
+    /**
+     * @brief Q for tuning parameter q: positions get 0.001 q, velocities q
+     */
+    static Covariance processNoise(double q) {
+        Covariance Q = Covariance::Identity() * q;
+        Q.template topLeftCorner<Axes, Axes>() *= 0.001;
+        return Q;
+    }
+    
+    /**
+     * @brief H x
+     */
+    static Measurement measure(const State& x) {
+        return x.template head<Axes>();
+    }
+    
+    /**
+     * @brief H P H^T
+     */
+    static MeasurementCovariance project(const Covariance& P) {
+        return P.template topLeftCorner<Axes, Axes>();
+    }
+    
+    /**
+     * @brief P H^T
+     */
+    static CrossCovariance crossCovariance(const Covariance& P) {
+        return P.template leftCols<Axes>();
+    }
+    
+    /**
+     * @brief Move the frame's anchor under the current position once it has
+     *        drifted past LocalTangentFrame::REANCHOR_DISTANCE_M
+     * @details Velocity and covariance carry over: frames 1 km apart differ
+     *          by a rotation of about 0.01 degrees.
+     */
+    static void reanchor(State& x, LocalTangentFrame& frame) {
+        if (!frame.needsReanchor(x(0), x(1))) return;
+        
+        GeodeticPoint position = frame.toGeodetic(x(0), x(1), Axes == 3 ? x(2) : 0.0);
+        frame.anchor(position.latitude, position.longitude,
+                     Axes == 3 ? position.altitude : frame.anchorPoint().altitude);
+        x.template head<Axes>().setZero();
+    }
+    
+    /**
+     * @brief Measurement and its noise from a fix
+     * @param r_floor Smallest variance accepted for a horizontal axis (m^2)
+     */
+    static void fromFix(const LocationFix& fix, const LocalTangentFrame& frame, double r_floor,
+                        Measurement& z, MeasurementCovariance& R) {
+        double r = std::max(r_floor, fix.accuracy * fix.accuracy);
+        R = MeasurementCovariance::Identity() * r;
+        EnuPoint enu = frame.toEnu(fix.latitude, fix.longitude, fix.altitude);
+        z(0) = enu.east;
+        z(1) = enu.north;
+        if constexpr (Axes == 3) {
+            // GPS altitude is typically 1.5x worse than the horizontal fix
+            z(2) = enu.up;
+            R(2, 2) = 2.25 * r;
+        }
+    }
+    
+    static void toWorldState(const State& x, const LocalTangentFrame& frame, WorldState& state) {
+        GeodeticPoint position = frame.toGeodetic(x(0), x(1), Axes == 3 ? x(2) : 0.0);
+        state.smoothed_lat = position.latitude;
+        state.smoothed_lon = position.longitude;
+        state.smoothed_altitude = Axes == 3 ? position.altitude : 0.0;
+        state.velocity_east_mps = x(Axes);
+        state.velocity_north_mps = x(Axes + 1);
+        state.is_moving = std::hypot(x(Axes), x(Axes + 1)) > MOVING_SPEED_MPS;
+    }
+};
+
+/**
+ * @struct KalmanTuning
+ * @brief Outlier gating and noise adaptation for BasicKalmanFilter
+ *
+ * A fix is gated (dropped after the predict) when its normalized innovation
+ * squared, NIS = y^T S^-1 y, exceeds gate_threshold. Adaptation follows the
+ * innovation-based estimate: accepted innovations feed a running average C of
+ * y y^T, R's diagonal is raised to whatever part of C the filter's own H P H^T
+ * does not explain, and Q is scaled by the average NIS per axis (doubled on
+ * each gated fix, so a manoeuvre the model missed is picked up sooner).
+ * Speed and course updates are gated on their own chi-square quantile
+ * (unless gating is off) and never adapt R or Q.
+ */
+struct KalmanTuning {
+    double gate_threshold = 0.0;  // Chi-square value; 0 = chiSquareGate(MeasDim), < 0 = no gating
+    uint32_t max_consecutive_rejections = 3;  // Gated fixes in a row before restarting at the next
+    bool adaptive_measurement_noise = false;  // R = max(fix's R, diag(C - H P H^T))
+    bool adaptive_process_noise = false;  // Q *= clamp(average NIS / MeasDim, 1, max_process_noise_scale)
+    double max_process_noise_scale = 10.0;
+    double adaptation_rate = 0.05;  // Weight of the newest innovation in the averages
+    uint8_t velocity_measurements = LocationFix::HAS_SPEED | LocationFix::HAS_HEADING;  // Which a fix may add
+};
+
+/**
+ * @brief 99.9% quantile of the chi-square distribution with `dof` (1-4) degrees of freedom
+ */
+constexpr double chiSquareGate(int dof) {
+    switch (dof) {
+        case 1: return 10.83;
+        case 2: return 13.82;
+        case 3: return 16.27;
+        default: return 18.47;
+    }
+}
+
+/**
+ * @enum FixOutcome
+ * @brief What BasicKalmanFilter::update did with a fix
+ */
+enum class FixOutcome : uint8_t {
+    Accepted,       // Predict + correct
+    Gated,          // Predict only: the fix failed the innovation gate
+    Reinitialized   // Too many gated in a row: the filter restarted at this fix
+};
+
+/**
+ * @struct KalmanCounters
+ * @brief Fix outcomes since construction (reset() keeps them)
+ */
+struct KalmanCounters {
+    uint64_t accepted_fixes = 0;
+    uint64_t gated_fixes = 0;
+    uint64_t reinitializations = 0;
+    uint64_t velocity_corrections = 0;  // Speed and/or course updates applied
+    uint64_t gated_velocity = 0;        // Speed and/or course updates gated
+};
+
+/**
+ * @struct FilterCheckpointHeader
+ * @brief Start of a BasicKalmanFilter::checkpoint() blob
+ * @details Followed by `payload_bytes` of doubles, in order: anchor latitude,
+ *          longitude and altitude; process noise q; measurement noise floor;
+ *          step length; reserved (written 0); IMU heading; Q scale; NIS
+ *          average; the state (state_dim); the upper triangle of P, row by
+ *          row; the upper triangle of the innovation average C. About 250 bytes for the
+ *          4-state filter. Fields are in host byte order, as in replication
+ *          datagrams; restore() rejects other magics, dimensions, sizes and
+ *          versions newer than VERSION, and values the filter cannot run
+ *          with: non-finite numbers, non-positive noise or Q scale, an
+ *          anchor off the globe, or a P that is not positive definite.
+ */
+struct FilterCheckpointHeader {
+    static constexpr uint32_t MAGIC = 0x464b3253;  // "S2KF" little-endian
+    static constexpr uint16_t VERSION = 1;
+    static constexpr uint16_t FLAG_ANCHORED = 1 << 0;
+    static constexpr uint16_t FLAG_PDR = 1 << 1;
+    static constexpr uint16_t FLAG_HEADING_VALID = 1 << 2;
+    static constexpr uint16_t FLAG_HEADING_FROM_COURSE = 1 << 3;
+    
+    uint32_t magic;
+    uint16_t version;
+    uint8_t state_dim;
+    uint8_t meas_dim;
+    uint16_t flags;
+    uint16_t reserved;
+    uint32_t step_count;
+    uint32_t consecutive_rejections;
+    uint32_t payload_bytes;
+    int64_t last_update_ms;
+};
+
+static_assert(sizeof(FilterCheckpointHeader) == 32, "Checkpoint header layout changed");
+
+/**
+ * @class BasicKalmanFilter
+ * @brief Fixed-size Kalman filter with the motion/measurement model as a policy
+ * 
+ * `Model` supplies predict, processNoise, measure, project, crossCovariance,
+ * reanchor, fromFix and toWorldState (see ConstantVelocityModel). The filter
+ * runs in a LocalTangentFrame anchored at the first fix after a reset. All matrices are fixed-size, so
+ * an update never allocates; 2-D measurements use a closed-form inverse of
+ * the innovation covariance, larger ones a fixed-size LLT solve.
+ * Each correct is gated on the innovation's Mahalanobis distance, with
+ * optional adaptive R and Q (see KalmanTuning).
+ * A fix's Doppler speed and course over ground (LocationFix::measured) follow
+ * the position update as a velocity correction: together they convert to an
+ * (east, north) velocity, which is linear in the state; alone each is an
+ * extended (linearized) scalar update, used once the filter is moving.
  * Fusion: GPS + IMU (optional PDR)
  */
-class KalmanFilter : public IKalmanFilter {
+template <int StateDim, int MeasDim, typename Model>
+class BasicKalmanFilter : public IKalmanFilter {
+    static_assert(Model::STATE_DIM == StateDim && Model::MEAS_DIM == MeasDim,
+                  "Model dimensions do not match the filter");
+                  
 public:
-    KalmanFilter();
+    using State = Eigen::Matrix<double, StateDim, 1>;
+    using Covariance = Eigen::Matrix<double, StateDim, StateDim>;
+    using Measurement = Eigen::Matrix<double, MeasDim, 1>;
+    using MeasurementCovariance = Eigen::Matrix<double, MeasDim, MeasDim>;
+    using Gain = Eigen::Matrix<double, StateDim, MeasDim>;
+    
+    BasicKalmanFilter();
     
     /**
      * @brief Update filter with GPS measurement
@@ -40,6 +284,45 @@ public:
      */
     void reset() override;
     
+    /**
+     * @brief Everything restore() needs to continue exactly where this filter
+     *        is: state, covariance, frame, noise settings, PDR and IMU heading
+     *        state and the adaptive estimates (see FilterCheckpointHeader)
+     * @details Tuning and counters are configuration and statistics of the
+     *          host, not filter state, and are not included.
+     */
+    std::vector<uint8_t> checkpoint() const override;
+    
+    bool restore(std::span<const uint8_t> checkpoint) override;
+    
+    /**
+     * @brief Capture state, covariance and PDR counters for a warm restart
+     * @details Fixed-size subset of checkpoint() for the segment's RestartState
+     */
+    FilterSnapshot snapshot() const requires (StateDim == 4);
+    
+    /**
+     * @brief Continue from a snapshot taken by snapshot()
+     */
+    void restore(const FilterSnapshot& snapshot) requires (StateDim == 4);
+    
+    /**
+     * @brief Predict with a pre-integrated IMU batch instead of constant velocity
+     * @details Rotates the batch's body-frame deltas into ENU by the current
+     *          heading: the GPS course (taken when moving) plus the gyro's
+     *          yaw since. Until a heading is known the batch only advances
+     *          time (x and P as a constant-velocity step, Q left to the next
+     *          fix). Adds the batch's own noise in place of Q.
+     */
+    void predictImu(const ImuDelta& delta) requires (StateDim == 4);
+    
+    /**
+     * @brief Zero-velocity update (ZUPT): a pseudo-measurement of zero
+     *        horizontal velocity while the track is known to be at rest
+     * @param std_mps Standard deviation of the pseudo-measurement per axis
+     */
+    void correctZeroVelocity(double std_mps = 0.05);
+    
     /**
      * @brief Set process noise (tuning parameter)
      * Higher = more responsive to changes
@@ -47,53 +330,141 @@ public:
     void setProcessNoise(double q);
     
     /**
-     * @brief Set measurement noise (tuning parameter)
-     * Higher = trust GPS less
+     * @brief Set the measurement noise floor (tuning parameter)
+     * Higher = trust GPS less; a fix's own accuracy can only raise it
      */
     void setMeasurementNoise(double r);
     
+    /**
+     * @brief Set gating and adaptation (resets the adaptive estimates)
+     */
+    void setTuning(const KalmanTuning& tuning);
+    const KalmanTuning& tuning() const { return tuning_; }
+    
+    const KalmanCounters& counters() const { return counters_; }
+    
+    /**
+     * @brief Outcome of the latest update()
+     */
+    FixOutcome lastOutcome() const { return last_outcome_; }
+    
+    /**
+     * @brief Normalized innovation squared of the latest fix, before gating
+     */
+    double lastInnovationDistance() const { return last_nis_; }
+    
+    /**
+     * @brief Factor the next predict applies to Q (1 unless adaptive_process_noise)
+     */
+    double processNoiseScale() const { return q_scale_; }
+    
     /**
      * @brief Enable PDR (Pedestrian Dead Reckoning) fusion
      */
     void enablePDR(bool enable) { use_pdr_ = enable; }
     
     /**
-     * @brief Detect steps from IMU accelerometer data
-     * @return true if a step was detected
+     * @brief Count steps found by a StepDetector (ignored unless PDR is enabled)
      */
-    bool detectStep(const LocationFix& imu_data);
+    void addSteps(uint32_t steps) {
+        if (use_pdr_) step_count_ += static_cast<int32_t>(steps);
+    }
+    
+    const State& state() const { return x_; }
+    const Covariance& covariance() const { return P_; }
+    const LocalTangentFrame& frame() const { return frame_; }
     
 private:
     // Kalman matrices
-    Eigen::Matrix4d A_;  // State transition matrix
-    Eigen::Matrix2d H_;  // Measurement matrix
-    Eigen::Matrix4d Q_;  // Process noise
-    Eigen::Matrix2d R_;  // Measurement noise
+    Covariance Q_;  // Process noise
+    double process_noise_;  // q that Q_ was built from
+    MeasurementCovariance R_;  // Measurement noise
+    double r_floor_ = 100.0;  // GPS accuracy ~10m std
     
     // State
-    Eigen::Vector4d x_;  // [lat, lon, lat_vel, lon_vel]
-    Eigen::Matrix4d P_;  // Covariance matrix
+    State x_;
+    Covariance P_;  // Covariance matrix
+    LocalTangentFrame frame_;  // Origin of x_'s positions
     
     // PDR state
     bool use_pdr_ = false;
-    double last_accel_z_ = 0.0;
     int32_t step_count_ = 0;
     double step_length_m_ = 0.7;  // Default average step length
     
     // History
     int64_t last_update_ms_ = 0;
     
+    // IMU heading: ENU yaw of the body's x axis, counterclockwise from east
+    double heading_rad_ = 0.0;
+    bool heading_valid_ = false;
+    bool heading_from_course_ = true;  // Re-align to the velocity at the next predictImu
+    
+    // Gating and adaptation
+    KalmanTuning tuning_;
+    double gate_;  // Resolved tuning_.gate_threshold
+    KalmanCounters counters_;
+    FixOutcome last_outcome_ = FixOutcome::Accepted;
+    uint32_t consecutive_rejections_ = 0;
+    double last_nis_ = 0.0;
+    MeasurementCovariance innovation_average_;  // C, running average of y y^T
+    double nis_average_;
+    double q_scale_ = 1.0;
+    
     /**
      * @brief Predict step (time update)
      */
     void predict(double dt);
     
     /**
-     * @brief Correct step (measurement update)
+     * @brief Correct step (measurement update), unless NIS exceeds `gate`
+     * @return false if the fix was gated (x and P unchanged)
+     */
+    bool correct(const Measurement& z, double gate);
+    
+    /**
+     * @brief Fuse the fix's speed and/or course, whichever it reports
+     */
+    void correctVelocity(const LocationFix& measurement);
+    
+    /**
+     * @brief Update with a measured horizontal velocity (east, north), unless NIS exceeds `gate`
+     */
+    bool correctVelocity(const Eigen::Vector2d& z, const Eigen::Matrix2d& R, double gate);
+    
+    /**
+     * @brief Extended update with one scalar measurement of the horizontal velocity
+     * @param y Innovation
+     * @param H Jacobian of the measurement with respect to (east, north) velocity
      */
-    void correct(const Eigen::Vector2d& z);
+    bool correctScalar(double y, const Eigen::Vector2d& H, double r, double gate);
+    
+    /**
+     * @brief Gate for a `dof`-dimensional velocity update
+     */
+    double velocityGate(int dof) const;
+    
+    /**
+     * @brief Restart at a fix the gate kept rejecting
+     */
+    void reinitialize(const LocationFix& measurement);
+    
+    void resetAdaptation();
+    
+    /**
+     * @brief S^-1
+     */
+    static MeasurementCovariance inverse(const MeasurementCovariance& S);
 };
 
+/// The daemon's filter: [east, north, east_vel, north_vel] from (lat, lon) fixes
+using KalmanFilter = BasicKalmanFilter<4, 2, ConstantVelocityModel<2>>;
+
+/// Adds altitude: [east, north, up, east_vel, north_vel, up_vel] from (lat, lon, alt) fixes
+using AltitudeKalmanFilter = BasicKalmanFilter<6, 3, ConstantVelocityModel<3>>;
+
+extern template class BasicKalmanFilter<4, 2, ConstantVelocityModel<2>>;
+extern template class BasicKalmanFilter<6, 3, ConstantVelocityModel<3>>;
+
 } // namespace s2sgeo
 
 #endif // S2SGEO_KALMAN_FILTER_HPP
@@ -0,0 +1,89 @@
+/**
+ * @file LocalTangentFrame.hpp
+ * @brief Local East-North-Up frame for filtering in metres
+ */
+
+#ifndef S2SGEO_LOCAL_TANGENT_FRAME_HPP
+#define S2SGEO_LOCAL_TANGENT_FRAME_HPP
+
+#include <numbers>
+
+namespace s2sgeo {
+
+/**
+ * @struct EnuPoint
+ * @brief Offset from a LocalTangentFrame's anchor, in metres
+ */
+struct EnuPoint {
+    double east;
+    double north;
+    double up;
+};
+
+/**
+ * @struct GeodeticPoint
+ * @brief WGS-84 position (degrees, metres)
+ */
+struct GeodeticPoint {
+    double latitude;
+    double longitude;
+    double altitude;
+};
+
+/**
+ * @class LocalTangentFrame
+ * @brief East-North-Up tangent plane around an anchor point
+ *
+ * Scales degrees by the WGS-84 meridian and prime-vertical radii of
+ * curvature at the anchor. The round trip is exact; the projection error
+ * grows with the square of the distance from the anchor (about 6 cm at
+ * REANCHOR_DISTANCE_M), so users move the anchor once they drift past it.
+ * Not meant for use within a few km of the poles.
+ */
+class LocalTangentFrame {
+public:
+    /// Distance from the anchor beyond which users should re-anchor
+    static constexpr double REANCHOR_DISTANCE_M = 1000.0;
+    
+    LocalTangentFrame() = default;
+    LocalTangentFrame(double latitude, double longitude, double altitude = 0.0) {
+        anchor(latitude, longitude, altitude);
+    }
+    
+    /**
+     * @brief Center the frame on a new point
+     */
+    void anchor(double latitude, double longitude, double altitude = 0.0);
+    
+    /**
+     * @brief Forget the anchor (isAnchored() becomes false)
+     */
+    void clear() { *this = LocalTangentFrame(); }
+    
+    bool isAnchored() const { return anchored_; }
+    
+    EnuPoint toEnu(double latitude, double longitude, double altitude = 0.0) const;
+    GeodeticPoint toGeodetic(double east, double north, double up = 0.0) const;
+    
+    /**
+     * @brief Whether a horizontal offset is far enough out to move the anchor
+     */
+    bool needsReanchor(double east, double north) const {
+        return east * east + north * north > REANCHOR_DISTANCE_M * REANCHOR_DISTANCE_M;
+    }
+    
+    GeodeticPoint anchorPoint() const { return {latitude_, longitude_, altitude_}; }
+    
+private:
+    double latitude_ = 0.0;
+    double longitude_ = 0.0;
+    double altitude_ = 0.0;
+    // Until anchor(): the frame at (0, 0), so an empty filter reports 0/0
+    double metres_per_degree_north_ = 6378137.0 * (1.0 - 6.69437999014e-3) * std::numbers::pi / 180.0;
+    double metres_per_degree_east_ = 6378137.0 * std::numbers::pi / 180.0;
+    bool anchored_ = false;
+};
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_LOCAL_TANGENT_FRAME_HPP
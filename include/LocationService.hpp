@@ -7,11 +7,22 @@
 #define S2SGEO_LOCATION_SERVICE_HPP
 
 #include "IGeoProvider.hpp"
+#include "IPCManager.hpp"
+#include "ImuPreintegrator.hpp"
 #include "KalmanFilter.hpp"
 #include "S2GeometryWrapper.hpp"
+#include "StationaryDetector.hpp"
+#include "StepDetector.hpp"
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <string>
 #include <thread>
+#include <vector>
 #include <atomic>
+#include <chrono>
 
 namespace s2sgeo {
 
@@ -25,6 +36,18 @@ namespace s2sgeo {
  * - Detect cell boundary crossings
  * - Query context provider for environmental data
  * - Write to shared memory
+ *
+ * One service thread drives every track. Each track is a tenant with its own
+ * Kalman filter and shared memory segment; the default tenant ("") is always
+ * tracked, and its segment is initialized by the caller.
+ *
+ * A track at rest (StationaryDetector) gets zero-velocity updates on its
+ * fixes and skips the filter, S2 lookup and full publish: it only writes a
+ * position heartbeat every IDLE_HEARTBEAT_PERIOD. When every track is at
+ * rest the loop sleeps that long too; moving evidence wakes it at once, and
+ * the command rings are still polled every LOOP_PERIOD. A command that needs
+ * new context (ForceRefresh, SetS2Level, ActivateProvider) gets a full
+ * update even on an idle track.
  */
 class LocationService {
 public:
@@ -51,21 +74,153 @@ public:
      */
     void injectLocation(double lat, double lon, double alt, int64_t timestamp);
     
+    /**
+     * @brief Inject a location for `tenant`, creating its track on demand
+     */
+    void injectLocation(const std::string& tenant, double lat, double lon, double alt,
+                        int64_t timestamp);
+    
+    /**
+     * @brief Inject a full fix for `tenant` (speed and course fused when
+     *        `fix.measured` says so), creating its track on demand
+     */
+    void injectFix(const std::string& tenant, const LocationFix& fix);
+    
+    /**
+     * @brief Queue IMU samples for `tenant` (sorted by timestamp)
+     * @details Pre-integrated until the next fix or service tick, then applied
+     *          as one filter prediction; steps are counted as they arrive.
+     *          Ignored until the tenant is tracked. Timestamps are epoch
+     *          microseconds on the same clock as the fixes' timestamp_ms (the
+     *          prediction moves the filter's clock to the batch's end); a batch
+     *          more than MAX_IMU_CLOCK_SKEW_MS from the newest fix is dropped.
+     */
+    void injectImu(const std::string& tenant, std::span<const ImuSample> samples);
+    
+    /**
+     * @brief Start tracking `tenant` and create its shared memory segment
+     * @return true if the tenant is tracked (already or now)
+     */
+    bool addTrack(const std::string& tenant, const SharedMemoryOptions& options = {});
+    
+    /**
+     * @brief Stop tracking `tenant` and remove its segment
+     */
+    bool removeTrack(const std::string& tenant);
+    
+    /**
+     * @brief Checkpoint of `tenant`'s filter (empty if it is not tracked),
+     *        for handing the track to another daemon instance
+     */
+    std::vector<uint8_t> checkpointTrack(const std::string& tenant) const;
+    
+    /**
+     * @brief Warm-start `tenant`'s filter from checkpointTrack() bytes,
+     *        creating its track on demand
+     * @return false if the bytes were rejected (the filter is unchanged)
+     */
+    bool restoreTrack(const std::string& tenant, std::span<const uint8_t> checkpoint);
+    
+    /**
+     * @brief Number of tracked tenants (including the default one)
+     */
+    size_t trackCount() const;
+    
 private:
-    std::unique_ptr<KalmanFilter> kalman_filter_;
+    /**
+     * @struct Track
+     * @brief Per-tenant filter state and output segment
+     */
+    struct Track {
+        SharedMemoryManager* shm = nullptr;
+        std::unique_ptr<KalmanFilter> kalman_filter;
+        ImuPreintegrator imu;         // Samples since the last filter predict
+        StationaryDetector motion;
+        StepDetector steps;           // Counts into the filter's PDR step count
+        bool idle = false;            // Stationary: heartbeats only
+        int64_t heartbeat_ns = 0;     // steady_clock time of the last idle heartbeat
+        uint64_t last_s2_cell = 0;
+        uint64_t reported_overruns = 0;
+        int s2_level = DEFAULT_S2_LEVEL;
+        int64_t last_fix_ms = 0;      // Timestamp of the newest accepted fix
+        bool imu_clock_skewed = false;  // Logged; cleared by the next accepted IMU batch
+        int64_t filtered_at_ns = 0;   // steady_clock time of the newest unpublished update
+    };
+    
+    static constexpr int DEFAULT_S2_LEVEL = 16;
+    static constexpr std::chrono::milliseconds LOOP_PERIOD{100};
+    static constexpr std::chrono::milliseconds IDLE_HEARTBEAT_PERIOD{1000};
+    static constexpr int64_t MAX_IMU_CLOCK_SKEW_MS = 60000;  // Dead reckoning is worthless by then
+    
     std::unique_ptr<S2GeometryIndex> geometry_index_;
     IContextProvider* context_provider_ = nullptr;
     
+    std::map<std::string, Track> tracks_;
+    mutable std::mutex tracks_mutex_;
+    std::vector<StepEvent> step_events_;  // injectImu() scratch, under tracks_mutex_
+    int poll_count_ = 0;                  // pollSensors() mock walk
+    
     std::atomic<bool> running_ = false;
     std::thread service_thread_;
     
-    uint64_t last_s2_cell_ = 0;
+    // Cuts the loop's sleep short when a track starts moving (or on stop())
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    bool wake_requested_ = false;
     
     /**
      * @brief Main service loop
      */
     void runServiceLoop();
     
+    /**
+     * @brief Create a track bound to `shm` (caller holds tracks_mutex_)
+     */
+    Track& createTrack(const std::string& tenant, SharedMemoryManager& shm);
+    
+    /**
+     * @brief Continue a track from a resumed segment: restore the filter
+     *        snapshot and the last published cell
+     */
+    void resumeTrack(const std::string& tenant, Track& track);
+    
+    /**
+     * @brief Smooth, classify and publish one track
+     */
+    void updateTrack(Track& track, WorldState& state);
+    
+    /**
+     * @brief Apply the track's queued IMU batch as one filter prediction
+     *        (dropped while the track is idle)
+     */
+    void flushImu(Track& track);
+    
+    /**
+     * @brief Publish the held position of a stationary track (no S2 lookup,
+     *        no filter snapshot)
+     */
+    void publishHeartbeat(Track& track, WorldState& state);
+    
+    /**
+     * @brief Run the next loop iteration now instead of after its sleep
+     */
+    void requestWake();
+    
+    /**
+     * @brief Drain and apply commands the track's adapter sent over the command ring
+     */
+    void processCommands(const std::string& tenant, Track& track);
+    
+    /**
+     * @brief Whether any track's adapter has queued commands
+     */
+    bool commandsPending() const;
+    
+    /**
+     * @brief Publish consumer lag for one track and warn about slow readers
+     */
+    void checkConsumers(const std::string& tenant, Track& track);
+    
     /**
      * @brief Poll sensor data (GPS, IMU)
      */
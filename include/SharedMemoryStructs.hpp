@@ -11,6 +11,7 @@
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <cstddef>
 
 namespace s2sgeo {
 
@@ -19,12 +20,18 @@ namespace s2sgeo {
  * @brief Raw sensor data from GPS and IMU
  */
 struct LocationFix {
+    static constexpr uint8_t HAS_SPEED = 1 << 0;    // speed is a Doppler measurement
+    static constexpr uint8_t HAS_HEADING = 1 << 1;  // heading is a course over ground
+    
     double latitude;
     double longitude;
     double altitude;
     double accuracy;        // meters
     double speed;          // m/s
-    double heading;        // degrees 0-360
+    double heading;        // degrees 0-360, clockwise from north
+    double speed_accuracy;    // m/s, 1 sigma
+    double heading_accuracy;  // degrees, 1 sigma
+    uint8_t measured;      // HAS_* bits: which of speed/heading the receiver reported
     int64_t timestamp_ms;  // milliseconds since epoch
     
     // IMU data for step detection
@@ -34,7 +41,8 @@ struct LocationFix {
     LocationFix() = default;
     LocationFix(double lat, double lon, int64_t ts)
         : latitude(lat), longitude(lon), altitude(0), accuracy(10),
-          speed(0), heading(0), timestamp_ms(ts),
+          speed(0), heading(0), speed_accuracy(0.5), heading_accuracy(10),
+          measured(0), timestamp_ms(ts),
           accel_x(0), accel_y(0), accel_z(0),
           gyro_x(0), gyro_y(0), gyro_z(0) {}
 };
@@ -50,6 +58,10 @@ struct WorldState {
     double smoothed_lon;
     double smoothed_altitude;
     
+    // Smoothed velocity in the local East-North-Up frame (m/s)
+    double velocity_east_mps;
+    double velocity_north_mps;
+    
     // S2 Geometry Cell ID (for spatial indexing)
     uint64_t s2_cell_id;
     int s2_cell_level;
@@ -96,45 +108,406 @@ struct ContextFrame {
     ContextFrame() = default;
 };
 
+/// Cache line size assumed by the shared memory layout
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * @enum RecordType
+ * @brief Kind of record in the position ring
+ */
+enum class RecordType : uint8_t {
+    FullState = 0,       // Every PositionData field is valid
+    Position = 1,        // Only lat/lon/altitude/timestamp/context_id; the rest
+                         // comes from the full record `base_offset` entries back
+    ContextChanged = 2   // Full state, first record under a new context_id
+};
+
+/**
+ * @struct PositionData
+ * @brief Per-update fields of WorldState, packed for the position ring
+ * @details Everything that changes on every fix. Context (road, hazards,
+ *          context_json) changes only on S2 cell crossings and lives in the
+ *          context slab, referenced by `context_id`.
+ */
+struct PositionData {
+    double latitude;
+    double longitude;
+    int64_t last_update_ms;
+    uint64_t s2_cell_id;
+    float altitude;
+    float estimated_distance_m;
+    uint32_t context_id;      // ContextSlot in effect for this fix (0 = none yet)
+    uint32_t step_count;
+    uint8_t s2_cell_level;
+    uint8_t is_moving;
+    RecordType record_type;
+    uint8_t base_offset;      // Position records: distance back to their full record (0 once merged)
+    int16_t velocity_east_cms;   // ENU velocity in cm/s, saturating at +/-327 m/s;
+    int16_t velocity_north_cms;  // Position records inherit it from their full record
+};
+
+static_assert(sizeof(PositionData) == 56, "PositionData must fit a PositionRecord");
+
+/// Longest run of Position records before the writer emits a full record
+inline constexpr uint32_t MAX_DELTA_CHAIN = 255;
+
+/**
+ * @struct PositionRecord
+ * @brief Single entry in the lock-free position ring (one cache line)
+ * @details `sequence` is a per-slot seqlock that also carries the global
+ *          sequence of the payload. While entry N is being copied in it holds
+ *          2N-1 (odd); once the copy is complete it holds 2N. Readers copy the
+ *          payload between two loads of `sequence` and retry if it was odd
+ *          or changed underneath them. 0 means the slot was never written.
+ */
+struct alignas(CACHE_LINE_SIZE) PositionRecord {
+    std::atomic<uint64_t> sequence;
+    PositionData data;
+};
+
+static_assert(sizeof(PositionRecord) == CACHE_LINE_SIZE,
+              "PositionRecord must occupy exactly one cache line");
+
+/**
+ * @struct ContextPayload
+ * @brief Cold context data shared by every position record that references it
+ */
+struct ContextPayload {
+    char context_json[1024];  // Same contents as WorldState::context_json
+    ContextFrame frame;
+};
+
+/**
+ * @struct ContextSlot
+ * @brief Entry in the context slab
+ * @details Context id V lives in slot (V - 1) % CONTEXT_SLAB_SIZE and uses the
+ *          same seqlock scheme as PositionRecord, keyed by V (2V-1 / 2V).
+ */
+struct alignas(CACHE_LINE_SIZE) ContextSlot {
+    std::atomic<uint64_t> sequence;
+    ContextPayload payload;
+};
+
+/**
+ * @struct ConsumerSlot
+ * @brief Registration of one reader in the consumer table
+ * @details Claimed by CAS on `pid` and then written only by its consumer;
+ *          the daemon reads it to compute lag and frees slots whose process
+ *          has exited. heartbeat_ms == 0 marks a slot that is being claimed
+ *          or released.
+ */
+struct alignas(CACHE_LINE_SIZE) ConsumerSlot {
+    std::atomic<uint32_t> pid;            // 0 = free
+    std::atomic<uint64_t> last_sequence;  // Newest entry this consumer has consumed
+    std::atomic<int64_t> heartbeat_ms;    // steady_clock time of the last report
+    std::atomic<uint64_t> overruns;       // Entries lapped before this consumer read them
+    char name[32];
+};
+
+static_assert(sizeof(ConsumerSlot) == CACHE_LINE_SIZE, "ConsumerSlot must fill one cache line");
+
+/**
+ * @enum CommandType
+ * @brief Control commands sent from the adapter to the daemon
+ */
+enum class CommandType : uint32_t {
+    None = 0,
+    ActivateProvider = 1,  // argument = provider name
+    SetAccuracy = 2,       // value = accuracy level (0.0 - 1.0)
+    SetS2Level = 3,        // int_value = S2 cell level (0 - 30)
+    ForceRefresh = 4       // Republish context on the next tick
+};
+
+/**
+ * @struct CommandRecord
+ * @brief One entry of the command ring
+ */
+struct alignas(CACHE_LINE_SIZE) CommandRecord {
+    CommandType type = CommandType::None;
+    int32_t int_value = 0;
+    double value = 0.0;
+    char argument[48] = {};
+};
+
+static_assert(sizeof(CommandRecord) == CACHE_LINE_SIZE, "CommandRecord must fill one cache line");
+
+/**
+ * @struct CommandRing
+ * @brief Lock-free SPSC ring carrying commands from one adapter to the daemon
+ * @details The adapter owns `tail`, the daemon owns `head`; each lives on its
+ *          own cache line. Entries are published by the release store of
+ *          `tail` and released back to the producer by the store of `head`.
+ */
+struct CommandRing {
+    static constexpr size_t CAPACITY = 64;  // Power of two
+    
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> tail;  // Next entry to write (adapter)
+    std::atomic<uint64_t> dropped;                        // Pushes rejected on a full ring
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head;  // Next entry to read (daemon)
+    std::atomic<uint64_t> processed;
+    CommandRecord slots[CAPACITY];
+};
+
+/**
+ * @struct FilterSnapshot
+ * @brief Kalman filter state saved in the segment for a warm restart
+ */
+struct FilterSnapshot {
+    static constexpr uint32_t FLAG_ANCHORED = 1;  // anchor_* hold the ENU frame's origin
+    
+    double state[4];        // [east, north, east_vel, north_vel] in m and m/s
+    double covariance[16];  // Row-major 4x4
+    double anchor_latitude;
+    double anchor_longitude;
+    int64_t last_update_ms;
+    uint32_t step_count;
+    uint32_t flags;
+};
+
+/**
+ * @struct RestartState
+ * @brief Daemon-private state that lets a restarted daemon resume a segment
+ * @details Saved by the service loop after every publish and read back only
+ *          when the daemon reattaches to an existing segment. `sequence`
+ *          is odd while a save is in progress, so a snapshot torn by a crash
+ *          is detected and discarded. The last WorldState, the context slab
+ *          and active_plugin need no copy here: they persist in the ring,
+ *          the slab and the header.
+ */
+struct alignas(CACHE_LINE_SIZE) RestartState {
+    std::atomic<uint64_t> sequence;  // 0 = never saved
+    uint64_t record_sequence;        // Ring entry published with this snapshot
+    FilterSnapshot filter;
+};
+
+/**
+ * @struct LatencyHistogram
+ * @brief Lock-free log2-bucketed latency histogram
+ * @details Bucket b counts samples of bit_width(ns) == b, i.e. [2^(b-1), 2^b)
+ *          nanoseconds; bucket 0 counts zero and the last bucket everything
+ *          from 2^(BUCKETS-2) ns (~137 s) up. Updated with relaxed atomics,
+ *          so a concurrent reader may see count and buckets a sample apart.
+ */
+struct alignas(CACHE_LINE_SIZE) LatencyHistogram {
+    static constexpr size_t BUCKETS = 40;
+    
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> buckets[BUCKETS];
+};
+
+/**
+ * @enum LatencyMetric
+ * @brief Histograms of the StatsBlock
+ */
+enum class LatencyMetric : uint32_t {
+    SensorToFilter = 0,   // Fix timestamp to Kalman update
+    FilterToPublish = 1,  // Kalman update to ring publish
+    ProviderFetch = 2,    // IContextProvider::getContext() duration
+    LoopJitter = 3,       // Deviation of a service loop tick from its period
+    Count
+};
+
+/**
+ * @enum StatCounter
+ * @brief Event counters of the StatsBlock
+ */
+enum class StatCounter : uint32_t {
+    CellCrossings = 0,     // S2 cell changes that triggered a context fetch
+    ContextCacheHits = 1,  // publishContext() calls that found the context current
+    DroppedFixes = 2,      // Fixes rejected before reaching the filter
+    LoopIterations = 3,
+    GatedFixes = 4,        // Fixes the filter's innovation gate rejected as outliers
+    FilterRestarts = 5,    // Filter restarts after a run of gated fixes
+    IdleHeartbeats = 6,    // Heartbeats published in place of full updates while stationary
+    StationaryPeriods = 7, // Times a track went stationary
+    Count
+};
+
 /**
- * @struct RingBufferEntry
- * @brief Single entry in the lock-free ring buffer
+ * @struct StatsBlock
+ * @brief Daemon instrumentation, read by s2sgeo_stat without stopping the daemon
+ * @details Written only by the daemon, with relaxed atomics; never on the
+ *          adapters' read path.
  */
-struct RingBufferEntry {
-    std::atomic<uint32_t> sequence;
-    WorldState state;
-    ContextFrame context;
+struct alignas(CACHE_LINE_SIZE) StatsBlock {
+    static constexpr size_t NUM_HISTOGRAMS = static_cast<size_t>(LatencyMetric::Count);
+    static constexpr size_t NUM_COUNTERS = 8;  // Room for new counters without an ABI bump
+    
+    LatencyHistogram histograms[NUM_HISTOGRAMS];
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> counters[NUM_COUNTERS];
 };
 
+static_assert(static_cast<size_t>(StatCounter::Count) <= StatsBlock::NUM_COUNTERS,
+              "StatsBlock has no room for every StatCounter");
+
+/**
+ * @brief Ring slot holding global sequence `sequence` (1-based)
+ * @param ring_capacity Power of two
+ */
+inline size_t ringSlot(uint64_t sequence, uint32_t ring_capacity) {
+    return static_cast<size_t>((sequence - 1) & (ring_capacity - 1));
+}
+
+/**
+ * @brief Pack the per-update fields of a WorldState into a ring record
+ */
+PositionData toPositionData(const WorldState& state, uint32_t context_id);
+
+/**
+ * @brief Overlay a Position record on the full record it extends
+ * @return `base` with the position fields and context of `delta`, tagged as
+ *         a Position record
+ */
+PositionData mergePositionDelta(const PositionData& base, const PositionData& delta);
+
+/**
+ * @brief Unpack a ring record into a WorldState (context_json is left untouched)
+ */
+void applyPositionData(const PositionData& data, uint64_t sequence, WorldState& state);
+
 /**
  * @struct SharedMemoryHeader
- * @brief Control structure for the shared memory ring buffer
+ * @brief Control structure for the shared memory ring buffer (ABI v9)
+ * @details The segment holds this header, the daemon's RestartState, a
+ *          ring_capacity-entry ring of PositionRecords (hot, one cache line
+ *          per update), a CONTEXT_SLAB_SIZE-entry slab of ContextSlots
+ *          (cold, rewritten only when the context actually changes), a
+ *          MAX_CONSUMERS-entry table of ConsumerSlots, the
+ *          adapter-to-daemon CommandRing and the daemon's StatsBlock.
+ *
+ *          Fields are grouped by owner, one 64-byte line each, so readers
+ *          polling the producer line never dirty it and the writer never
+ *          misses on lines readers update:
+ *            - identity: magic/version/layout hash and offsets, written once
+ *              (two lines)
+ *            - producer: written on every publish by the daemon
+ *            - consumer: written by adapters (retry stats, futex sleepers)
+ *            - control:  liveness, configuration and consumer lag, written rarely
  */
-struct SharedMemoryHeader {
-    static constexpr size_t RING_BUFFER_SIZE = 1024;
+struct alignas(CACHE_LINE_SIZE) SharedMemoryHeader {
+    static constexpr size_t RING_BUFFER_SIZE = 1024;  // Default ring capacity
+    static constexpr size_t CONTEXT_SLAB_SIZE = 8;
+    static constexpr size_t MAX_CONSUMERS = 16;       // Consumer table slots
+    static constexpr uint32_t MAX_READ_RETRIES = 16;  // Seqlock retries per read
+    static constexpr uint32_t MAGIC = 0x47533253;     // "S2SG" little-endian
+    static constexpr uint32_t ABI_VERSION = 9;
     
-    // Ring buffer pointers
-    std::atomic<uint32_t> write_index;
-    std::atomic<uint32_t> read_index;
+    // Identity line: published last by the server (magic), checked by connectClient()
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t layout_hash;
+    uint32_t ring_capacity;
+    uint64_t restart_state_offset;
+    uint64_t ring_offset;
+    uint64_t context_slab_offset;
+    uint64_t consumer_table_offset;
+    uint64_t command_ring_offset;
+    uint64_t stats_offset;
+    uint64_t segment_size;
     
-    // Global state
-    std::atomic<uint32_t> global_sequence;
-    std::atomic<bool> location_service_alive;
+    // Producer line
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> global_sequence;  // Newest entry (1-based), in ringSlot()
+    std::atomic<uint32_t> update_futex;   // Bumped on every publish
+    std::atomic<uint32_t> context_id;     // Newest context in the slab (0 = none)
+    std::atomic<uint64_t> total_updates;
+    std::atomic<uint64_t> total_context_updates;
+    std::atomic<uint64_t> last_full_sequence;  // Newest FullState/ContextChanged record
     
-    // Configuration
-    char active_plugin[64];  // "cycling", "dating", etc.
-    double accuracy_level;   // 1.0 = full, 0.5 = degraded
+    // Consumer line
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> futex_waiters;  // Readers sleeping on update_futex
+    std::atomic<uint64_t> read_retries;   // Seqlock retries taken by readers
+    std::atomic<uint64_t> failed_reads;   // Reads abandoned after MAX_READ_RETRIES
     
-    // Statistics
-    uint64_t total_updates;
-    uint64_t total_context_updates;
+    // Control line
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> location_service_alive;
+    std::atomic<uint32_t> active_consumers;   // Published by the daemon with max_consumer_lag
+    std::atomic<double> accuracy_level;       // 1.0 = full, 0.5 = degraded
+    std::atomic<uint64_t> max_consumer_lag;   // Entries the slowest consumer is behind
+    char active_plugin[32];                   // "cycling", "dating", etc.
     
     SharedMemoryHeader() 
-        : write_index(0), read_index(0), global_sequence(0),
-          location_service_alive(false), accuracy_level(1.0),
-          total_updates(0), total_context_updates(0) {}
+        : magic(0), version(ABI_VERSION), layout_hash(0),
+          ring_capacity(0), restart_state_offset(0), ring_offset(0), context_slab_offset(0),
+          consumer_table_offset(0), command_ring_offset(0), stats_offset(0), segment_size(0),
+          global_sequence(0), update_futex(0), context_id(0),
+          total_updates(0), total_context_updates(0), last_full_sequence(0),
+          futex_waiters(0), read_retries(0), failed_reads(0),
+          location_service_alive(false), active_consumers(0), accuracy_level(1.0),
+          max_consumer_lag(0), active_plugin{} {}
 };
 
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+              std::atomic<uint32_t>::is_always_lock_free &&
+              std::atomic<double>::is_always_lock_free,
+              "Shared memory atomics must be lock-free to work across processes");
+static_assert(offsetof(SharedMemoryHeader, global_sequence) == 2 * CACHE_LINE_SIZE,
+              "Producer fields must start on their own cache line");
+static_assert(offsetof(SharedMemoryHeader, futex_waiters) == 3 * CACHE_LINE_SIZE,
+              "Consumer fields must start on their own cache line");
+static_assert(offsetof(SharedMemoryHeader, location_service_alive) == 4 * CACHE_LINE_SIZE,
+              "Control fields must start on their own cache line");
+static_assert(sizeof(SharedMemoryHeader) == 5 * CACHE_LINE_SIZE,
+              "SharedMemoryHeader must be exactly five cache lines");
+
+/**
+ * @brief Fingerprint of the shared memory ABI compiled into this binary
+ * @details FNV-1a over the sizes and offsets both processes depend on.
+ *          Stored in the header by the daemon; an adapter built against a
+ *          different layout refuses to attach.
+ */
+constexpr uint64_t sharedMemoryLayoutHash() {
+    const uint64_t fields[] = {
+        SharedMemoryHeader::ABI_VERSION,
+        CACHE_LINE_SIZE,
+        SharedMemoryHeader::CONTEXT_SLAB_SIZE,
+        SharedMemoryHeader::MAX_CONSUMERS,
+        sizeof(SharedMemoryHeader),
+        offsetof(SharedMemoryHeader, ring_capacity),
+        offsetof(SharedMemoryHeader, global_sequence),
+        offsetof(SharedMemoryHeader, update_futex),
+        offsetof(SharedMemoryHeader, context_id),
+        offsetof(SharedMemoryHeader, futex_waiters),
+        offsetof(SharedMemoryHeader, location_service_alive),
+        offsetof(SharedMemoryHeader, max_consumer_lag),
+        offsetof(SharedMemoryHeader, active_plugin),
+        sizeof(PositionRecord),
+        offsetof(PositionRecord, data),
+        sizeof(PositionData),
+        offsetof(PositionData, context_id),
+        offsetof(PositionData, record_type),
+        offsetof(PositionData, velocity_east_cms),
+        offsetof(SharedMemoryHeader, last_full_sequence),
+        sizeof(ContextSlot),
+        offsetof(ContextSlot, payload),
+        sizeof(ContextPayload),
+        sizeof(ContextFrame),
+        sizeof(ConsumerSlot),
+        offsetof(ConsumerSlot, overruns),
+        sizeof(CommandRecord),
+        offsetof(SharedMemoryHeader, restart_state_offset),
+        sizeof(RestartState),
+        offsetof(RestartState, filter),
+        offsetof(SharedMemoryHeader, stats_offset),
+        LatencyHistogram::BUCKETS,
+        sizeof(LatencyHistogram),
+        sizeof(StatsBlock),
+        offsetof(StatsBlock, counters),
+        CommandRing::CAPACITY,
+        offsetof(CommandRing, head),
+        offsetof(CommandRing, slots),
+    };
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint64_t field : fields) {
+        for (int byte = 0; byte < 8; ++byte) {
+            hash ^= (field >> (byte * 8)) & 0xff;
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
 } // namespace s2sgeo
 
 #endif // S2SGEO_SHARED_MEMORY_STRUCTS_HPP
@@ -0,0 +1,42 @@
+/**
+ * @file SimdDispatch.hpp
+ * @brief Run-time choice of the instruction set for vectorized kernels
+ */
+
+#ifndef S2SGEO_SIMD_DISPATCH_HPP
+#define S2SGEO_SIMD_DISPATCH_HPP
+
+#include <cstdint>
+
+// Kernels built with [[gnu::target]] for wider instruction sets than the baseline
+#if defined(__x86_64__) && defined(__GNUC__)
+#define S2SGEO_SIMD_X86 1
+#endif
+
+namespace s2sgeo {
+
+/**
+ * @enum SimdPath
+ * @brief Instruction set a kernel runs with
+ */
+enum class SimdPath : uint8_t {
+    Scalar,   // Baseline build (any CPU)
+    AVX2,     // 4 doubles per instruction, with FMA
+    AVX512    // 8 doubles per instruction
+};
+
+/**
+ * @brief Whether this CPU and build can run `path`
+ */
+bool simdPathSupported(SimdPath path);
+
+/**
+ * @brief Widest path supported by this CPU and build
+ */
+SimdPath bestSimdPath();
+
+const char* simdPathName(SimdPath path);
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_SIMD_DISPATCH_HPP
@@ -0,0 +1,96 @@
+/**
+ * @file StationaryDetector.hpp
+ * @brief Stationarity from IMU variance and filter speed, for ZUPT and idle mode
+ */
+
+#ifndef S2SGEO_STATIONARY_DETECTOR_HPP
+#define S2SGEO_STATIONARY_DETECTOR_HPP
+
+#include "ImuPreintegrator.hpp"
+#include <cstdint>
+
+namespace s2sgeo {
+
+/**
+ * @class StationaryDetector
+ * @brief Decides when a track is at rest, and notices the instant it is not
+ *
+ * Two kinds of evidence:
+ * - IMU: running variance of |accel| and mean |gyro| over about WINDOW_S.
+ *   A device in a pocket or a parked mount still vibrates, but far less than
+ *   walking or riding.
+ * - Speed: the filter's (or the receiver's Doppler) speed after each fix.
+ *
+ * The track becomes stationary once every input has been still for SETTLE_MS
+ * (a track without an IMU goes by speed alone), as shown by still samples at
+ * both ends of that span. Any moving evidence ends it at once:
+ * addImu()/addSpeed() return true on that edge, so the caller can wake its
+ * loop instead of waiting for the next tick. No evidence at all for
+ * EVIDENCE_TIMEOUT_MS (e.g. a GPS outage on a track without an IMU) ends it
+ * too: silence is not proof of rest.
+ */
+class StationaryDetector {
+public:
+    static constexpr double WINDOW_S = 0.5;               // IMU averaging time constant
+    static constexpr double ACCEL_STD_THRESHOLD = 0.25;   // m/s^2, std of |accel|
+    static constexpr double GYRO_THRESHOLD = 0.1;         // rad/s, mean |gyro|
+    static constexpr double SPEED_THRESHOLD = 0.5;        // m/s
+    static constexpr int64_t SETTLE_MS = 3000;
+    static constexpr int64_t EVIDENCE_TIMEOUT_MS = 5000;  // A few missed 1 Hz fixes
+    
+    /**
+     * @brief Feed one IMU sample
+     * @return true if it ended a stationary period
+     */
+    bool addImu(const ImuSample& sample);
+    
+    /**
+     * @brief Feed a speed estimate (m/s) taken at `timestamp_ms`
+     * @return true if it ended a stationary period
+     */
+    bool addSpeed(double speed_mps, int64_t timestamp_ms);
+    
+    /**
+     * @brief Force moving (e.g. the filter gated a fix: something changed)
+     * @return true if it ended a stationary period
+     */
+    bool markMoving(int64_t timestamp_ms);
+    
+    /**
+     * @brief Whether the track has been still for SETTLE_MS at `now_ms`
+     * @details Latches: stays true until moving evidence arrives, or no still
+     *          evidence has arrived for EVIDENCE_TIMEOUT_MS.
+     */
+    bool stationary(int64_t now_ms);
+    
+    /**
+     * @brief Start over (e.g. on a filter reset)
+     */
+    void reset();
+    
+private:
+    /**
+     * @brief Record still evidence: starts the SETTLE_MS clock if it is not running
+     */
+    void still(int64_t timestamp_ms);
+    
+    /**
+     * @brief Record moving evidence
+     * @return true if the track was stationary
+     */
+    bool moving();
+    
+    // IMU statistics (exponential moving averages)
+    double accel_mean_ = 0.0;
+    double accel_variance_ = 0.0;
+    double gyro_mean_ = 0.0;
+    int64_t last_imu_us_ = 0;  // 0 = no sample yet
+    
+    int64_t still_since_ms_ = 0;  // 0 = the latest evidence was moving
+    int64_t last_still_ms_ = 0;   // Newest still evidence since still_since_ms_
+    bool stationary_ = false;
+};
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_STATIONARY_DETECTOR_HPP
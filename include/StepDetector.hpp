@@ -0,0 +1,120 @@
+/**
+ * @file StepDetector.hpp
+ * @brief Streaming step detection for Pedestrian Dead Reckoning
+ */
+
+#ifndef S2SGEO_STEP_DETECTOR_HPP
+#define S2SGEO_STEP_DETECTOR_HPP
+
+#include "ImuPreintegrator.hpp"
+#include "SimdDispatch.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace s2sgeo {
+
+/**
+ * @struct StepEvent
+ * @brief One detected step
+ */
+struct StepEvent {
+    int64_t timestamp_us;  // Time of the acceleration peak
+    double peak_accel;     // Low-passed |accel| at the peak, m/s^2
+    double interval_s;     // Since the previous step; 0 for the first step of a walk
+};
+
+/**
+ * @class StepDetector
+ * @brief Counts steps in a 100-400 Hz accelerometer stream, block by block
+ *
+ * Each block of up to BLOCK samples goes through three passes:
+ * 1. |accel|^2 per sample (no sqrt: peaks of |a|^2 and |a| coincide)
+ * 2. Low-pass: a Hann-window FIR of FILTER_WINDOW_S (about 5 Hz cutoff),
+ *    which keeps the 1.5-2.5 Hz step rhythm and drops vibration and noise
+ * 3. Peak scan: a step is a local maximum above mean + THRESHOLD_STDS std
+ *    (at least MIN_PEAK_ACCEL above the mean), after the signal has dipped
+ *    below the mean, and MIN_STEP_INTERVAL_S after the previous step
+ *
+ * Passes 1 and 2 and the block statistics are branch-free loops over
+ * contiguous arrays that the compiler vectorizes; pass 2, which is most of
+ * the work, also has an AVX2 build picked at run time (bestSimdPath()). Only
+ * pass 3 is serial, and it is a few compares per sample. The mean and std
+ * adapt to the walker across blocks with time constant STATS_TIME_CONSTANT_S,
+ * so soft and heavy steps are counted alike. Events are reported FIR group delay (half the
+ * window) after they happen, stamped with the peak's own time.
+ */
+class StepDetector {
+public:
+    static constexpr size_t BLOCK = 64;                    // Samples per kernel pass
+    static constexpr double FILTER_WINDOW_S = 0.15;
+    static constexpr double MIN_STEP_INTERVAL_S = 0.25;    // At most 240 steps/min
+    static constexpr double MAX_STEP_INTERVAL_S = 2.0;     // A longer gap ends the walk
+    static constexpr double THRESHOLD_STDS = 0.7;
+    static constexpr double MIN_PEAK_ACCEL = 0.6;          // m/s^2 above the mean |accel|
+    static constexpr double STATS_TIME_CONSTANT_S = 2.0;
+    
+    /**
+     * @param sample_rate_hz Nominal IMU rate; sets the FIR length
+     */
+    explicit StepDetector(double sample_rate_hz = 200.0);
+    
+    /**
+     * @brief Process samples in structure-of-arrays form (all spans one length)
+     * @return Steps appended to `events`
+     */
+    size_t process(std::span<const int64_t> timestamps_us, std::span<const double> accel_x,
+                   std::span<const double> accel_y, std::span<const double> accel_z,
+                   std::vector<StepEvent>& events);
+    
+    /**
+     * @brief Process ImuSamples (only the timestamp and accelerometer are used)
+     */
+    size_t process(std::span<const ImuSample> samples, std::vector<StepEvent>& events);
+    
+    uint64_t stepCount() const { return step_count_; }
+    
+    /**
+     * @brief Steps per minute over the recent steps; 0 once MAX_STEP_INTERVAL_S
+     *        has passed without one
+     */
+    double cadence() const;
+    
+    /**
+     * @brief Forget the signal history and statistics (the step count is kept)
+     */
+    void reset();
+    
+private:
+    /**
+     * @brief Run the three passes over magnitude_/timestamps_[taps - 1, taps - 1 + n)
+     */
+    void processBlock(size_t n, std::vector<StepEvent>& events);
+    
+    std::vector<double> taps_;         // Normalized Hann window, symmetric
+    size_t history_;                   // taps_.size() - 1 samples carried between blocks
+    std::vector<double> magnitude_;    // |accel|^2: history_ + BLOCK
+    std::vector<int64_t> timestamps_;  // Same layout as magnitude_
+    std::vector<double> filtered_;     // BLOCK
+    SimdPath simd_path_;               // Any path but Scalar selects the AVX2 low-pass
+    
+    // Signal statistics (exponential moving averages of the filtered |accel|^2)
+    bool primed_ = false;
+    double mean_ = 0.0;
+    double mean_square_ = 0.0;
+    
+    // Peak scan state, carried across blocks
+    double previous_ = 0.0;
+    double before_previous_ = 0.0;
+    int64_t previous_us_ = 0;
+    bool armed_ = false;
+    
+    int64_t last_step_us_ = 0;
+    int64_t latest_us_ = 0;
+    double interval_average_s_ = 0.0;  // 0 = not walking
+    uint64_t step_count_ = 0;
+};
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_STEP_DETECTOR_HPP
@@ -0,0 +1,81 @@
+/**
+ * @file TrajectorySmoother.hpp
+ * @brief Fixed-interval Rauch-Tung-Striebel smoothing of recorded trajectories
+ */
+
+#ifndef S2SGEO_TRAJECTORY_SMOOTHER_HPP
+#define S2SGEO_TRAJECTORY_SMOOTHER_HPP
+
+#include "KalmanFilter.hpp"
+#include "LocalTangentFrame.hpp"
+#include <span>
+#include <vector>
+
+namespace s2sgeo {
+
+/**
+ * @struct SmoothedFix
+ * @brief Smoothed estimate at the time of one input fix
+ */
+struct SmoothedFix {
+    int64_t timestamp_ms;
+    double latitude;
+    double longitude;
+    double velocity_east_mps;
+    double velocity_north_mps;
+    double position_std_m;  // Per horizontal axis, from the smoothed covariance
+    FixOutcome outcome;     // What the forward filter did with the fix
+};
+
+/**
+ * @class TrajectorySmoother
+ * @brief Forward KalmanFilter pass plus a backward RTS pass over a whole track
+ *
+ * Every estimate uses all fixes, before and after it, so turns no longer lag
+ * and gated outliers are bridged from both sides. The forward pass is the
+ * daemon's KalmanFilter (gating, re-anchoring and all); the backward pass
+ * recomputes each prediction from the filtered state, so nothing beyond the
+ * filtered state, covariance and frame is stored per fix. A filter restart
+ * splits the track: no smoothing across it.
+ *
+ * One instance per thread; buffers are reused between smooth() calls.
+ */
+class TrajectorySmoother {
+public:
+    TrajectorySmoother() = default;
+    
+    /**
+     * @brief Smooth fixes sorted by timestamp into out (one entry per fix)
+     */
+    void smooth(std::span<const LocationFix> fixes, std::vector<SmoothedFix>& out);
+    
+    /**
+     * @brief Forward-filter tuning (see KalmanFilter)
+     */
+    void setProcessNoise(double q) { process_noise_ = q; }
+    void setMeasurementNoise(double r) { measurement_noise_ = r; }
+    void setTuning(const KalmanTuning& tuning) { tuning_ = tuning; }
+    
+private:
+    /**
+     * @brief Forward-pass output for one fix
+     */
+    struct Step {
+        KalmanFilter::State x;
+        KalmanFilter::Covariance P;
+        LocalTangentFrame frame;
+        double dt;             // Predict step that led here
+        double q_scale;        // Adaptive Q scale the next predict uses
+        FixOutcome outcome;
+    };
+    
+    double process_noise_ = 0.1;
+    double measurement_noise_ = 100.0;
+    KalmanTuning tuning_;
+    KalmanFilter filter_;
+    std::vector<Step> steps_;
+};
+
+} // namespace s2sgeo
+
+#endif // S2SGEO_TRAJECTORY_SMOOTHER_HPP
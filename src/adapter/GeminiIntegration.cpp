@@ -14,8 +14,8 @@ using json = nlohmann::json;
 
 namespace s2sgeo {
 
-GeminiIntegration::GeminiIntegration()
-    : s2s_client_(std::make_unique<S2SClient>()) {
+GeminiIntegration::GeminiIntegration(SharedMemoryManager& shm)
+    : shm_(shm), s2s_client_(std::make_unique<S2SClient>()) {
 }
 
 GeminiIntegration::~GeminiIntegration() {
@@ -50,13 +50,32 @@ void GeminiIntegration::stop() {
 void GeminiIntegration::contextUpdateLoop() {
     std::cout << "[GeminiIntegration] Context update thread started" << std::endl;
     
+    // Register so the daemon can report how far behind this loop falls
+    int32_t consumer_slot = IPCReader::registerConsumer("gemini", shm_);
+    
+    uint64_t last_seen_seq = 0;
     while (running_) {
         try {
+            // Sleep until the daemon publishes (bounded so stop() stays responsive)
+            if (!IPCReader::waitForUpdate(last_seen_seq, std::chrono::milliseconds(500), shm_)) {
+                continue;
+            }
+            last_seen_seq = IPCReader::latestSequence(shm_);
+            IPCReader::reportConsumed(consumer_slot, last_seen_seq, 0, shm_);
+            
+            // Contexts are deduplicated by the daemon, so an unchanged id
+            // means nothing to inject; skip the full copy
+            auto context_id = IPCReader::readLatestField(&PositionData::context_id, shm_);
+            if (!context_id || *context_id == last_context_id_) {
+                continue;
+            }
+            last_context_id_ = *context_id;
+            
             // Read latest state from shared memory
             WorldState state;
             ContextFrame context;
             
-            if (IPCReader::readLatestState(state, context)) {
+            if (IPCReader::readLatestState(state, context, shm_)) {
                 // Hash context to detect changes
                 uint64_t context_hash = hashContext(context);
                 
@@ -98,13 +117,13 @@ void GeminiIntegration::contextUpdateLoop() {
                               << state.smoothed_lat << ", " << state.smoothed_lon << std::endl;
                 }
             }
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
-            
+        
         } catch (const std::exception& e) {
             std::cerr << "[GeminiIntegration] Error in context loop: " << e.what() << std::endl;
         }
     }
+    
+    IPCReader::unregisterConsumer(consumer_slot, shm_);
 }
 
 uint64_t GeminiIntegration::hashContext(const ContextFrame& ctx) {
@@ -4,9 +4,14 @@
  */
 
 #include "GeminiIntegration.hpp"
+#include "IPCCommandRing.hpp"
 #include "IPCManager.hpp"
 #include "IPCReader.hpp"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
 #include <thread>
 #include <chrono>
 
@@ -15,9 +20,41 @@ int main(int argc, char* argv[]) {
     std::cout << "S2S Geospatial Adapter - Client" << std::endl;
     std::cout << "======================================" << std::endl;
     
+    // Must match the daemon's --shm-file when it maps a file instead of POSIX shm;
+    // --tenant NAME attaches to one of the daemon's per-device segments.
+    // --provider NAME, --accuracy X and --s2-level N are sent to the daemon.
+    s2sgeo::SharedMemoryOptions shm_options;
+    std::string tenant;
+    std::vector<s2sgeo::CommandRecord> commands;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--shm-file" && i + 1 < argc) {
+            shm_options.backing_file = argv[++i];
+        } else if (arg == "--lock-pages") {
+            shm_options.lock_pages = true;
+        } else if (arg == "--tenant" && i + 1 < argc) {
+            tenant = argv[++i];
+        } else if (arg == "--provider" && i + 1 < argc) {
+            s2sgeo::CommandRecord command;
+            command.type = s2sgeo::CommandType::ActivateProvider;
+            std::strncpy(command.argument, argv[++i], sizeof(command.argument) - 1);
+            commands.push_back(command);
+        } else if (arg == "--accuracy" && i + 1 < argc) {
+            s2sgeo::CommandRecord command;
+            command.type = s2sgeo::CommandType::SetAccuracy;
+            command.value = std::atof(argv[++i]);
+            commands.push_back(command);
+        } else if (arg == "--s2-level" && i + 1 < argc) {
+            s2sgeo::CommandRecord command;
+            command.type = s2sgeo::CommandType::SetS2Level;
+            command.int_value = std::atoi(argv[++i]);
+            commands.push_back(command);
+        }
+    }
+    
     // Connect to shared memory
-    auto& shm_mgr = s2sgeo::SharedMemoryManager::getInstance();
-    if (!shm_mgr.connectClient()) {
+    auto& shm_mgr = s2sgeo::SharedMemoryManager::getInstance(tenant);
+    if (!shm_mgr.connectClient(shm_options)) {
         std::cerr << "Failed to connect to shared memory" << std::endl;
         std::cerr << "Make sure location daemon is running" << std::endl;
         return 1;
@@ -26,23 +63,29 @@ int main(int argc, char* argv[]) {
     // Check if location service is alive
     std::cout << "Waiting for location service..." << std::endl;
     for (int i = 0; i < 30; ++i) {
-        if (s2sgeo::IPCReader::isLocationServiceAlive()) {
+        if (s2sgeo::IPCReader::isLocationServiceAlive(shm_mgr)) {
             std::cout << "Location service is alive!" << std::endl;
             break;
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
-    if (!s2sgeo::IPCReader::isLocationServiceAlive()) {
+    if (!s2sgeo::IPCReader::isLocationServiceAlive(shm_mgr)) {
         std::cerr << "Location service did not start" << std::endl;
         return 1;
     }
     
+    for (const auto& command : commands) {
+        if (!s2sgeo::IPCCommandRing::push(command, shm_mgr)) {
+            std::cerr << "Command ring full, dropped a command" << std::endl;
+        }
+    }
+    
     // Start Gemini integration
     // NOTE: In production, use actual Gemini API key
     std::string api_key = "YOUR_GEMINI_API_KEY_HERE";
     
-    auto gemini = std::make_unique<s2sgeo::GeminiIntegration>();
+    auto gemini = std::make_unique<s2sgeo::GeminiIntegration>(shm_mgr);
     if (!gemini->start(api_key)) {
         std::cerr << "Failed to start Gemini integration" << std::endl;
         return 1;
@@ -56,15 +99,28 @@ int main(int argc, char* argv[]) {
     while (true) {
         std::this_thread::sleep_for(std::chrono::seconds(2));
         
-        s2sgeo::WorldState state;
-        s2sgeo::ContextFrame context;
+        // Project just the status fields out of shared memory in place
+        struct StatusFields {
+            double lat, lon;
+            bool is_moving;
+            uint32_t context_id;
+        };
+        auto status = s2sgeo::IPCReader::readProjected([](const s2sgeo::PositionData& data) {
+            return StatusFields{data.latitude, data.longitude, data.is_moving != 0, data.context_id};
+        }, shm_mgr);
         
-        if (s2sgeo::IPCReader::readLatestState(state, context)) {
+        if (status) {
+            auto road = s2sgeo::IPCReader::readContextProjected(status->context_id,
+                [](const s2sgeo::ContextPayload& payload) {
+                    return std::string(payload.frame.road_name,
+                                       strnlen(payload.frame.road_name, sizeof(payload.frame.road_name)));
+                }, shm_mgr);
+            
             std::cout << "[Adapter " << (++iteration) << "] "
-                      << "Lat: " << state.smoothed_lat << " "
-                      << "Lon: " << state.smoothed_lon << " "
-                      << "Moving: " << (state.is_moving ? "Yes" : "No")
-                      << " Road: " << context.road_name << std::endl;
+                      << "Lat: " << status->lat << " "
+                      << "Lon: " << status->lon << " "
+                      << "Moving: " << (status->is_moving ? "Yes" : "No")
+                      << " Road: " << road.value_or("") << std::endl;
         }
     }
     
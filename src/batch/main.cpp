@@ -0,0 +1,314 @@
+/**
+ * @file main.cpp (Batch)
+ * @brief s2sgeo_batch: RTS-smooth recorded trajectory files on all cores
+ *
+ * Input: one CSV per trajectory, `timestamp_ms,latitude,longitude[,accuracy_m]`
+ * per line (lines not starting with a number, e.g. a header, are skipped).
+ * Output: `<name>.smoothed.csv` next to the input or in --output-dir, one row
+ * per fix. stdout gets one tab-separated summary line per file, in input order;
+ * its distance leaves out the jumps at filter restarts.
+ *
+ * Input is read and parsed IO_CHUNK_BYTES at a time and output written the
+ * same way, but each file's fixes, forward-pass steps and smoothed rows are
+ * held whole (about 420 bytes per fix): the backward pass needs the entire
+ * track. A day of 1 Hz fixes is about 36 MB per worker.
+ */
+
+#include "TrajectorySmoother.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <numbers>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t IO_CHUNK_BYTES = 1 << 20;
+
+/**
+ * @brief Per-file result, printed after all workers finish
+ */
+struct FileResult {
+    bool ok = false;
+    size_t fixes = 0;
+    size_t dropped = 0;  // Unparsable, non-finite or out-of-order lines
+    size_t gated = 0;
+    size_t restarts = 0;
+    double distance_m = 0.0;
+};
+
+/**
+ * @brief Worker-local buffers, reused from one file to the next
+ */
+struct Worker {
+    s2sgeo::TrajectorySmoother smoother;
+    std::vector<s2sgeo::LocationFix> fixes;
+    std::vector<s2sgeo::SmoothedFix> smoothed;
+    std::string input;   // Unparsed tail of the current chunk
+    std::string output;
+};
+
+/**
+ * @brief Parse the `timestamp_ms,latitude,longitude[,accuracy_m]` lines in [p, end)
+ */
+void parseLines(const char* p, const char* end, std::vector<s2sgeo::LocationFix>& fixes, size_t& dropped) {
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        const char* line = p;
+        p = eol + 1;
+        
+        if (line == eol || !(std::isdigit(static_cast<unsigned char>(*line)) || *line == '-')) continue;
+        
+        int64_t timestamp_ms = 0;
+        double values[3] = {0.0, 0.0, 10.0};  // latitude, longitude, accuracy
+        auto parsed = std::from_chars(line, eol, timestamp_ms);
+        int fields = parsed.ec == std::errc() ? 1 : 0;
+        const char* q = parsed.ptr;
+        for (double& value : values) {
+            if (fields == 0 || q >= eol || *q != ',') break;
+            auto field = std::from_chars(q + 1, eol, value);
+            if (field.ec != std::errc()) break;
+            q = field.ptr;
+            ++fields;
+        }
+        
+        // Same rejections as LocationService::injectLocation
+        bool valid = fields >= 3 && std::isfinite(values[0]) && std::isfinite(values[1]) &&
+                     (fixes.empty() || timestamp_ms >= fixes.back().timestamp_ms);
+        if (!valid) {
+            ++dropped;
+            continue;
+        }
+        s2sgeo::LocationFix fix(values[0], values[1], timestamp_ms);
+        if (fields == 4 && std::isfinite(values[2]) && values[2] > 0.0) {
+            fix.accuracy = values[2];
+        }
+        fixes.push_back(fix);
+    }
+}
+
+/**
+ * @brief Read and parse a file IO_CHUNK_BYTES at a time
+ * @details `buffer` only ever holds one chunk plus the line it cut in two.
+ */
+bool readFixes(const std::string& path, std::string& buffer, std::vector<s2sgeo::LocationFix>& fixes,
+               size_t& dropped) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    fixes.clear();
+    dropped = 0;
+    buffer.clear();
+    while (true) {
+        size_t carried = buffer.size();
+        buffer.resize(carried + IO_CHUNK_BYTES);
+        size_t n = std::fread(buffer.data() + carried, 1, IO_CHUNK_BYTES, file);
+        buffer.resize(carried + n);
+        bool last = n < IO_CHUNK_BYTES;
+        
+        // Complete lines only; the partial one waits for the next chunk
+        size_t complete = last ? buffer.size() : buffer.rfind('\n') + 1;  // npos + 1 == 0
+        parseLines(buffer.data(), buffer.data() + complete, fixes, dropped);
+        buffer.erase(0, complete);
+        if (last) break;
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+/**
+ * @brief Great-circle distance (haversine on the mean Earth radius)
+ */
+double distanceMeters(double lat1, double lon1, double lat2, double lon2) {
+    constexpr double EARTH_RADIUS_M = 6371008.8;
+    constexpr double RADIANS_PER_DEGREE = std::numbers::pi / 180.0;
+    double dlat = (lat2 - lat1) * RADIANS_PER_DEGREE;
+    double dlon = (lon2 - lon1) * RADIANS_PER_DEGREE;
+    double a = std::sin(dlat / 2) * std::sin(dlat / 2) +
+               std::cos(lat1 * RADIANS_PER_DEGREE) * std::cos(lat2 * RADIANS_PER_DEGREE) *
+               std::sin(dlon / 2) * std::sin(dlon / 2);
+    return 2.0 * EARTH_RADIUS_M * std::asin(std::sqrt(std::min(1.0, a)));
+}
+
+const char* outcomeName(s2sgeo::FixOutcome outcome) {
+    switch (outcome) {
+        case s2sgeo::FixOutcome::Gated: return "gated";
+        case s2sgeo::FixOutcome::Reinitialized: return "restart";
+        default: return "accepted";
+    }
+}
+
+void appendNumber(std::string& out, double value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+/**
+ * @brief Write the smoothed rows, flushing every IO_CHUNK_BYTES
+ */
+bool writeSmoothed(const std::string& path, const std::vector<s2sgeo::SmoothedFix>& smoothed,
+                   std::string& buffer) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = true;
+    buffer = "timestamp_ms,latitude,longitude,velocity_east_mps,velocity_north_mps,position_std_m,outcome\n";
+    for (const s2sgeo::SmoothedFix& fix : smoothed) {
+        char timestamp[24];
+        buffer.append(timestamp, std::to_chars(timestamp, timestamp + sizeof(timestamp), fix.timestamp_ms).ptr);
+        for (double value : {fix.latitude, fix.longitude, fix.velocity_east_mps,
+                             fix.velocity_north_mps, fix.position_std_m}) {
+            buffer += ',';
+            appendNumber(buffer, value);
+        }
+        buffer += ',';
+        buffer += outcomeName(fix.outcome);
+        buffer += '\n';
+        if (buffer.size() >= IO_CHUNK_BYTES) {
+            ok = ok && std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+            buffer.clear();
+        }
+    }
+    ok = ok && std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+std::string outputPath(const std::string& input, const std::string& output_dir) {
+    std::filesystem::path path(input);
+    std::filesystem::path dir = output_dir.empty() ? path.parent_path() : std::filesystem::path(output_dir);
+    return (dir / (path.stem().string() + ".smoothed.csv")).string();
+}
+
+FileResult processFile(const std::string& path, const std::string& output_dir, Worker& worker) {
+    FileResult result;
+    if (!readFixes(path, worker.input, worker.fixes, result.dropped)) {
+        std::cerr << "[Batch] Cannot read " << path << std::endl;
+        return result;
+    }
+    worker.smoother.smooth(worker.fixes, worker.smoothed);
+    
+    result.fixes = worker.smoothed.size();
+    for (size_t k = 0; k < worker.smoothed.size(); ++k) {
+        const s2sgeo::SmoothedFix& fix = worker.smoothed[k];
+        if (fix.outcome == s2sgeo::FixOutcome::Gated) ++result.gated;
+        if (fix.outcome == s2sgeo::FixOutcome::Reinitialized) ++result.restarts;
+        // A restart is the jump the filter refused to follow (and the smoother's
+        // segment boundary): it is not distance travelled
+        if (k > 0 && fix.outcome != s2sgeo::FixOutcome::Reinitialized) {
+            const s2sgeo::SmoothedFix& previous = worker.smoothed[k - 1];
+            result.distance_m += distanceMeters(previous.latitude, previous.longitude,
+                                                fix.latitude, fix.longitude);
+        }
+    }
+    
+    std::string output = outputPath(path, output_dir);
+    if (!writeSmoothed(output, worker.smoothed, worker.output)) {
+        std::cerr << "[Batch] Cannot write " << output << std::endl;
+        return result;
+    }
+    result.ok = true;
+    return result;
+}
+
+void usage() {
+    std::cerr << "Usage: s2sgeo_batch [--jobs N] [--output-dir DIR] [--process-noise Q]\n"
+              << "                    [--measurement-noise R] [--gate CHI2 | --no-gate] FILE..."
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::string output_dir;
+    double process_noise = 0.1;
+    double measurement_noise = 100.0;
+    s2sgeo::KalmanTuning tuning;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            jobs = static_cast<unsigned>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (arg == "--output-dir" && i + 1 < argc) {
+            output_dir = argv[++i];
+        } else if (arg == "--process-noise" && i + 1 < argc) {
+            process_noise = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--measurement-noise" && i + 1 < argc) {
+            measurement_noise = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--gate" && i + 1 < argc) {
+            tuning.gate_threshold = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--no-gate") {
+            tuning.gate_threshold = -1.0;
+        } else if (arg.starts_with("--")) {
+            usage();
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        usage();
+        return 1;
+    }
+    std::error_code error;
+    if (!output_dir.empty() && !std::filesystem::create_directories(output_dir, error) && error) {
+        std::cerr << "[Batch] Cannot create " << output_dir << ": " << error.message() << std::endl;
+        return 1;
+    }
+    
+    // Thread pool: each worker claims the next unprocessed file
+    auto start = std::chrono::steady_clock::now();
+    std::vector<FileResult> results(files.size());
+    std::atomic<size_t> next_file{0};
+    std::vector<std::thread> workers;
+    jobs = static_cast<unsigned>(std::min<size_t>(jobs, files.size()));
+    for (unsigned w = 0; w < jobs; ++w) {
+        workers.emplace_back([&] {
+            Worker worker;
+            worker.smoother.setProcessNoise(process_noise);
+            worker.smoother.setMeasurementNoise(measurement_noise);
+            worker.smoother.setTuning(tuning);
+            for (size_t f = next_file++; f < files.size(); f = next_file++) {
+                results[f] = processFile(files[f], output_dir, worker);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    size_t total_fixes = 0;
+    size_t failed = 0;
+    std::printf("file\tfixes\tdropped\tgated\trestarts\tdistance_m\n");
+    for (size_t f = 0; f < files.size(); ++f) {
+        const FileResult& result = results[f];
+        if (!result.ok) {
+            ++failed;
+            continue;
+        }
+        total_fixes += result.fixes;
+        std::printf("%s\t%zu\t%zu\t%zu\t%zu\t%.1f\n", files[f].c_str(), result.fixes,
+                    result.dropped, result.gated, result.restarts, result.distance_m);
+    }
+    
+    std::cerr << "[Batch] " << files.size() - failed << " files, " << total_fixes << " fixes in "
+              << elapsed_s << " s (" << static_cast<uint64_t>(total_fixes / std::max(elapsed_s, 1e-9))
+              << " fixes/s on " << jobs << " threads)";
+    if (failed > 0) {
+        std::cerr << ", " << failed << " failed";
+    }
+    std::cerr << std::endl;
+    return failed > 0 ? 1 : 0;
+}
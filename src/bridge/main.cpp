@@ -0,0 +1,98 @@
+/**
+ * @file main.cpp (Bridge)
+ * @brief s2sgeo_bridge: replicate a tenant's ring to another host over UDP
+ */
+
+#include "IPCManager.hpp"
+#include "IPCReplication.hpp"
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <boost/asio/ip/address.hpp>
+
+static std::atomic<bool> g_running{true};
+
+static void printStats(const char* role, const s2sgeo::ReplicationStats& stats) {
+    std::cout << "[Bridge] " << role << ": " << stats.records << " records in "
+              << stats.packets << " datagrams (" << stats.bytes << " bytes), "
+              << stats.contexts << " contexts, " << stats.gaps << " gaps, "
+              << stats.lost_packets << " lost, " << stats.stale_records << " stale, "
+              << stats.lapped << " lapped, " << stats.unresolved << " unresolved" << std::endl;
+}
+
+static void usage() {
+    std::cerr << "Usage: s2sgeo_bridge send HOST PORT [--batch N] [--window-us N]\n"
+              << "       s2sgeo_bridge receive PORT [--ring-capacity N]\n"
+              << "Both: [--tenant NAME] [--shm-file PATH]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    
+    std::string mode = argv[1];
+    bool sending = mode == "send";
+    if (!sending && mode != "receive") {
+        usage();
+        return 1;
+    }
+    if (sending && argc < 4) {
+        usage();
+        return 1;
+    }
+    
+    std::string host = sending ? argv[2] : "0.0.0.0";
+    unsigned short port = static_cast<unsigned short>(std::atoi(argv[sending ? 3 : 2]));
+    
+    s2sgeo::SharedMemoryOptions shm_options;
+    s2sgeo::ReplicationOptions replication;
+    std::string tenant;
+    for (int i = sending ? 4 : 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--tenant" && i + 1 < argc) {
+            tenant = argv[++i];
+        } else if (arg == "--shm-file" && i + 1 < argc) {
+            shm_options.backing_file = argv[++i];
+        } else if (arg == "--ring-capacity" && i + 1 < argc) {
+            shm_options.ring_capacity = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--batch" && i + 1 < argc) {
+            replication.max_batch = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--window-us" && i + 1 < argc) {
+            replication.batch_window = std::chrono::microseconds(std::strtoll(argv[++i], nullptr, 10));
+        }
+    }
+    
+    std::signal(SIGINT, [](int) { g_running = false; });
+    std::signal(SIGTERM, [](int) { g_running = false; });
+    
+    // Sender reads the local daemon's ring; receiver is the producer of its own
+    auto& shm_mgr = s2sgeo::SharedMemoryManager::getInstance(tenant);
+    bool attached = sending ? shm_mgr.connectClient(shm_options)
+                            : shm_mgr.initializeServer(shm_options);
+    if (!attached) {
+        std::cerr << "Failed to attach to " << shm_mgr.segmentName() << std::endl;
+        return 1;
+    }
+    
+    boost::asio::io_context io;
+    boost::asio::ip::udp::endpoint endpoint(boost::asio::ip::make_address(host), port);
+    
+    // Runs until SIGINT/SIGTERM, then reports what went over the link
+    if (sending) {
+        s2sgeo::ReplicationSender sender(io, endpoint, replication, shm_mgr);
+        sender.run(g_running);
+        printStats("sent", sender.stats());
+    } else {
+        s2sgeo::ReplicationReceiver receiver(io, endpoint, shm_mgr);
+        std::cout << "[Bridge] Listening on UDP port " << receiver.port() << std::endl;
+        receiver.run(g_running);
+        printStats("received", receiver.stats());
+        shm_mgr.cleanup();
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file IPCCommandRing.cpp
+ * @brief Command ring implementation
+ */
+
+#include "IPCCommandRing.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace s2sgeo {
+
+bool IPCCommandRing::push(const CommandRecord& command, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return false;
+    
+    auto* ring = mgr.getCommandRing();
+    if (!ring) return false;
+    
+    // Only we write tail; head tells us how far the daemon has consumed
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    if (tail - head >= CommandRing::CAPACITY) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    ring->slots[tail & (CommandRing::CAPACITY - 1)] = command;
+    ring->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool IPCCommandRing::pop(CommandRecord& command, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return false;
+    
+    auto* ring = mgr.getCommandRing();
+    if (!ring) return false;
+    
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head == tail) return false;
+    
+    command = ring->slots[head & (CommandRing::CAPACITY - 1)];
+    command.argument[sizeof(command.argument) - 1] = '\0';
+    ring->head.store(head + 1, std::memory_order_release);
+    ring->processed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool IPCCommandRing::pending(SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return false;
+    
+    auto* ring = mgr.getCommandRing();
+    if (!ring) return false;
+    
+    return ring->head.load(std::memory_order_relaxed) != ring->tail.load(std::memory_order_acquire);
+}
+
+bool IPCCommandRing::activateProvider(std::string_view name, SharedMemoryManager& mgr) {
+    CommandRecord command;
+    command.type = CommandType::ActivateProvider;
+    std::memcpy(command.argument, name.data(),
+                std::min(name.size(), sizeof(command.argument) - 1));
+    return push(command, mgr);
+}
+
+bool IPCCommandRing::setAccuracy(double level, SharedMemoryManager& mgr) {
+    CommandRecord command;
+    command.type = CommandType::SetAccuracy;
+    command.value = level;
+    return push(command, mgr);
+}
+
+bool IPCCommandRing::setS2Level(int level, SharedMemoryManager& mgr) {
+    CommandRecord command;
+    command.type = CommandType::SetS2Level;
+    command.int_value = level;
+    return push(command, mgr);
+}
+
+bool IPCCommandRing::forceRefresh(SharedMemoryManager& mgr) {
+    CommandRecord command;
+    command.type = CommandType::ForceRefresh;
+    return push(command, mgr);
+}
+
+} // namespace s2sgeo
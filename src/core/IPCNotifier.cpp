@@ -0,0 +1,66 @@
+/**
+ * @file IPCNotifier.cpp
+ * @brief Futex-based notification implementation
+ */
+
+#include "IPCNotifier.hpp"
+#include <cerrno>
+#include <climits>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace s2sgeo {
+
+#ifdef __linux__
+
+static uint32_t* futexAddress(std::atomic<uint32_t>& word) {
+    return reinterpret_cast<uint32_t*>(&word);
+}
+
+bool IPCNotifier::wait(std::atomic<uint32_t>& word, uint32_t expected,
+                       std::chrono::nanoseconds timeout) {
+    if (timeout.count() <= 0) {
+        return word.load(std::memory_order_acquire) != expected;
+    }
+    
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    
+    // FUTEX_WAIT (not _PRIVATE): the word lives in a shared mapping
+    long rc = syscall(SYS_futex, futexAddress(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+    if (rc == 0) return true;
+    
+    // EAGAIN: word changed before we slept; EINTR: let the caller re-check
+    return errno != ETIMEDOUT;
+}
+
+void IPCNotifier::wakeAll(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, futexAddress(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+bool IPCNotifier::wait(std::atomic<uint32_t>& word, uint32_t expected,
+                       std::chrono::nanoseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (word.load(std::memory_order_acquire) == expected) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void IPCNotifier::wakeAll(std::atomic<uint32_t>&) {
+    // Pollers observe the word change on their own
+}
+
+#endif
+
+} // namespace s2sgeo
@@ -5,12 +5,136 @@
 
 #include "IPCReader.hpp"
 #include "IPCManager.hpp"
+#include "IPCNotifier.hpp"
+#include <algorithm>
 #include <cstring>
+#include <iostream>
+#include <unistd.h>
 
 namespace s2sgeo {
 
-bool IPCReader::readLatestState(WorldState& state, ContextFrame& context) {
-    auto& mgr = SharedMemoryManager::getInstance();
+/**
+ * @brief Copy a position record under its seqlock
+ * @return false if no consistent copy was obtained within MAX_READ_RETRIES
+ */
+static bool copyRecord(const PositionRecord& record, SharedMemoryHeader* header,
+                       PositionData& data, uint64_t& sequence) {
+    for (uint32_t attempt = 0; attempt < SharedMemoryHeader::MAX_READ_RETRIES; ++attempt) {
+        uint64_t before = record.sequence.load(std::memory_order_acquire);
+        if ((before & 1u) == 0) {
+            data = record.data;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (record.sequence.load(std::memory_order_relaxed) == before) {
+                sequence = before / 2;
+                return true;
+            }
+        }
+        header->read_retries.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    header->failed_reads.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+/**
+ * @brief Copy context `context_id` out of the slab under its seqlock
+ * @return false if the slot no longer (or not yet) holds that context, or no
+ *         consistent copy was obtained within MAX_READ_RETRIES
+ */
+static bool copyContext(const ContextSlot* slab, uint32_t context_id, SharedMemoryHeader* header,
+                        char* context_json, ContextFrame& frame) {
+    const ContextSlot& slot = slab[(context_id - 1) % SharedMemoryHeader::CONTEXT_SLAB_SIZE];
+    const uint64_t expected = 2 * static_cast<uint64_t>(context_id);
+    
+    for (uint32_t attempt = 0; attempt < SharedMemoryHeader::MAX_READ_RETRIES; ++attempt) {
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if ((before & 1u) == 0) {
+            if (before != expected) return false;  // Recycled for a newer context
+            std::memcpy(context_json, slot.payload.context_json, sizeof(slot.payload.context_json));
+            frame = slot.payload.frame;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        header->read_retries.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    header->failed_reads.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+/**
+ * @brief Turn a Position record into the full state it describes
+ * @details No-op for full records. Otherwise copies the base record the
+ *          delta points back to and overlays the delta on it.
+ * @return false if the base record has already been overwritten
+ */
+static bool resolveRecord(const PositionRecord* buffer, uint32_t ring_capacity,
+                          SharedMemoryHeader* header, uint64_t sequence, PositionData& data) {
+    if (data.record_type != RecordType::Position) return true;
+    
+    uint64_t base_seq = sequence - data.base_offset;
+    if (data.base_offset == 0 || base_seq == 0) return false;
+    
+    PositionData base;
+    uint64_t copied_seq = 0;
+    if (!copyRecord(buffer[ringSlot(base_seq, ring_capacity)], header, base, copied_seq) ||
+        copied_seq != base_seq) {
+        return false;
+    }
+    data = mergePositionDelta(base, data);
+    return true;
+}
+
+bool IPCReader::readLatestState(WorldState& state, ContextFrame& context,
+                                SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return false;
+    
+    auto* header = mgr.getHeader();
+    auto* buffer = mgr.getRingBuffer();
+    auto* slab = mgr.getContextSlab();
+    
+    if (!header || !buffer || !slab) return false;
+    
+    for (uint32_t attempt = 0; attempt < SharedMemoryHeader::MAX_READ_RETRIES; ++attempt) {
+        // Nothing published yet
+        uint64_t head = header->global_sequence.load(std::memory_order_acquire);
+        if (head == 0) return false;
+        
+        PositionData data;
+        uint64_t sequence = 0;
+        if (!copyRecord(buffer[ringSlot(head, mgr.getRingCapacity())],
+                        header, data, sequence)) {
+            return false;
+        }
+        if (!resolveRecord(buffer, mgr.getRingCapacity(), header, sequence, data)) {
+            // Base record was lapped while we read; a newer head has its own base
+            header->read_retries.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        applyPositionData(data, sequence, state);
+        
+        if (data.context_id == 0) {
+            std::memset(state.context_json, 0, sizeof(state.context_json));
+            context = ContextFrame{};
+            return true;
+        }
+        
+        if (copyContext(slab, data.context_id, header, state.context_json, context)) {
+            return true;
+        }
+        
+        // The writer cycled the whole slab since this record; start over
+        header->read_retries.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    header->failed_reads.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool IPCReader::readLatestPosition(PositionData& position, uint64_t* sequence,
+                                   SharedMemoryManager& mgr) {
     if (!mgr.isReady()) return false;
     
     auto* header = mgr.getHeader();
@@ -18,24 +142,294 @@ bool IPCReader::readLatestState(WorldState& state, ContextFrame& context) {
     
     if (!header || !buffer) return false;
     
-    // Read from the last written entry
-    uint32_t write_idx = header->write_index.load(std::memory_order_acquire);
-    uint32_t read_idx = (write_idx - 1) % SharedMemoryHeader::RING_BUFFER_SIZE;
+    for (uint32_t attempt = 0; attempt < SharedMemoryHeader::MAX_READ_RETRIES; ++attempt) {
+        uint64_t head = header->global_sequence.load(std::memory_order_acquire);
+        if (head == 0) return false;
+        
+        uint64_t record_seq = 0;
+        if (!copyRecord(buffer[ringSlot(head, mgr.getRingCapacity())],
+                        header, position, record_seq)) {
+            return false;
+        }
+        if (resolveRecord(buffer, mgr.getRingCapacity(), header, record_seq, position)) {
+            if (sequence) *sequence = record_seq;
+            return true;
+        }
+        header->read_retries.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    header->failed_reads.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool IPCReader::readContext(uint32_t context_id, ContextPayload& payload,
+                            SharedMemoryManager& mgr) {
+    if (!mgr.isReady() || context_id == 0) return false;
+    
+    auto* header = mgr.getHeader();
+    auto* slab = mgr.getContextSlab();
+    
+    if (!header || !slab) return false;
+    
+    return copyContext(slab, context_id, header, payload.context_json, payload.frame);
+}
+
+bool IPCReader::viewLatest(RecordView& view, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return false;
+    
+    auto* header = mgr.getHeader();
+    auto* buffer = mgr.getRingBuffer();
+    
+    if (!header || !buffer) return false;
     
-    // Ensure we don't read from the write pointer
-    if (write_idx == 0) {
-        read_idx = SharedMemoryHeader::RING_BUFFER_SIZE - 1;
+    for (uint32_t attempt = 0; attempt < SharedMemoryHeader::MAX_READ_RETRIES; ++attempt) {
+        uint64_t head = header->global_sequence.load(std::memory_order_acquire);
+        if (head == 0) return false;
+        
+        const PositionRecord& record = buffer[ringSlot(head, mgr.getRingCapacity())];
+        uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1u) == 0 && sequence != 0) {
+            view.record_ = &record;
+            view.sequence_ = sequence / 2;
+            return true;
+        }
+        header->read_retries.fetch_add(1, std::memory_order_relaxed);
     }
     
-    const RingBufferEntry& entry = buffer[read_idx];
-    state = entry.state;
-    context = entry.context;
+    header->failed_reads.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool IPCReader::viewContext(uint32_t context_id, ContextView& view,
+                            SharedMemoryManager& mgr) {
+    if (!mgr.isReady() || context_id == 0) return false;
     
-    return true;
+    auto* header = mgr.getHeader();
+    auto* slab = mgr.getContextSlab();
+    
+    if (!header || !slab) return false;
+    
+    const ContextSlot& slot = slab[(context_id - 1) % SharedMemoryHeader::CONTEXT_SLAB_SIZE];
+    const uint64_t expected = 2 * static_cast<uint64_t>(context_id);
+    
+    for (uint32_t attempt = 0; attempt < SharedMemoryHeader::MAX_READ_RETRIES; ++attempt) {
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == expected) {
+            view.slot_ = &slot;
+            view.context_id_ = context_id;
+            return true;
+        }
+        if ((sequence & 1u) == 0 || sequence > expected) {
+            return false;  // Recycled, or not published yet
+        }
+        header->read_retries.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    header->failed_reads.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void IPCReader::noteRetry(SharedMemoryManager& mgr) {
+    auto* header = mgr.getHeader();
+    if (header) header->read_retries.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IPCReader::noteFailedRead(SharedMemoryManager& mgr) {
+    auto* header = mgr.getHeader();
+    if (header) header->failed_reads.fetch_add(1, std::memory_order_relaxed);
+}
+
+DrainResult IPCReader::readSince(uint64_t last_seq, std::span<IPCUpdate> out,
+                                 SharedMemoryManager& mgr) {
+    DrainResult result;
+    result.last_sequence = last_seq;
+    
+    if (!mgr.isReady()) return result;
+    
+    auto* header = mgr.getHeader();
+    auto* buffer = mgr.getRingBuffer();
+    
+    if (!header || !buffer) return result;
+    
+    const uint32_t ring_capacity = mgr.getRingCapacity();
+    uint64_t head = header->global_sequence.load(std::memory_order_acquire);
+    
+    // Cursor from a previous daemon run: start over
+    if (last_seq > head) {
+        last_seq = 0;
+        result.last_sequence = 0;
+    }
+    
+    // Entries older than one ring length are already gone
+    uint64_t oldest = head >= ring_capacity ? head - ring_capacity + 1 : 1;
+    uint64_t next = last_seq + 1;
+    if (next < oldest) {
+        result.lapped = oldest - next;
+        next = oldest;
+        result.last_sequence = oldest - 1;
+    }
+    
+    // Newest full record copied by this drain, so deltas rarely re-read their base
+    uint64_t base_seq = 0;
+    PositionData base{};
+    
+    while (next <= head && result.count < out.size()) {
+        const PositionRecord& record = buffer[ringSlot(next, ring_capacity)];
+        IPCUpdate& update = out[result.count];
+        
+        if (!copyRecord(record, header, update.position, update.sequence)) {
+            // Slot is being rewritten continuously; pick it up on the next call
+            break;
+        }
+        
+        if (update.sequence < next) {
+            // Defensive: slot not yet published for this sequence
+            break;
+        }
+        
+        if (update.sequence > next) {
+            // The writer lapped us mid-drain; skip to the oldest surviving entry
+            head = header->global_sequence.load(std::memory_order_acquire);
+            uint64_t survivor = head - ring_capacity + 1;
+            result.lapped += survivor - next;
+            next = survivor;
+            result.last_sequence = next - 1;
+            continue;
+        }
+        
+        if (update.position.record_type != RecordType::Position) {
+            base_seq = update.sequence;
+            base = update.position;
+        } else if (base_seq != 0 && update.sequence - update.position.base_offset == base_seq) {
+            update.position = mergePositionDelta(base, update.position);
+        } else {
+            // Base precedes this drain; if it is gone the raw delta is returned
+            resolveRecord(buffer, ring_capacity, header, update.sequence, update.position);
+        }
+        
+        result.last_sequence = update.sequence;
+        ++result.count;
+        ++next;
+    }
+    
+    return result;
+}
+
+uint64_t IPCReader::latestSequence(SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return 0;
+    
+    auto* header = mgr.getHeader();
+    if (!header) return 0;
+    
+    return header->global_sequence.load(std::memory_order_acquire);
+}
+
+bool IPCReader::waitForUpdate(uint64_t last_seq, std::chrono::nanoseconds timeout,
+                              SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return false;
+    
+    auto* header = mgr.getHeader();
+    if (!header) return false;
+    
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        uint32_t word = header->update_futex.load(std::memory_order_seq_cst);
+        if (header->global_sequence.load(std::memory_order_acquire) > last_seq) {
+            return true;
+        }
+        
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::nanoseconds::zero()) {
+            return false;
+        }
+        
+        // Announce ourselves, then re-check before sleeping (see notifyReaders)
+        header->futex_waiters.fetch_add(1, std::memory_order_seq_cst);
+        if (header->global_sequence.load(std::memory_order_seq_cst) > last_seq) {
+            header->futex_waiters.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        IPCNotifier::wait(header->update_futex, word,
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(remaining));
+        header->futex_waiters.fetch_sub(1, std::memory_order_relaxed);
+        
+        if (!header->location_service_alive.load(std::memory_order_acquire) &&
+            header->global_sequence.load(std::memory_order_acquire) <= last_seq &&
+            header->update_futex.load(std::memory_order_acquire) != word) {
+            // Woken by cleanup(), not by a publish
+            return false;
+        }
+    }
+}
+
+static int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int32_t IPCReader::registerConsumer(std::string_view name, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return -1;
+    
+    auto* table = mgr.getConsumerTable();
+    if (!table) return -1;
+    
+    const uint32_t pid = static_cast<uint32_t>(::getpid());
+    for (size_t i = 0; i < SharedMemoryHeader::MAX_CONSUMERS; ++i) {
+        ConsumerSlot& slot = table[i];
+        uint32_t expected = 0;
+        if (!slot.pid.compare_exchange_strong(expected, pid, std::memory_order_acq_rel)) {
+            continue;
+        }
+        
+        // heartbeat_ms is still 0, so the daemon ignores the slot until we're done
+        size_t length = std::min(name.size(), sizeof(slot.name) - 1);
+        std::memset(slot.name, 0, sizeof(slot.name));
+        std::memcpy(slot.name, name.data(), length);
+        slot.last_sequence.store(0, std::memory_order_relaxed);
+        slot.overruns.store(0, std::memory_order_relaxed);
+        slot.heartbeat_ms.store(steadyNowMs(), std::memory_order_release);
+        return static_cast<int32_t>(i);
+    }
+    
+    std::cerr << "[IPCReader] Consumer table full, " << name << " is not registered" << std::endl;
+    return -1;
+}
+
+void IPCReader::reportConsumed(int32_t slot, uint64_t last_seq, uint64_t lapped,
+                               SharedMemoryManager& mgr) {
+    auto* table = mgr.getConsumerTable();
+    if (!table || slot < 0 || static_cast<size_t>(slot) >= SharedMemoryHeader::MAX_CONSUMERS) {
+        return;
+    }
+    
+    ConsumerSlot& entry = table[slot];
+    entry.last_sequence.store(last_seq, std::memory_order_relaxed);
+    if (lapped > 0) {
+        entry.overruns.fetch_add(lapped, std::memory_order_relaxed);
+    }
+    entry.heartbeat_ms.store(steadyNowMs(), std::memory_order_release);
+}
+
+void IPCReader::unregisterConsumer(int32_t slot, SharedMemoryManager& mgr) {
+    auto* table = mgr.getConsumerTable();
+    if (!table || slot < 0 || static_cast<size_t>(slot) >= SharedMemoryHeader::MAX_CONSUMERS) {
+        return;
+    }
+    
+    table[slot].heartbeat_ms.store(0, std::memory_order_relaxed);
+    table[slot].pid.store(0, std::memory_order_release);
+}
+
+uint64_t IPCReader::maxConsumerLag(SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return 0;
+    
+    auto* header = mgr.getHeader();
+    if (!header) return 0;
+    
+    return header->max_consumer_lag.load(std::memory_order_relaxed);
 }
 
-bool IPCReader::isLocationServiceAlive() {
-    auto& mgr = SharedMemoryManager::getInstance();
+bool IPCReader::isLocationServiceAlive(SharedMemoryManager& mgr) {
     if (!mgr.isReady()) return false;
     
     auto* header = mgr.getHeader();
@@ -44,18 +438,17 @@ bool IPCReader::isLocationServiceAlive() {
     return header->location_service_alive.load(std::memory_order_acquire);
 }
 
-std::string IPCReader::getActivePlugin() {
-    auto& mgr = SharedMemoryManager::getInstance();
+std::string IPCReader::getActivePlugin(SharedMemoryManager& mgr) {
     if (!mgr.isReady()) return "";
     
     auto* header = mgr.getHeader();
     if (!header) return "";
     
-    return std::string(header->active_plugin);
+    return std::string(header->active_plugin,
+                       strnlen(header->active_plugin, sizeof(header->active_plugin)));
 }
 
-double IPCReader::getAccuracyLevel() {
-    auto& mgr = SharedMemoryManager::getInstance();
+double IPCReader::getAccuracyLevel(SharedMemoryManager& mgr) {
     if (!mgr.isReady()) return 1.0;
     
     auto* header = mgr.getHeader();
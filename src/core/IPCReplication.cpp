@@ -0,0 +1,293 @@
+/**
+ * @file IPCReplication.cpp
+ * @brief UDP replication of the position ring
+ */
+
+#include "IPCReplication.hpp"
+#include "IPCWriter.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <poll.h>
+
+namespace s2sgeo {
+
+using boost::asio::ip::udp;
+
+/// Largest UDP payload over IPv4
+static constexpr size_t MAX_DATAGRAM = 65507;
+
+static constexpr size_t MAX_RECORDS_PER_DATAGRAM =
+    (MAX_DATAGRAM - sizeof(ReplicationPacketHeader) - sizeof(ContextPayload)) /
+    sizeof(ReplicationRecord);
+
+/// Terminate a string field from the wire, which may have no NUL of its own
+template <size_t N>
+static void terminate(char (&field)[N]) {
+    field[N - 1] = '\0';
+}
+
+ReplicationSender::ReplicationSender(boost::asio::io_context& io, const udp::endpoint& destination,
+                                     const ReplicationOptions& options, SharedMemoryManager& mgr)
+    : socket_(io, destination.protocol()), destination_(destination), options_(options),
+      mgr_(&mgr), cursor_(0, mgr) {
+    options_.max_batch = std::clamp<size_t>(options_.max_batch, 1, MAX_RECORDS_PER_DATAGRAM);
+    batch_.reserve(options_.max_batch);
+    buffer_.resize(sizeof(ReplicationPacketHeader) + sizeof(ContextPayload) +
+                   options_.max_batch * sizeof(ReplicationRecord));
+    cursor_.attach("bridge");
+}
+
+size_t ReplicationSender::poll() {
+    std::array<IPCUpdate, 64> updates;
+    size_t drained = 0;
+    
+    while (true) {
+        DrainResult result = cursor_.drain(updates);
+        stats_.lapped += result.lapped;
+        drained += result.count;
+        for (size_t i = 0; i < result.count; ++i) {
+            append(updates[i]);
+        }
+        if (result.count < updates.size()) break;
+    }
+    
+    if (!batch_.empty() &&
+        std::chrono::steady_clock::now() - batch_started_ >= options_.batch_window) {
+        sendBatch();
+    }
+    return drained;
+}
+
+void ReplicationSender::flush() {
+    if (!batch_.empty()) {
+        sendBatch();
+    }
+}
+
+void ReplicationSender::run(const std::atomic<bool>& running) {
+    while (running.load(std::memory_order_relaxed)) {
+        // A pending batch must go out when its window closes, even without updates
+        auto timeout = std::chrono::nanoseconds(std::chrono::milliseconds(100));
+        if (!batch_.empty()) {
+            timeout = std::max(std::chrono::nanoseconds(0),
+                               std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   batch_started_ + options_.batch_window -
+                                   std::chrono::steady_clock::now()));
+        }
+        IPCReader::waitForUpdate(cursor_.position(), timeout, *mgr_);
+        poll();
+    }
+    flush();
+}
+
+void ReplicationSender::append(const IPCUpdate& update) {
+    // An unresolved delta has no cell, steps or velocity: never pass it off as a full state
+    if (update.position.record_type == RecordType::Position && update.position.base_offset != 0) {
+        stats_.unresolved++;
+        return;
+    }
+    
+    // Every record of a packet shares one context
+    if (!batch_.empty() && update.position.context_id != batch_context_id_) {
+        sendBatch();
+    }
+    if (batch_.empty()) {
+        batch_context_id_ = update.position.context_id;
+        batch_started_ = std::chrono::steady_clock::now();
+    }
+    
+    ReplicationRecord& record = batch_.emplace_back();
+    record.sequence = update.sequence;
+    record.position = update.position;
+    record.position.record_type = RecordType::FullState;
+    record.position.base_offset = 0;
+    
+    if (batch_.size() >= options_.max_batch) {
+        sendBatch();
+    }
+}
+
+void ReplicationSender::sendBatch() {
+    ReplicationPacketHeader header{};
+    header.magic = ReplicationPacketHeader::MAGIC;
+    header.version = ReplicationPacketHeader::VERSION;
+    header.layout_hash = sharedMemoryLayoutHash();
+    header.packet_sequence = packet_sequence_;
+    header.context_id = batch_context_id_;
+    header.record_count = static_cast<uint32_t>(batch_.size());
+    
+    char* out = buffer_.data() + sizeof(header);
+    bool send_context = batch_context_id_ != 0 &&
+                        (batch_context_id_ != sent_context_id_ ||
+                         packets_since_context_ + 1 >= options_.context_refresh);
+    if (send_context) {
+        ContextPayload payload;
+        // The slab only keeps the last few contexts; a lapped one is simply not sent
+        if (IPCReader::readContext(batch_context_id_, payload, *mgr_)) {
+            header.flags |= ReplicationPacketHeader::FLAG_HAS_CONTEXT;
+            std::memcpy(out, &payload, sizeof(payload));
+            out += sizeof(payload);
+        }
+    }
+    std::memcpy(buffer_.data(), &header, sizeof(header));
+    std::memcpy(out, batch_.data(), batch_.size() * sizeof(ReplicationRecord));
+    out += batch_.size() * sizeof(ReplicationRecord);
+    
+    size_t size = static_cast<size_t>(out - buffer_.data());
+    boost::system::error_code error;
+    socket_.send_to(boost::asio::buffer(buffer_.data(), size), destination_, 0, error);
+    if (error) {
+        // UDP is lossy anyway: the receiver reports the gap
+        if (stats_.send_errors++ == 0) {
+            std::cerr << "[ReplicationSender] Send to " << destination_ << " failed: "
+                      << error.message() << std::endl;
+        }
+    } else {
+        stats_.packets++;
+        stats_.records += batch_.size();
+        stats_.bytes += size;
+    }
+    
+    if (header.flags & ReplicationPacketHeader::FLAG_HAS_CONTEXT) {
+        stats_.contexts++;
+        sent_context_id_ = batch_context_id_;
+        packets_since_context_ = 0;
+    } else {
+        packets_since_context_++;
+    }
+    packet_sequence_++;
+    batch_.clear();
+}
+
+ReplicationReceiver::ReplicationReceiver(boost::asio::io_context& io, const udp::endpoint& listen,
+                                         SharedMemoryManager& mgr)
+    : socket_(io, listen), mgr_(&mgr), buffer_(MAX_DATAGRAM) {
+    socket_.non_blocking(true);
+    
+    // Absorb bursts of 10k+ updates/s; the kernel may cap this, which is fine
+    boost::system::error_code ignored;
+    socket_.set_option(boost::asio::socket_base::receive_buffer_size(4 << 20), ignored);
+}
+
+uint16_t ReplicationReceiver::port() const {
+    return socket_.local_endpoint().port();
+}
+
+size_t ReplicationReceiver::poll(std::chrono::milliseconds timeout) {
+    pollfd fd{socket_.native_handle(), POLLIN, 0};
+    if (::poll(&fd, 1, static_cast<int>(timeout.count())) <= 0) return 0;
+    
+    size_t republished = 0;
+    while (true) {
+        udp::endpoint sender;
+        boost::system::error_code error;
+        size_t size = socket_.receive_from(boost::asio::buffer(buffer_), sender, 0, error);
+        if (error == boost::asio::error::would_block) break;
+        if (error) {
+            std::cerr << "[ReplicationReceiver] Receive failed: " << error.message() << std::endl;
+            break;
+        }
+        republished += handleDatagram(buffer_.data(), size);
+    }
+    return republished;
+}
+
+void ReplicationReceiver::run(const std::atomic<bool>& running) {
+    while (running.load(std::memory_order_relaxed)) {
+        poll(std::chrono::milliseconds(100));
+    }
+}
+
+size_t ReplicationReceiver::handleDatagram(const char* data, size_t size) {
+    ReplicationPacketHeader header;
+    if (size < sizeof(header)) {
+        stats_.malformed++;
+        return 0;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    
+    bool has_context = header.flags & ReplicationPacketHeader::FLAG_HAS_CONTEXT;
+    size_t expected_size = sizeof(header) + (has_context ? sizeof(ContextPayload) : 0) +
+                           static_cast<size_t>(header.record_count) * sizeof(ReplicationRecord);
+    if (header.magic != ReplicationPacketHeader::MAGIC ||
+        header.version != ReplicationPacketHeader::VERSION ||
+        header.layout_hash != sharedMemoryLayoutHash() || size != expected_size) {
+        if (stats_.malformed++ == 0) {
+            std::cerr << "[ReplicationReceiver] Dropping malformed or incompatible datagram ("
+                      << size << " bytes)" << std::endl;
+        }
+        return 0;
+    }
+    
+    // Packet 0 comes from a (re)started sender whose sequences and context ids start over
+    if (header.packet_sequence == 0) {
+        last_sequence_ = 0;
+        next_packet_ = 0;
+        remote_context_id_ = 0;
+    }
+    if (header.packet_sequence > next_packet_) {
+        stats_.lost_packets += header.packet_sequence - next_packet_;
+    }
+    next_packet_ = std::max(next_packet_, header.packet_sequence + 1);
+    stats_.packets++;
+    stats_.bytes += size;
+    
+    const char* in = data + sizeof(header);
+    if (has_context) {
+        ContextPayload payload;
+        std::memcpy(&payload, in, sizeof(payload));
+        in += sizeof(payload);
+        if (header.context_id != remote_context_id_) {
+            // Adapters read these fields as C strings straight out of the slab
+            terminate(payload.frame.road_name);
+            terminate(payload.frame.road_type);
+            terminate(payload.frame.traffic_level);
+            terminate(payload.frame.hazards);
+            std::string_view json(payload.context_json,
+                                  strnlen(payload.context_json, sizeof(payload.context_json)));
+            IPCWriter::publishContext(payload.frame, json, *mgr_);
+            remote_context_id_ = header.context_id;
+            stats_.contexts++;
+        }
+    }
+    
+    // Until the context these records belong to arrives (its datagram was lost, or
+    // the sender resends it every context_refresh packets), they would be published
+    // under the previous one: drop them as gaps
+    bool context_applied = header.context_id == remote_context_id_;
+    
+    size_t republished = 0;
+    for (uint32_t i = 0; i < header.record_count; ++i) {
+        ReplicationRecord record;
+        std::memcpy(&record, in + i * sizeof(record), sizeof(record));
+        
+        if (record.sequence <= last_sequence_) {
+            stats_.stale_records++;
+            continue;
+        }
+        if (last_sequence_ != 0 && record.sequence > last_sequence_ + 1) {
+            stats_.gaps += record.sequence - last_sequence_ - 1;
+        }
+        last_sequence_ = record.sequence;
+        if (!context_applied) {
+            stats_.gaps++;
+            continue;
+        }
+        
+        WorldState state{};
+        applyPositionData(record.position, record.sequence, state);
+        IPCWriter::writePosition(state, *mgr_);
+        republished++;
+    }
+    stats_.records += republished;
+    if (republished > 0) {
+        IPCWriter::signalAlive(*mgr_);
+    }
+    return republished;
+}
+
+} // namespace s2sgeo
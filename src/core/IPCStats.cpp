@@ -0,0 +1,106 @@
+/**
+ * @file IPCStats.cpp
+ * @brief Shared memory instrumentation implementation
+ */
+
+#include "IPCStats.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace s2sgeo {
+
+uint64_t HistogramSnapshot::percentileNs(double q) const {
+    if (count == 0) return 0;
+    
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * count));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            uint64_t upper = b == 0 ? 0 : (uint64_t{1} << b) - 1;
+            return std::min(upper, max_ns);
+        }
+    }
+    // Buckets and count were copied a few samples apart
+    return max_ns;
+}
+
+size_t IPCStats::bucketFor(uint64_t nanoseconds) {
+    return std::min<size_t>(std::bit_width(nanoseconds), LatencyHistogram::BUCKETS - 1);
+}
+
+void IPCStats::recordLatency(LatencyMetric metric, uint64_t nanoseconds, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return;
+    
+    auto* stats = mgr.getStats();
+    if (!stats) return;
+    
+    auto& histogram = stats->histograms[static_cast<size_t>(metric)];
+    histogram.buckets[bucketFor(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    histogram.sum_ns.fetch_add(nanoseconds, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    
+    uint64_t max = histogram.max_ns.load(std::memory_order_relaxed);
+    while (nanoseconds > max &&
+           !histogram.max_ns.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+void IPCStats::increment(StatCounter counter, uint64_t count, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return;
+    
+    auto* stats = mgr.getStats();
+    if (!stats) return;
+    
+    stats->counters[static_cast<size_t>(counter)].fetch_add(count, std::memory_order_relaxed);
+}
+
+bool IPCStats::snapshot(StatsSnapshot& out, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return false;
+    
+    auto* stats = mgr.getStats();
+    if (!stats) return false;
+    
+    for (size_t h = 0; h < StatsBlock::NUM_HISTOGRAMS; ++h) {
+        const auto& histogram = stats->histograms[h];
+        auto& copy = out.histograms[h];
+        copy.count = histogram.count.load(std::memory_order_relaxed);
+        copy.sum_ns = histogram.sum_ns.load(std::memory_order_relaxed);
+        copy.max_ns = histogram.max_ns.load(std::memory_order_relaxed);
+        for (size_t b = 0; b < LatencyHistogram::BUCKETS; ++b) {
+            copy.buckets[b] = histogram.buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+    for (size_t c = 0; c < StatsBlock::NUM_COUNTERS; ++c) {
+        out.counters[c] = stats->counters[c].load(std::memory_order_relaxed);
+    }
+    return true;
+}
+
+const char* IPCStats::metricName(LatencyMetric metric) {
+    switch (metric) {
+        case LatencyMetric::SensorToFilter: return "sensor_to_filter";
+        case LatencyMetric::FilterToPublish: return "filter_to_publish";
+        case LatencyMetric::ProviderFetch: return "provider_fetch";
+        case LatencyMetric::LoopJitter: return "loop_jitter";
+        default: return "unknown";
+    }
+}
+
+const char* IPCStats::counterName(StatCounter counter) {
+    switch (counter) {
+        case StatCounter::CellCrossings: return "cell_crossings";
+        case StatCounter::ContextCacheHits: return "context_cache_hits";
+        case StatCounter::DroppedFixes: return "dropped_fixes";
+        case StatCounter::LoopIterations: return "loop_iterations";
+        case StatCounter::GatedFixes: return "gated_fixes";
+        case StatCounter::FilterRestarts: return "filter_restarts";
+        case StatCounter::IdleHeartbeats: return "idle_heartbeats";
+        case StatCounter::StationaryPeriods: return "stationary_periods";
+        default: return "unknown";
+    }
+}
+
+} // namespace s2sgeo
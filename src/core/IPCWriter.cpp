@@ -5,13 +5,116 @@
 
 #include "IPCWriter.hpp"
 #include "IPCManager.hpp"
+#include "IPCNotifier.hpp"
+#include "IPCStats.hpp"
+#include <algorithm>
 #include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cstring>
+#include <signal.h>
 
 namespace s2sgeo {
 
-void IPCWriter::writeState(const WorldState& state, const ContextFrame& context) {
-    auto& mgr = SharedMemoryManager::getInstance();
+/**
+ * @brief Wake readers blocked in IPCReader::waitForUpdate()
+ * @details Pairs with the waiter's increment of futex_waiters followed by a
+ *          re-check of global_sequence; both sides use seq_cst so either the
+ *          waiter sees the new sequence or we see the waiter.
+ */
+static void notifyReaders(SharedMemoryHeader* header) {
+    header->update_futex.fetch_add(1, std::memory_order_seq_cst);
+    if (header->futex_waiters.load(std::memory_order_seq_cst) > 0) {
+        IPCNotifier::wakeAll(header->update_futex);
+    }
+}
+
+/**
+ * @brief Context id carried by the newest record (ours, so no seqlock needed)
+ */
+static uint32_t lastRecordContext(SharedMemoryHeader* header, PositionRecord* buffer,
+                                  uint32_t ring_capacity) {
+    uint64_t head = header->global_sequence.load(std::memory_order_relaxed);
+    return head == 0 ? 0 : buffer[ringSlot(head, ring_capacity)].data.context_id;
+}
+
+/**
+ * @brief Append one record to the position ring
+ */
+static void publishRecord(SharedMemoryHeader* header, PositionRecord* buffer,
+                          uint32_t ring_capacity, const PositionData& data) {
+    // Entry N always lands in slot ringSlot(N): global_sequence is the only
+    // producer counter, so a daemon resumed after a crash mid-publish carries on
+    // in the right slot (a half-written entry is simply written again)
+    uint64_t seq = header->global_sequence.load(std::memory_order_relaxed) + 1;
+    
+    // Seqlock: 2N-1 (odd) while the payload is being copied, 2N once stable
+    PositionRecord& record = buffer[ringSlot(seq, ring_capacity)];
+    record.sequence.store(2 * seq - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    record.data = data;
+    
+    record.sequence.store(2 * seq, std::memory_order_release);
+    
+    header->global_sequence.store(seq, std::memory_order_release);
+    if (data.record_type != RecordType::Position) {
+        header->last_full_sequence.store(seq, std::memory_order_release);
+    }
+    header->total_updates.fetch_add(1, std::memory_order_relaxed);
+    notifyReaders(header);
+}
+
+void IPCWriter::writeState(const WorldState& state, const ContextFrame& context,
+                           SharedMemoryManager& mgr) {
+    std::string_view context_json(state.context_json,
+                                  strnlen(state.context_json, sizeof(state.context_json)));
+    if (publishContext(context, context_json, mgr) == 0) return;
+    writePosition(state, mgr);
+}
+
+uint32_t IPCWriter::publishContext(const ContextFrame& context, std::string_view context_json,
+                                   SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return 0;
+    
+    auto* header = mgr.getHeader();
+    auto* slab = mgr.getContextSlab();
+    
+    if (!header || !slab) return 0;
+    
+    constexpr size_t JSON_CAPACITY = sizeof(ContextPayload::context_json) - 1;
+    context_json = context_json.substr(0, std::min(context_json.size(), JSON_CAPACITY));
+    
+    // We are the only writer of the slab, so the current slot can be
+    // compared without going through its seqlock
+    uint32_t current_id = header->context_id.load(std::memory_order_relaxed);
+    if (current_id != 0) {
+        const ContextPayload& current =
+            slab[(current_id - 1) % SharedMemoryHeader::CONTEXT_SLAB_SIZE].payload;
+        if (std::memcmp(&current.frame, &context, sizeof(ContextFrame)) == 0 &&
+            std::string_view(current.context_json) == context_json) {
+            IPCStats::increment(StatCounter::ContextCacheHits, 1, mgr);
+            return current_id;
+        }
+    }
+    
+    uint32_t id = current_id + 1;
+    ContextSlot& slot = slab[(id - 1) % SharedMemoryHeader::CONTEXT_SLAB_SIZE];
+    slot.sequence.store(2 * static_cast<uint64_t>(id) - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    slot.payload.frame = context;
+    std::memset(slot.payload.context_json, 0, sizeof(slot.payload.context_json));
+    std::memcpy(slot.payload.context_json, context_json.data(), context_json.size());
+    
+    slot.sequence.store(2 * static_cast<uint64_t>(id), std::memory_order_release);
+    
+    header->context_id.store(id, std::memory_order_release);
+    header->total_context_updates.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void IPCWriter::writePosition(const WorldState& state, SharedMemoryManager& mgr) {
     if (!mgr.isReady()) return;
     
     auto* header = mgr.getHeader();
@@ -19,25 +122,18 @@ void IPCWriter::writeState(const WorldState& state, const ContextFrame& context)
     
     if (!header || !buffer) return;
     
-    // Get write index and increment atomically
-    uint32_t write_idx = header->write_index.load(std::memory_order_relaxed);
-    uint32_t next_write = (write_idx + 1) % SharedMemoryHeader::RING_BUFFER_SIZE;
+    const uint32_t ring_capacity = mgr.getRingCapacity();
+    uint32_t context_id = header->context_id.load(std::memory_order_relaxed);
     
-    // Prepare entry
-    RingBufferEntry& entry = buffer[write_idx];
-    entry.sequence.store(header->global_sequence.load(std::memory_order_relaxed),
-                        std::memory_order_release);
-    entry.state = state;
-    entry.context = context;
-    
-    // Atomic increment of global sequence and write index
-    header->global_sequence.fetch_add(1, std::memory_order_release);
-    header->write_index.store(next_write, std::memory_order_release);
-    header->total_updates.fetch_add(1, std::memory_order_relaxed);
+    PositionData data = toPositionData(state, context_id);
+    if (context_id != lastRecordContext(header, buffer, ring_capacity)) {
+        data.record_type = RecordType::ContextChanged;
+    }
+    publishRecord(header, buffer, ring_capacity, data);
 }
 
-void IPCWriter::updateLocation(double lat, double lon, double alt, int64_t timestamp) {
-    auto& mgr = SharedMemoryManager::getInstance();
+void IPCWriter::updateLocation(double lat, double lon, double alt, int64_t timestamp,
+                               SharedMemoryManager& mgr) {
     if (!mgr.isReady()) return;
     
     auto* header = mgr.getHeader();
@@ -45,26 +141,129 @@ void IPCWriter::updateLocation(double lat, double lon, double alt, int64_t times
     
     if (!header || !buffer) return;
     
-    uint32_t write_idx = header->write_index.load(std::memory_order_relaxed);
-    RingBufferEntry& entry = buffer[write_idx];
+    const uint32_t ring_capacity = mgr.getRingCapacity();
+    const uint32_t max_chain = std::min(MAX_DELTA_CHAIN, ring_capacity / 2);
+    uint64_t next_seq = header->global_sequence.load(std::memory_order_relaxed) + 1;
+    uint64_t base_seq = header->last_full_sequence.load(std::memory_order_relaxed);
+    uint32_t context_id = header->context_id.load(std::memory_order_relaxed);
+    bool context_changed = context_id != lastRecordContext(header, buffer, ring_capacity);
+    
+    PositionData data{};
+    if (base_seq != 0 && !context_changed && next_seq - base_seq <= max_chain) {
+        // Position record: readers take everything else from the base record
+        data.record_type = RecordType::Position;
+        data.base_offset = static_cast<uint8_t>(next_seq - base_seq);
+    } else {
+        // Start a new chain (or mark the context change) with a full record
+        // carried forward from the previous base (ours, so no seqlock needed)
+        if (base_seq != 0) {
+            data = buffer[ringSlot(base_seq, ring_capacity)].data;
+        }
+        data.record_type = context_changed ? RecordType::ContextChanged : RecordType::FullState;
+        data.base_offset = 0;
+    }
+    
+    data.context_id = context_id;
+    data.latitude = lat;
+    data.longitude = lon;
+    data.altitude = static_cast<float>(alt);
+    data.last_update_ms = timestamp;
+    
+    publishRecord(header, buffer, ring_capacity, data);
+}
+
+ConsumerLagReport IPCWriter::publishConsumerLag(SharedMemoryManager& mgr) {
+    ConsumerLagReport report;
+    if (!mgr.isReady()) return report;
+    
+    auto* header = mgr.getHeader();
+    auto* table = mgr.getConsumerTable();
+    
+    if (!header || !table) return report;
+    
+    const uint64_t head = header->global_sequence.load(std::memory_order_acquire);
+    const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    
+    for (size_t i = 0; i < SharedMemoryHeader::MAX_CONSUMERS; ++i) {
+        ConsumerSlot& slot = table[i];
+        uint32_t pid = slot.pid.load(std::memory_order_acquire);
+        if (pid == 0) continue;
+        
+        if (::kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH) {
+            slot.heartbeat_ms.store(0, std::memory_order_relaxed);
+            if (slot.pid.compare_exchange_strong(pid, 0, std::memory_order_acq_rel)) {
+                ++report.reclaimed_slots;
+            }
+            continue;
+        }
+        
+        int64_t heartbeat = slot.heartbeat_ms.load(std::memory_order_acquire);
+        if (heartbeat == 0) continue;  // Being claimed or released
+        
+        uint64_t last_seq = slot.last_sequence.load(std::memory_order_relaxed);
+        uint64_t lag = head > last_seq ? head - last_seq : 0;
+        
+        ++report.active_consumers;
+        report.total_overruns += slot.overruns.load(std::memory_order_relaxed);
+        report.max_heartbeat_age_ms = std::max(report.max_heartbeat_age_ms, now_ms - heartbeat);
+        if (lag >= report.max_lag) {
+            report.max_lag = lag;
+            report.slowest_consumer.assign(slot.name, strnlen(slot.name, sizeof(slot.name)));
+        }
+    }
+    
+    header->active_consumers.store(report.active_consumers, std::memory_order_relaxed);
+    header->max_consumer_lag.store(report.max_lag, std::memory_order_relaxed);
+    return report;
+}
+
+void IPCWriter::setActivePlugin(std::string_view name, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return;
+    
+    auto* header = mgr.getHeader();
+    if (!header) return;
+    
+    // Rare and advisory: readers may briefly see a mix of old and new names
+    size_t length = std::min(name.size(), sizeof(header->active_plugin) - 1);
+    std::memset(header->active_plugin, 0, sizeof(header->active_plugin));
+    std::memcpy(header->active_plugin, name.data(), length);
+}
+
+void IPCWriter::saveFilterSnapshot(const FilterSnapshot& snapshot, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return;
+    
+    auto* restart = mgr.getRestartState();
+    if (!restart) return;
+    
+    // Single writer: odd while copying, so a crash mid-save is detectable
+    uint64_t sequence = restart->sequence.load(std::memory_order_relaxed);
+    restart->sequence.store(sequence | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    restart->record_sequence = mgr.getHeader()->global_sequence.load(std::memory_order_relaxed);
+    restart->filter = snapshot;
+    restart->sequence.store((sequence | 1) + 1, std::memory_order_release);
+}
+
+bool IPCWriter::loadFilterSnapshot(FilterSnapshot& snapshot, SharedMemoryManager& mgr) {
+    if (!mgr.isReady()) return false;
     
-    entry.state.smoothed_lat = lat;
-    entry.state.smoothed_lon = lon;
-    entry.state.smoothed_altitude = alt;
-    entry.state.last_update_ms = timestamp;
+    auto* restart = mgr.getRestartState();
+    if (!restart) return false;
     
-    // Increment
-    uint32_t next_write = (write_idx + 1) % SharedMemoryHeader::RING_BUFFER_SIZE;
-    header->write_index.store(next_write, std::memory_order_release);
-    header->global_sequence.fetch_add(1, std::memory_order_release);
+    uint64_t sequence = restart->sequence.load(std::memory_order_acquire);
+    if (sequence == 0 || (sequence & 1) != 0) return false;
+    snapshot = restart->filter;
+    return true;
 }
 
-void IPCWriter::signalAlive() {
-    auto& mgr = SharedMemoryManager::getInstance();
+void IPCWriter::signalAlive(SharedMemoryManager& mgr) {
     if (!mgr.isReady()) return;
     
     auto* header = mgr.getHeader();
-    if (header) {
+    // Called every tick; only write when the flag actually changes so the
+    // control line stays shared in reader caches
+    if (header && !header->location_service_alive.load(std::memory_order_relaxed)) {
         header->location_service_alive.store(true, std::memory_order_release);
     }
 }
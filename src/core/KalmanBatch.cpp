@@ -0,0 +1,361 @@
+/**
+ * @file KalmanBatch.cpp
+ * @brief Structure-of-arrays Kalman kernels (scalar, AVX2, AVX-512)
+ */
+
+#include "KalmanBatch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace s2sgeo {
+
+namespace {
+
+using F = KalmanBatch::Field;
+
+/**
+ * @brief Lane inputs of one kernel run: one pointer per KalmanBatch::Field
+ */
+struct Lanes {
+    double* field[KalmanBatch::LANE_FIELDS];
+    double q_position;
+    double q_velocity;
+    double gate;  // NIS above which a lane keeps its predicted state
+};
+
+// By reference: vector types by value would be ABI-dependent outside the target functions
+template <typename V>
+[[gnu::always_inline]] inline void load(V& v, const double* p) {
+    std::memcpy(&v, p, sizeof(V));
+}
+
+template <typename V>
+[[gnu::always_inline]] inline void store(double* p, const V& v) {
+    std::memcpy(p, &v, sizeof(V));
+}
+
+/**
+ * @brief predict + correct for the tracks in lanes [i, i + lanes of V)
+ * @details `V` is double or a GCC vector of doubles; the arithmetic is the
+ *          same either way. Mirrors ConstantVelocityModel<2> expanded over
+ *          P's upper triangle; gated lanes are blended out with a select.
+ */
+template <typename V>
+[[gnu::always_inline]] inline void updateLanes(const Lanes& lanes, size_t i) {
+    double* const* f = lanes.field;
+    V dt, x0, x1, v0, v1;
+    V p00, p01, p02, p03, p11, p12, p13, p22, p23, p33;
+    load(dt, f[F::DT] + i);
+    load(x0, f[F::X0] + i);
+    load(x1, f[F::X1] + i);
+    load(v0, f[F::V0] + i);
+    load(v1, f[F::V1] + i);
+    load(p00, f[F::P00] + i);
+    load(p01, f[F::P01] + i);
+    load(p02, f[F::P02] + i);
+    load(p03, f[F::P03] + i);
+    load(p11, f[F::P11] + i);
+    load(p12, f[F::P12] + i);
+    load(p13, f[F::P13] + i);
+    load(p22, f[F::P22] + i);
+    load(p23, f[F::P23] + i);
+    load(p33, f[F::P33] + i);
+    
+    // Predict: x = A x, P = A P A^T + Q (velocity block unchanged but for Q)
+    x0 += dt * v0;
+    x1 += dt * v1;
+    V dt2 = dt * dt;
+    p00 += dt * (p02 + p02) + dt2 * p22 + lanes.q_position;
+    p01 += dt * (p03 + p12) + dt2 * p23;
+    p11 += dt * (p13 + p13) + dt2 * p33 + lanes.q_position;
+    p02 += dt * p22;
+    p03 += dt * p23;
+    p12 += dt * p23;
+    p13 += dt * p33;
+    p22 += lanes.q_velocity;
+    p33 += lanes.q_velocity;
+    
+    // Innovation and its covariance S = H P H^T + R, inverted in closed form
+    V r, z0, z1;
+    load(r, f[F::R] + i);
+    load(z0, f[F::Z0] + i);
+    load(z1, f[F::Z1] + i);
+    V y0 = z0 - x0, y1 = z1 - x1;
+    V s00 = p00 + r, s11 = p11 + r;
+    V inv_det = 1.0 / (s00 * s11 - p01 * p01);
+    
+    // Gate: NIS = y^T S^-1 y; a rejected lane stores its predicted x and P
+    V nis = (y0 * y0 * s11 - 2.0 * y0 * y1 * p01 + y1 * y1 * s00) * inv_det;
+    store(f[F::NIS] + i, nis);
+    auto accept = nis <= lanes.gate;
+    
+    // Rows (a, b) of P H^T, before the update
+    V a0 = p00, b0 = p01;
+    V a1 = p01, b1 = p11;
+    V a2 = p02, b2 = p12;
+    V a3 = p03, b3 = p13;
+    
+    // K = P H^T S^-1
+    V k00 = (a0 * s11 - b0 * p01) * inv_det, k01 = (b0 * s00 - a0 * p01) * inv_det;
+    V k10 = (a1 * s11 - b1 * p01) * inv_det, k11 = (b1 * s00 - a1 * p01) * inv_det;
+    V k20 = (a2 * s11 - b2 * p01) * inv_det, k21 = (b2 * s00 - a2 * p01) * inv_det;
+    V k30 = (a3 * s11 - b3 * p01) * inv_det, k31 = (b3 * s00 - a3 * p01) * inv_det;
+    
+    // x += K y
+    store(f[F::X0] + i, accept ? x0 + k00 * y0 + k01 * y1 : x0);
+    store(f[F::X1] + i, accept ? x1 + k10 * y0 + k11 * y1 : x1);
+    store(f[F::V0] + i, accept ? v0 + k20 * y0 + k21 * y1 : v0);
+    store(f[F::V1] + i, accept ? v1 + k30 * y0 + k31 * y1 : v1);
+    
+    // P -= K (P H^T)^T
+    store(f[F::P00] + i, accept ? p00 - (k00 * a0 + k01 * b0) : p00);
+    store(f[F::P01] + i, accept ? p01 - (k00 * a1 + k01 * b1) : p01);
+    store(f[F::P02] + i, accept ? p02 - (k00 * a2 + k01 * b2) : p02);
+    store(f[F::P03] + i, accept ? p03 - (k00 * a3 + k01 * b3) : p03);
+    store(f[F::P11] + i, accept ? p11 - (k10 * a1 + k11 * b1) : p11);
+    store(f[F::P12] + i, accept ? p12 - (k10 * a2 + k11 * b2) : p12);
+    store(f[F::P13] + i, accept ? p13 - (k10 * a3 + k11 * b3) : p13);
+    store(f[F::P22] + i, accept ? p22 - (k20 * a2 + k21 * b2) : p22);
+    store(f[F::P23] + i, accept ? p23 - (k20 * a3 + k21 * b3) : p23);
+    store(f[F::P33] + i, accept ? p33 - (k30 * a3 + k31 * b3) : p33);
+}
+
+/**
+ * @brief Run whole vectors of `Width` lanes from `begin`
+ * @return First lane not processed
+ */
+template <typename V, size_t Width>
+[[gnu::always_inline]] inline size_t runLanes(const Lanes& lanes, size_t begin, size_t count) {
+    size_t i = begin;
+    for (; i + Width <= count; i += Width) {
+        updateLanes<V>(lanes, i);
+    }
+    return i;
+}
+
+#ifdef S2SGEO_SIMD_X86
+typedef double Double4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+
+[[gnu::target("avx2,fma")]] size_t runAVX2(const Lanes& lanes, size_t count) {
+    return runLanes<Double4, 4>(lanes, 0, count);
+}
+
+[[gnu::target("avx512f")]] size_t runAVX512(const Lanes& lanes, size_t count) {
+    return runLanes<Double8, 8>(lanes, 0, count);
+}
+#endif
+
+} // namespace
+
+KalmanBatch::KalmanBatch(size_t capacity) : simd_path_(bestSimdPath()) {
+    for (auto& field : tracks_) {
+        field.reserve(capacity);
+    }
+    last_update_ms_.reserve(capacity);
+    frames_.reserve(capacity);
+    rejections_.reserve(capacity);
+    setProcessNoise(0.1);  // Default tuning, as KalmanFilter
+    setTuning(KalmanTuning{});
+}
+
+uint32_t KalmanBatch::addTrack() {
+    for (auto& field : tracks_) {
+        field.push_back(0.0);
+    }
+    last_update_ms_.push_back(0);
+    frames_.emplace_back();
+    rejections_.push_back(0);
+    uint32_t track = static_cast<uint32_t>(last_update_ms_.size() - 1);
+    resetTrack(track);
+    return track;
+}
+
+void KalmanBatch::resetTrack(uint32_t track) {
+    clearState(track);
+    last_update_ms_[track] = 0;
+    frames_[track].clear();
+    rejections_[track] = 0;
+}
+
+void KalmanBatch::clearState(uint32_t track) {
+    for (auto& field : tracks_) {
+        field[track] = 0.0;
+    }
+    // Initial covariance (high uncertainty)
+    for (Field diagonal : {P00, P11, P22, P33}) {
+        tracks_[diagonal][track] = 1e6;
+    }
+}
+
+void KalmanBatch::reinitialize(uint32_t track, const LocationFix& fix) {
+    frames_[track].anchor(fix.latitude, fix.longitude, fix.altitude);
+    clearState(track);
+    rejections_[track] = 0;
+    
+    // Correct only: a one-lane kernel run with dt = 0 and Q = 0 leaves the predict a no-op
+    double inputs[LANE_FIELDS - STATE_FIELDS] = {};
+    inputs[R - STATE_FIELDS] = std::max(r_floor_, fix.accuracy * fix.accuracy);
+    Lanes lanes;
+    lanes.q_position = 0.0;
+    lanes.q_velocity = 0.0;
+    lanes.gate = std::numeric_limits<double>::infinity();
+    for (size_t f = 0; f < STATE_FIELDS; ++f) {
+        lanes.field[f] = tracks_[f].data() + track;
+    }
+    for (size_t f = STATE_FIELDS; f < LANE_FIELDS; ++f) {
+        lanes.field[f] = &inputs[f - STATE_FIELDS];
+    }
+    updateLanes<double>(lanes, 0);
+}
+
+void KalmanBatch::update(std::span<const uint32_t> tracks, std::span<const LocationFix> fixes) {
+    size_t count = std::min(tracks.size(), fixes.size());
+    if (count == 0) return;
+    
+    if (lanes_[DT].size() < count) {
+        for (auto& field : lanes_) {
+            field.resize(count);
+        }
+    }
+    
+    // Per-track dt, frame, z and R, exactly as KalmanFilter::update
+    for (size_t i = 0; i < count; ++i) {
+        const LocationFix& fix = fixes[i];
+        uint32_t track = tracks[i];
+        lanes_[DT][i] = filterStepSeconds(last_update_ms_[track], fix.timestamp_ms);
+        last_update_ms_[track] = fix.timestamp_ms;
+        
+        LocalTangentFrame& frame = frames_[track];
+        if (!frame.isAnchored()) {
+            frame.anchor(fix.latitude, fix.longitude, fix.altitude);
+        } else if (frame.needsReanchor(tracks_[X0][track], tracks_[X1][track])) {
+            GeodeticPoint position = frame.toGeodetic(tracks_[X0][track], tracks_[X1][track]);
+            frame.anchor(position.latitude, position.longitude, frame.anchorPoint().altitude);
+            tracks_[X0][track] = 0.0;
+            tracks_[X1][track] = 0.0;
+        }
+        EnuPoint enu = frame.toEnu(fix.latitude, fix.longitude);
+        lanes_[Z0][i] = enu.east;
+        lanes_[Z1][i] = enu.north;
+        lanes_[R][i] = std::max(r_floor_, fix.accuracy * fix.accuracy);
+    }
+    
+    // Tracks updated in index order (e.g. a whole fleet per tick) run in place
+    bool contiguous = true;
+    for (size_t i = 1; i < count && contiguous; ++i) {
+        contiguous = tracks[i] == tracks[0] + i;
+    }
+    
+    Lanes lanes;
+    lanes.q_position = q_position_;
+    lanes.q_velocity = q_velocity_;
+    lanes.gate = gate_;
+    for (size_t f = 0; f < LANE_FIELDS; ++f) {
+        lanes.field[f] = lanes_[f].data();
+    }
+    if (contiguous) {
+        for (size_t f = 0; f < STATE_FIELDS; ++f) {
+            lanes.field[f] = tracks_[f].data() + tracks[0];
+        }
+    } else {
+        for (size_t f = 0; f < STATE_FIELDS; ++f) {
+            for (size_t i = 0; i < count; ++i) {
+                lanes_[f][i] = tracks_[f][tracks[i]];
+            }
+        }
+    }
+    
+    size_t done = 0;
+    switch (simd_path_) {
+#ifdef S2SGEO_SIMD_X86
+        case SimdPath::AVX512:
+            done = runAVX512(lanes, count);
+            break;
+        case SimdPath::AVX2:
+            done = runAVX2(lanes, count);
+            break;
+#endif
+        default:
+            break;
+    }
+    runLanes<double, 1>(lanes, done, count);
+    
+    if (!contiguous) {
+        for (size_t f = 0; f < STATE_FIELDS; ++f) {
+            for (size_t i = 0; i < count; ++i) {
+                tracks_[f][tracks[i]] = lanes_[f][i];
+            }
+        }
+    }
+    
+    // Gate bookkeeping, as KalmanFilter::update
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t track = tracks[i];
+        if (lanes_[NIS][i] <= gate_) {
+            rejections_[track] = 0;
+            counters_.accepted_fixes++;
+        } else if (++rejections_[track] > max_consecutive_rejections_) {
+            reinitialize(track, fixes[i]);
+            counters_.reinitializations++;
+        } else {
+            counters_.gated_fixes++;
+        }
+    }
+}
+
+WorldState KalmanBatch::getSmoothedState(uint32_t track) const {
+    WorldState state{};
+    GeodeticPoint position = frames_[track].toGeodetic(tracks_[X0][track], tracks_[X1][track]);
+    state.smoothed_lat = position.latitude;
+    state.smoothed_lon = position.longitude;
+    state.smoothed_altitude = 0.0;
+    state.velocity_east_mps = tracks_[V0][track];
+    state.velocity_north_mps = tracks_[V1][track];
+    state.is_moving = std::hypot(tracks_[V0][track], tracks_[V1][track]) >
+                      ConstantVelocityModel<2>::MOVING_SPEED_MPS;
+    state.last_update_ms = last_update_ms_[track];
+    return state;
+}
+
+Eigen::Vector4d KalmanBatch::state(uint32_t track) const {
+    return Eigen::Vector4d(tracks_[X0][track], tracks_[X1][track],
+                           tracks_[V0][track], tracks_[V1][track]);
+}
+
+Eigen::Matrix4d KalmanBatch::covariance(uint32_t track) const {
+    Eigen::Matrix4d P;
+    P << tracks_[P00][track], tracks_[P01][track], tracks_[P02][track], tracks_[P03][track],
+         0.0, tracks_[P11][track], tracks_[P12][track], tracks_[P13][track],
+         0.0, 0.0, tracks_[P22][track], tracks_[P23][track],
+         0.0, 0.0, 0.0, tracks_[P33][track];
+    return P.selfadjointView<Eigen::Upper>();
+}
+
+void KalmanBatch::setProcessNoise(double q) {
+    // Same split as ConstantVelocityModel::processNoise
+    q_position_ = q * 0.001;
+    q_velocity_ = q;
+}
+
+void KalmanBatch::setTuning(const KalmanTuning& tuning) {
+    // Same resolution as KalmanFilter::setTuning
+    if (tuning.gate_threshold < 0.0) {
+        gate_ = std::numeric_limits<double>::infinity();
+    } else if (tuning.gate_threshold == 0.0) {
+        gate_ = chiSquareGate(2);
+    } else {
+        gate_ = tuning.gate_threshold;
+    }
+    max_consecutive_rejections_ = tuning.max_consecutive_rejections;
+}
+
+bool KalmanBatch::setSimdPath(SimdPath path) {
+    if (!simdPathSupported(path)) return false;
+    simd_path_ = path;
+    return true;
+}
+
+} // namespace s2sgeo
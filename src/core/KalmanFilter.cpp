@@ -4,150 +4,534 @@
  */
 
 #include "KalmanFilter.hpp"
-#include <Eigen/Cholesky>
 #include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <numbers>
 
 namespace s2sgeo {
 
-KalmanFilter::KalmanFilter() {
-    // Initialize state transition matrix
-    // With dt = 0.1s (typical GPS update rate)
-    double dt = 0.1;
-    A_ << 1, 0, dt, 0,
-          0, 1, 0, dt,
-          0, 0, 1, 0,
-          0, 0, 0, 1;
-    
-    // Measurement matrix (we only observe lat/lon, not velocities)
-    H_ << 1, 0, 0, 0,
-          0, 1, 0, 0;
-    
+namespace {
+
+/// Scalars ahead of the matrices in a checkpoint payload (see FilterCheckpointHeader)
+constexpr size_t CHECKPOINT_SCALARS = 10;
+
+template <typename T>
+void appendBytes(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+} // namespace
+
+template <int StateDim, int MeasDim, typename Model>
+BasicKalmanFilter<StateDim, MeasDim, Model>::BasicKalmanFilter() {
     // Process noise covariance
-    double q = 0.1;  // Default tuning
-    Q_ = Eigen::Matrix4d::Identity() * q;
-    Q_(0, 0) *= 0.001;  // Less noise on position
-    Q_(1, 1) *= 0.001;
+    setProcessNoise(0.1);  // Default tuning
     
     // Measurement noise covariance
-    double r = 100.0;  // GPS accuracy ~10m std
-    R_ << r, 0,
-          0, r;
+    setMeasurementNoise(r_floor_);
     
     // Initial state
-    x_ = Eigen::Vector4d::Zero();
+    x_ = State::Zero();
     
     // Initial covariance (high uncertainty)
-    P_ = Eigen::Matrix4d::Identity() * 1e6;
+    P_ = Covariance::Identity() * 1e6;
+    
+    // Default gate, no adaptation
+    setTuning(KalmanTuning{});
 }
 
-void KalmanFilter::predict(double dt) {
-    // Update A with current dt
-    A_(0, 2) = dt;
-    A_(1, 3) = dt;
-    
-    // Predict: x = A * x
-    x_ = A_ * x_;
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::predict(double dt) {
+    // Predict: x = A * x, P = A * P * A^T (blockwise, see the model)
+    Model::predict(x_, P_, dt);
     
-    // Predict: P = A * P * A^T + Q
-    P_ = A_ * P_ * A_.transpose() + Q_;
+    // Predict: P += Q (scaled up while innovations run large)
+    P_ += q_scale_ * Q_;
 }
 
-void KalmanFilter::correct(const Eigen::Vector2d& z) {
+template <int StateDim, int MeasDim, typename Model>
+typename BasicKalmanFilter<StateDim, MeasDim, Model>::MeasurementCovariance
+BasicKalmanFilter<StateDim, MeasDim, Model>::inverse(const MeasurementCovariance& S) {
+    if constexpr (MeasDim == 2) {
+        // Closed-form 2x2 inverse; S is a covariance, so det > 0
+        double inv_det = 1.0 / (S(0, 0) * S(1, 1) - S(0, 1) * S(1, 0));
+        MeasurementCovariance S_inv;
+        S_inv << S(1, 1), -S(0, 1),
+                 -S(1, 0), S(0, 0);
+        return S_inv * inv_det;
+    } else {
+        // Fixed-size Cholesky solve: S is symmetric positive definite, and LLT is
+        // better conditioned than a general inverse; no allocation
+        return S.llt().solve(MeasurementCovariance::Identity());
+    }
+}
+
+template <int StateDim, int MeasDim, typename Model>
+bool BasicKalmanFilter<StateDim, MeasDim, Model>::correct(const Measurement& z, double gate) {
     // Innovation
-    Eigen::Vector2d y = z - H_ * x_;
+    Measurement y = z - Model::measure(x_);
+    MeasurementCovariance HPHt = Model::project(P_);
+    
+    // Adaptive R: innovation variance the state covariance does not explain
+    if (tuning_.adaptive_measurement_noise) {
+        Measurement excess = innovation_average_.diagonal() - HPHt.diagonal();
+        R_.diagonal() = R_.diagonal().cwiseMax(excess);
+    }
     
     // Innovation covariance
-    Eigen::Matrix2d S = H_ * P_ * H_.transpose() + R_;
+    MeasurementCovariance S_inv = inverse(HPHt + R_);
+    
+    // Gate: NIS is chi-square with MeasDim degrees of freedom for a consistent filter
+    last_nis_ = y.dot(S_inv * y);
+    if (!(last_nis_ <= gate)) {
+        if (tuning_.adaptive_process_noise) {
+            // A run of gated fixes may be a manoeuvre the model missed: open Q up until one passes
+            q_scale_ = std::min(2.0 * q_scale_, tuning_.max_process_noise_scale);
+        }
+        return false;
+    }
     
-    // Kalman gain
-    Eigen::Matrix<double, 4, 2> K = P_ * H_.transpose() * S.inverse();
+    double alpha = tuning_.adaptation_rate;
+    if (tuning_.adaptive_measurement_noise) {
+        innovation_average_ = (1.0 - alpha) * innovation_average_ + alpha * (y * y.transpose());
+    }
+    if (tuning_.adaptive_process_noise) {
+        nis_average_ = (1.0 - alpha) * nis_average_ + alpha * last_nis_;
+        q_scale_ = std::clamp(nis_average_ / MeasDim, 1.0, tuning_.max_process_noise_scale);
+    }
+    
+    // Kalman gain: K = P H^T S^-1
+    Gain PHt = Model::crossCovariance(P_);
+    Gain K = PHt * S_inv;
     
     // Update state
-    x_ = x_ + K * y;
+    x_.noalias() += K * y;
+    
+    // Update covariance: P = (I - K H) P, with H P = (P H^T)^T
+    P_.noalias() -= K * PHt.transpose();
+    return true;
+}
+
+template <int StateDim, int MeasDim, typename Model>
+bool BasicKalmanFilter<StateDim, MeasDim, Model>::correctVelocity(const Eigen::Vector2d& z,
+                                                                  const Eigen::Matrix2d& R, double gate) {
+    constexpr int V = Model::VELOCITY;
+    Eigen::Vector2d y = z - x_.template segment<2>(V);
+    
+    // H selects the velocity block: P H^T is two columns of P, H P H^T a 2x2 block
+    Eigen::Matrix<double, StateDim, 2> PHt = P_.template middleCols<2>(V);
+    Eigen::Matrix2d S_inv = (PHt.template middleRows<2>(V) + R).inverse();
+    if (!(y.dot(S_inv * y) <= gate)) return false;
     
-    // Update covariance
-    P_ = (Eigen::Matrix4d::Identity() - K * H_) * P_;
+    Eigen::Matrix<double, StateDim, 2> K = PHt * S_inv;
+    x_.noalias() += K * y;
+    P_.noalias() -= K * PHt.transpose();
+    return true;
 }
 
-void KalmanFilter::update(const LocationFix& measurement) {
-    int64_t current_time_ms = measurement.timestamp_ms;
-    double dt_s = 0.1;  // Default
+template <int StateDim, int MeasDim, typename Model>
+bool BasicKalmanFilter<StateDim, MeasDim, Model>::correctScalar(double y, const Eigen::Vector2d& H,
+                                                                double r, double gate) {
+    constexpr int V = Model::VELOCITY;
+    State PHt = P_.template middleCols<2>(V) * H;
+    double s = H.dot(PHt.template segment<2>(V)) + r;
+    if (!(y * y / s <= gate)) return false;
     
-    if (last_update_ms_ > 0) {
-        dt_s = (current_time_ms - last_update_ms_) / 1000.0;
+    State K = PHt / s;
+    x_.noalias() += K * y;
+    P_.noalias() -= K * PHt.transpose();
+    return true;
+}
+
+template <int StateDim, int MeasDim, typename Model>
+double BasicKalmanFilter<StateDim, MeasDim, Model>::velocityGate(int dof) const {
+    return tuning_.gate_threshold < 0.0 ? std::numeric_limits<double>::infinity() : chiSquareGate(dof);
+}
+
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::correctVelocity(const LocationFix& measurement) {
+    constexpr double SPEED_STD_FLOOR = 0.1;         // m/s
+    constexpr double HEADING_STD_FLOOR_DEG = 1.0;
+    constexpr double RADIANS_PER_DEGREE = std::numbers::pi / 180.0;
+    
+    uint8_t measured = measurement.measured & tuning_.velocity_measurements;
+    if (!std::isfinite(measurement.speed) || measurement.speed < 0.0) {
+        measured &= ~LocationFix::HAS_SPEED;
+    }
+    if (!std::isfinite(measurement.heading)) {
+        measured &= ~LocationFix::HAS_HEADING;
     }
-    last_update_ms_ = current_time_ms;
+    if (measured == 0) return;
+    
+    double speed = measurement.speed;
+    double speed_std = std::max(SPEED_STD_FLOOR, measurement.speed_accuracy);
+    double heading = measurement.heading * RADIANS_PER_DEGREE;
+    double heading_std = std::max(HEADING_STD_FLOOR_DEG, measurement.heading_accuracy) * RADIANS_PER_DEGREE;
+    
+    constexpr int V = Model::VELOCITY;
+    double velocity_east = x_(V);
+    double velocity_north = x_(V + 1);
+    double filter_speed = std::hypot(velocity_east, velocity_north);
+    
+    bool accepted;
+    if ((measured & LocationFix::HAS_SPEED) && speed < Model::MOVING_SPEED_MPS) {
+        // Stopped or nearly: the course is noise, the velocity is within `speed` of zero
+        double r = 0.5 * speed * speed + speed_std * speed_std;
+        accepted = correctVelocity(Eigen::Vector2d::Zero(), Eigen::Matrix2d::Identity() * r, velocityGate(2));
+    } else if (measured == (LocationFix::HAS_SPEED | LocationFix::HAS_HEADING)) {
+        // (speed, course) -> (east, north) = speed (sin, cos), noise through the Jacobian
+        double s = std::sin(heading);
+        double c = std::cos(heading);
+        Eigen::Matrix2d J;
+        J << s, speed * c,
+             c, -speed * s;
+        Eigen::Matrix2d R = J * Eigen::Vector2d(speed_std * speed_std, heading_std * heading_std).asDiagonal() *
+                            J.transpose();
+        accepted = correctVelocity(Eigen::Vector2d(speed * s, speed * c), R, velocityGate(2));
+    } else if (filter_speed > Model::MOVING_SPEED_MPS) {
+        if (measured & LocationFix::HAS_SPEED) {
+            // h = |v|, H = v^T / |v|
+            Eigen::Vector2d H(velocity_east / filter_speed, velocity_north / filter_speed);
+            accepted = correctScalar(speed - filter_speed, H, speed_std * speed_std, velocityGate(1));
+        } else {
+            // h = atan2(v_east, v_north), H = (v_north, -v_east) / |v|^2; innovation wrapped to (-pi, pi]
+            double y = std::remainder(heading - std::atan2(velocity_east, velocity_north), 2.0 * std::numbers::pi);
+            Eigen::Vector2d H(velocity_north, -velocity_east);
+            H /= filter_speed * filter_speed;
+            accepted = correctScalar(y, H, heading_std * heading_std, velocityGate(1));
+        }
+    } else {
+        // A lone speed or course cannot orient a velocity the filter does not have yet
+        return;
+    }
+    
+    if (accepted) {
+        heading_from_course_ = true;
+        counters_.velocity_corrections++;
+    } else {
+        counters_.gated_velocity++;
+    }
+}
+
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::correctZeroVelocity(double std_mps) {
+    if (!frame_.isAnchored()) return;
+    
+    // Never gated: the caller's stationarity evidence outranks the filter's velocity
+    correctVelocity(Eigen::Vector2d::Zero(), Eigen::Matrix2d::Identity() * (std_mps * std_mps),
+                    std::numeric_limits<double>::infinity());
+}
+
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::reinitialize(const LocationFix& measurement) {
+    // The fix is where we are now (e.g. leaving a tunnel): start over from it
+    frame_.anchor(measurement.latitude, measurement.longitude, measurement.altitude);
+    x_ = State::Zero();
+    P_ = Covariance::Identity() * 1e6;
+    resetAdaptation();
+    heading_valid_ = false;
+    
+    Measurement z;
+    Model::fromFix(measurement, frame_, r_floor_, z, R_);
+    correct(z, std::numeric_limits<double>::infinity());
+}
+
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::resetAdaptation() {
+    consecutive_rejections_ = 0;
+    innovation_average_ = MeasurementCovariance::Zero();
+    nis_average_ = MeasDim;
+    q_scale_ = 1.0;
+}
+
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::update(const LocationFix& measurement) {
+    double dt_s = filterStepSeconds(last_update_ms_, measurement.timestamp_ms);
+    last_update_ms_ = measurement.timestamp_ms;
     
-    // Clamp dt to reasonable values
-    if (dt_s < 0.01) dt_s = 0.01;
-    if (dt_s > 1.0) dt_s = 1.0;
+    // The first fix after a reset becomes the origin of the ENU frame
+    if (!frame_.isAnchored()) {
+        frame_.anchor(measurement.latitude, measurement.longitude, measurement.altitude);
+    } else {
+        Model::reanchor(x_, frame_);
+    }
     
     // Adapt measurement noise based on accuracy
-    double r = std::max(100.0, measurement.accuracy * measurement.accuracy);
-    R_ << r, 0,
-          0, r;
+    Measurement z;
+    Model::fromFix(measurement, frame_, r_floor_, z, R_);
     
     // Predict
     predict(dt_s);
     
-    // Correct with GPS measurement
-    Eigen::Vector2d z(measurement.latitude, measurement.longitude);
-    correct(z);
-    
-    // Optional: PDR fusion
-    if (use_pdr_ && detectStep(measurement)) {
-        // Step detected: update position based on heading + step length
-        step_count_++;
+    // Correct with GPS measurement, unless it is an outlier
+    if (correct(z, gate_)) {
+        heading_from_course_ = true;
+        consecutive_rejections_ = 0;
+        last_outcome_ = FixOutcome::Accepted;
+        counters_.accepted_fixes++;
+    } else if (++consecutive_rejections_ > tuning_.max_consecutive_rejections) {
+        reinitialize(measurement);
+        last_outcome_ = FixOutcome::Reinitialized;
+        counters_.reinitializations++;
+    } else {
+        last_outcome_ = FixOutcome::Gated;
+        counters_.gated_fixes++;
     }
+    
+    // Doppler speed and course, checked on their own even when the position was gated
+    correctVelocity(measurement);
 }
 
-bool KalmanFilter::detectStep(const LocationFix& imu_data) {
-    const double STEP_THRESHOLD = 15.0;  // m/s^2
-    const double STEP_MIN_INTERVAL = 0.3;  // seconds
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::predictImu(const ImuDelta& delta)
+    requires (StateDim == 4) {
+    // Nothing to propagate before the first fix
+    if (!frame_.isAnchored() || delta.samples == 0) return;
     
-    // Simple peak detection on Z-axis acceleration
-    double accel_magnitude = std::sqrt(
-        imu_data.accel_x * imu_data.accel_x +
-        imu_data.accel_y * imu_data.accel_y +
-        imu_data.accel_z * imu_data.accel_z
-    );
+    if (heading_from_course_) {
+        // Device assumed aligned with travel: the course is the body's heading
+        if (std::hypot(x_(2), x_(3)) > Model::MOVING_SPEED_MPS) {
+            heading_rad_ = std::atan2(x_(3), x_(2));
+            heading_valid_ = true;
+        }
+        heading_from_course_ = false;
+    }
     
-    // Detect peaks (upstroke of walking motion)
-    bool is_step = (last_accel_z_ < STEP_THRESHOLD) && 
-                   (imu_data.accel_z >= STEP_THRESHOLD);
-    last_accel_z_ = imu_data.accel_z;
+    Model::reanchor(x_, frame_);
     
-    return is_step;
+    double T = delta.duration_s;
+    if (!heading_valid_) {
+        // Q is per filter step, and the next fix's predict adds it: adding it per batch
+        // too would inflate P by the flush rate
+        Model::predict(x_, P_, T);
+    } else {
+        // x = A x, P = A P A^T, then the rotated deltas and their noise
+        Model::predict(x_, P_, T);
+        double c = std::cos(heading_rad_);
+        double s = std::sin(heading_rad_);
+        x_(0) += c * delta.delta_position[0] - s * delta.delta_position[1];
+        x_(1) += s * delta.delta_position[0] + c * delta.delta_position[1];
+        x_(2) += c * delta.delta_velocity[0] - s * delta.delta_velocity[1];
+        x_(3) += s * delta.delta_velocity[0] + c * delta.delta_velocity[1];
+        for (int axis = 0; axis < 2; ++axis) {
+            P_(axis, axis) += delta.position_variance;
+            P_(axis + 2, axis + 2) += delta.velocity_variance;
+            P_(axis, axis + 2) += delta.position_velocity_covariance;
+            P_(axis + 2, axis) += delta.position_velocity_covariance;
+        }
+        heading_rad_ += delta.delta_heading_rad;
+    }
+    last_update_ms_ = delta.end_us / 1000;
 }
 
-WorldState KalmanFilter::getSmoothedState() {
+template <int StateDim, int MeasDim, typename Model>
+WorldState BasicKalmanFilter<StateDim, MeasDim, Model>::getSmoothedState() {
     WorldState state;
-    state.smoothed_lat = x_(0);
-    state.smoothed_lon = x_(1);
-    state.smoothed_altitude = 0.0;
-    state.is_moving = (std::abs(x_(2)) > 0.1 || std::abs(x_(3)) > 0.1);
+    Model::toWorldState(x_, frame_, state);
     state.step_count = step_count_;
     state.last_update_ms = last_update_ms_;
     return state;
 }
 
-void KalmanFilter::reset() {
-    x_ = Eigen::Vector4d::Zero();
-    P_ = Eigen::Matrix4d::Identity() * 1e6;
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::reset() {
+    x_ = State::Zero();
+    P_ = Covariance::Identity() * 1e6;
+    frame_.clear();
     step_count_ = 0;
     last_update_ms_ = 0;
+    resetAdaptation();
+    heading_valid_ = false;
+}
+
+template <int StateDim, int MeasDim, typename Model>
+std::vector<uint8_t> BasicKalmanFilter<StateDim, MeasDim, Model>::checkpoint() const {
+    constexpr size_t PAYLOAD_DOUBLES = CHECKPOINT_SCALARS + StateDim + StateDim * (StateDim + 1) / 2 +
+                                       MeasDim * (MeasDim + 1) / 2;
+    
+    FilterCheckpointHeader header{};
+    header.magic = FilterCheckpointHeader::MAGIC;
+    header.version = FilterCheckpointHeader::VERSION;
+    header.state_dim = StateDim;
+    header.meas_dim = MeasDim;
+    header.flags = (frame_.isAnchored() ? FilterCheckpointHeader::FLAG_ANCHORED : 0) |
+                   (use_pdr_ ? FilterCheckpointHeader::FLAG_PDR : 0) |
+                   (heading_valid_ ? FilterCheckpointHeader::FLAG_HEADING_VALID : 0) |
+                   (heading_from_course_ ? FilterCheckpointHeader::FLAG_HEADING_FROM_COURSE : 0);
+    header.step_count = static_cast<uint32_t>(step_count_);
+    header.consecutive_rejections = consecutive_rejections_;
+    header.payload_bytes = PAYLOAD_DOUBLES * sizeof(double);
+    header.last_update_ms = last_update_ms_;
+    
+    std::vector<uint8_t> out;
+    out.reserve(sizeof(header) + header.payload_bytes);
+    appendBytes(out, header);
+    
+    GeodeticPoint anchor = frame_.isAnchored() ? frame_.anchorPoint() : GeodeticPoint{0.0, 0.0, 0.0};
+    for (double value : {anchor.latitude, anchor.longitude, anchor.altitude, process_noise_, r_floor_,
+                         step_length_m_, 0.0, heading_rad_, q_scale_, nis_average_}) {
+        appendBytes(out, value);
+    }
+    for (int i = 0; i < StateDim; ++i) {
+        appendBytes(out, x_(i));
+    }
+    for (int i = 0; i < StateDim; ++i) {
+        for (int j = i; j < StateDim; ++j) {
+            appendBytes(out, P_(i, j));
+        }
+    }
+    for (int i = 0; i < MeasDim; ++i) {
+        for (int j = i; j < MeasDim; ++j) {
+            appendBytes(out, innovation_average_(i, j));
+        }
+    }
+    return out;
+}
+
+template <int StateDim, int MeasDim, typename Model>
+bool BasicKalmanFilter<StateDim, MeasDim, Model>::restore(std::span<const uint8_t> checkpoint) {
+    constexpr size_t PAYLOAD_DOUBLES = CHECKPOINT_SCALARS + StateDim + StateDim * (StateDim + 1) / 2 +
+                                       MeasDim * (MeasDim + 1) / 2;
+    
+    FilterCheckpointHeader header;
+    if (checkpoint.size() < sizeof(header)) return false;
+    std::memcpy(&header, checkpoint.data(), sizeof(header));
+    if (header.magic != FilterCheckpointHeader::MAGIC || header.version == 0 ||
+        header.version > FilterCheckpointHeader::VERSION || header.state_dim != StateDim ||
+        header.meas_dim != MeasDim || header.payload_bytes != PAYLOAD_DOUBLES * sizeof(double) ||
+        checkpoint.size() != sizeof(header) + header.payload_bytes) {
+        return false;
+    }
+    
+    // Decode everything before touching the filter, so a corrupt blob changes nothing
+    double payload[PAYLOAD_DOUBLES];
+    std::memcpy(payload, checkpoint.data() + sizeof(header), sizeof(payload));
+    for (double value : payload) {
+        if (!std::isfinite(value)) return false;
+    }
+    
+    const double* next = payload;
+    double anchor_latitude = *next++;
+    double anchor_longitude = *next++;
+    double anchor_altitude = *next++;
+    double process_noise = *next++;
+    double r_floor = *next++;
+    double step_length_m = *next++;
+    next++;  // Reserved
+    double heading_rad = *next++;
+    double q_scale = *next++;
+    double nis_average = *next++;
+    State x;
+    for (int i = 0; i < StateDim; ++i) {
+        x(i) = *next++;
+    }
+    Covariance P;
+    for (int i = 0; i < StateDim; ++i) {
+        for (int j = i; j < StateDim; ++j) {
+            P(i, j) = P(j, i) = *next++;
+        }
+    }
+    MeasurementCovariance innovation_average;
+    for (int i = 0; i < MeasDim; ++i) {
+        for (int j = i; j < MeasDim; ++j) {
+            innovation_average(i, j) = innovation_average(j, i) = *next++;
+        }
+    }
+    
+    // The blob may come from another daemon: anything the next update() would
+    // turn into NaN or a negative innovation covariance is rejected too
+    bool anchored = header.flags & FilterCheckpointHeader::FLAG_ANCHORED;
+    if (process_noise <= 0.0 || r_floor <= 0.0 || step_length_m < 0.0 || q_scale <= 0.0 ||
+        nis_average < 0.0 || (anchored && (std::abs(anchor_latitude) > 90.0 ||
+                                           std::abs(anchor_longitude) > 180.0)) ||
+        P.llt().info() != Eigen::Success) {
+        return false;
+    }
+    
+    setProcessNoise(process_noise);
+    setMeasurementNoise(r_floor);
+    step_length_m_ = step_length_m;
+    heading_rad_ = heading_rad;
+    q_scale_ = q_scale;
+    nis_average_ = nis_average;
+    x_ = x;
+    P_ = P;
+    innovation_average_ = innovation_average;
+    
+    frame_.clear();
+    if (anchored) {
+        frame_.anchor(anchor_latitude, anchor_longitude, anchor_altitude);
+    }
+    use_pdr_ = header.flags & FilterCheckpointHeader::FLAG_PDR;
+    heading_valid_ = header.flags & FilterCheckpointHeader::FLAG_HEADING_VALID;
+    heading_from_course_ = header.flags & FilterCheckpointHeader::FLAG_HEADING_FROM_COURSE;
+    step_count_ = static_cast<int32_t>(header.step_count);
+    consecutive_rejections_ = header.consecutive_rejections;
+    last_update_ms_ = header.last_update_ms;
+    return true;
 }
 
-void KalmanFilter::setProcessNoise(double q) {
-    Q_ = Eigen::Matrix4d::Identity() * q;
-    Q_(0, 0) *= 0.001;
-    Q_(1, 1) *= 0.001;
+template <int StateDim, int MeasDim, typename Model>
+FilterSnapshot BasicKalmanFilter<StateDim, MeasDim, Model>::snapshot() const
+    requires (StateDim == 4) {
+    FilterSnapshot snapshot{};
+    Eigen::Map<State>(snapshot.state) = x_;
+    Eigen::Map<Eigen::Matrix<double, 4, 4, Eigen::RowMajor>>(snapshot.covariance) = P_;
+    if (frame_.isAnchored()) {
+        snapshot.anchor_latitude = frame_.anchorPoint().latitude;
+        snapshot.anchor_longitude = frame_.anchorPoint().longitude;
+        snapshot.flags |= FilterSnapshot::FLAG_ANCHORED;
+    }
+    snapshot.last_update_ms = last_update_ms_;
+    snapshot.step_count = static_cast<uint32_t>(step_count_);
+    return snapshot;
+}
+
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::restore(const FilterSnapshot& snapshot)
+    requires (StateDim == 4) {
+    x_ = Eigen::Map<const State>(snapshot.state);
+    P_ = Eigen::Map<const Eigen::Matrix<double, 4, 4, Eigen::RowMajor>>(snapshot.covariance);
+    frame_.clear();
+    if (snapshot.flags & FilterSnapshot::FLAG_ANCHORED) {
+        frame_.anchor(snapshot.anchor_latitude, snapshot.anchor_longitude);
+    }
+    last_update_ms_ = snapshot.last_update_ms;
+    step_count_ = static_cast<int32_t>(snapshot.step_count);
+    resetAdaptation();
+    heading_valid_ = false;
+    heading_from_course_ = true;
+}
+
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::setProcessNoise(double q) {
+    process_noise_ = q;
+    Q_ = Model::processNoise(q);
 }
 
-void KalmanFilter::setMeasurementNoise(double r) {
-    R_ << r, 0,
-          0, r;
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::setMeasurementNoise(double r) {
+    r_floor_ = r;
+    R_ = MeasurementCovariance::Identity() * r;
 }
 
+template <int StateDim, int MeasDim, typename Model>
+void BasicKalmanFilter<StateDim, MeasDim, Model>::setTuning(const KalmanTuning& tuning) {
+    tuning_ = tuning;
+    if (tuning.gate_threshold < 0.0) {
+        gate_ = std::numeric_limits<double>::infinity();
+    } else if (tuning.gate_threshold == 0.0) {
+        gate_ = chiSquareGate(MeasDim);
+    } else {
+        gate_ = tuning.gate_threshold;
+    }
+    resetAdaptation();
+}
+
+template class BasicKalmanFilter<4, 2, ConstantVelocityModel<2>>;
+template class BasicKalmanFilter<6, 3, ConstantVelocityModel<3>>;
+
 } // namespace s2sgeo
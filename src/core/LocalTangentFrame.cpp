@@ -0,0 +1,56 @@
+/**
+ * @file LocalTangentFrame.cpp
+ * @brief East-North-Up projection around an anchor
+ */
+
+#include "LocalTangentFrame.hpp"
+#include <cmath>
+#include <numbers>
+
+namespace s2sgeo {
+
+namespace {
+
+// WGS-84 ellipsoid
+constexpr double SEMI_MAJOR_AXIS_M = 6378137.0;
+constexpr double ECCENTRICITY_SQ = 6.69437999014e-3;
+constexpr double RADIANS_PER_DEGREE = std::numbers::pi / 180.0;
+
+/**
+ * @brief Longitude difference wrapped into [-180, 180)
+ */
+double wrapDegrees(double degrees) {
+    return degrees - 360.0 * std::floor((degrees + 180.0) / 360.0);
+}
+
+} // namespace
+
+void LocalTangentFrame::anchor(double latitude, double longitude, double altitude) {
+    latitude_ = latitude;
+    longitude_ = longitude;
+    altitude_ = altitude;
+    
+    double sin_lat = std::sin(latitude * RADIANS_PER_DEGREE);
+    double w = 1.0 - ECCENTRICITY_SQ * sin_lat * sin_lat;
+    double meridian_radius = SEMI_MAJOR_AXIS_M * (1.0 - ECCENTRICITY_SQ) / (w * std::sqrt(w));
+    double prime_vertical_radius = SEMI_MAJOR_AXIS_M / std::sqrt(w);
+    
+    metres_per_degree_north_ = meridian_radius * RADIANS_PER_DEGREE;
+    metres_per_degree_east_ = prime_vertical_radius * std::cos(latitude * RADIANS_PER_DEGREE) *
+                              RADIANS_PER_DEGREE;
+    anchored_ = true;
+}
+
+EnuPoint LocalTangentFrame::toEnu(double latitude, double longitude, double altitude) const {
+    return {wrapDegrees(longitude - longitude_) * metres_per_degree_east_,
+            (latitude - latitude_) * metres_per_degree_north_,
+            altitude - altitude_};
+}
+
+GeodeticPoint LocalTangentFrame::toGeodetic(double east, double north, double up) const {
+    return {latitude_ + north / metres_per_degree_north_,
+            wrapDegrees(longitude_ + east / metres_per_degree_east_),
+            altitude_ + up};
+}
+
+} // namespace s2sgeo
@@ -4,9 +4,62 @@
  */
 
 #include "SharedMemoryStructs.hpp"
+#include <algorithm>
+#include <cmath>
 
 namespace s2sgeo {
 
 // Utility function implementations for LocationDataTypes
 
+/**
+ * @brief m/s to saturated cm/s
+ */
+static int16_t toCentimetresPerSecond(double mps) {
+    return static_cast<int16_t>(std::clamp(std::lround(mps * 100.0), -32767L, 32767L));
+}
+
+PositionData toPositionData(const WorldState& state, uint32_t context_id) {
+    PositionData data{};
+    data.latitude = state.smoothed_lat;
+    data.longitude = state.smoothed_lon;
+    data.last_update_ms = state.last_update_ms;
+    data.s2_cell_id = state.s2_cell_id;
+    data.altitude = static_cast<float>(state.smoothed_altitude);
+    data.estimated_distance_m = static_cast<float>(state.estimated_distance_m);
+    data.context_id = context_id;
+    data.step_count = state.step_count;
+    data.s2_cell_level = static_cast<uint8_t>(state.s2_cell_level);
+    data.is_moving = state.is_moving ? 1 : 0;
+    data.velocity_east_cms = toCentimetresPerSecond(state.velocity_east_mps);
+    data.velocity_north_cms = toCentimetresPerSecond(state.velocity_north_mps);
+    return data;
+}
+
+PositionData mergePositionDelta(const PositionData& base, const PositionData& delta) {
+    PositionData merged = base;
+    merged.latitude = delta.latitude;
+    merged.longitude = delta.longitude;
+    merged.altitude = delta.altitude;
+    merged.last_update_ms = delta.last_update_ms;
+    merged.context_id = delta.context_id;
+    merged.record_type = RecordType::Position;
+    merged.base_offset = 0;  // Resolved: nothing left to look up
+    return merged;
+}
+
+void applyPositionData(const PositionData& data, uint64_t sequence, WorldState& state) {
+    state.smoothed_lat = data.latitude;
+    state.smoothed_lon = data.longitude;
+    state.smoothed_altitude = data.altitude;
+    state.velocity_east_mps = data.velocity_east_cms / 100.0;
+    state.velocity_north_mps = data.velocity_north_cms / 100.0;
+    state.s2_cell_id = data.s2_cell_id;
+    state.s2_cell_level = data.s2_cell_level;
+    state.last_update_ms = data.last_update_ms;
+    state.update_sequence = static_cast<uint32_t>(sequence);
+    state.is_moving = data.is_moving != 0;
+    state.step_count = data.step_count;
+    state.estimated_distance_m = data.estimated_distance_m;
+}
+
 } // namespace s2sgeo
@@ -4,81 +4,450 @@
  */
 
 #include "IPCManager.hpp"
+#include "IPCNotifier.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <boost/interprocess/creation_tags.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
 
 using namespace boost::interprocess;
 
 namespace s2sgeo {
 
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool isPowerOfTwo(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static size_t systemPageSize() {
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+/**
+ * @brief Page size of the file system holding `path` (huge page size on hugetlbfs)
+ */
+static size_t backingPageSize(const std::string& path) {
+    std::string dir = path.substr(0, path.find_last_of('/') + 1);
+    struct statvfs fs;
+    if (statvfs(dir.empty() ? "." : dir.c_str(), &fs) == 0 && fs.f_bsize > 0) {
+        return std::max(static_cast<size_t>(fs.f_bsize), systemPageSize());
+    }
+    return systemPageSize();
+}
+
+SegmentLayout SegmentLayout::compute(uint32_t ring_capacity, size_t page_size) {
+    SegmentLayout layout;
+    layout.ring_capacity = ring_capacity;
+    layout.restart_state_offset = alignUp(sizeof(SharedMemoryHeader), CACHE_LINE_SIZE);
+    layout.ring_offset = alignUp(layout.restart_state_offset + sizeof(RestartState),
+                                 CACHE_LINE_SIZE);
+    layout.context_slab_offset = alignUp(
+        layout.ring_offset + sizeof(PositionRecord) * ring_capacity, CACHE_LINE_SIZE);
+    layout.consumer_table_offset = alignUp(
+        layout.context_slab_offset + sizeof(ContextSlot) * SharedMemoryHeader::CONTEXT_SLAB_SIZE,
+        CACHE_LINE_SIZE);
+    layout.command_ring_offset = alignUp(
+        layout.consumer_table_offset + sizeof(ConsumerSlot) * SharedMemoryHeader::MAX_CONSUMERS,
+        CACHE_LINE_SIZE);
+    layout.stats_offset = alignUp(layout.command_ring_offset + sizeof(CommandRing),
+                                  CACHE_LINE_SIZE);
+    layout.total_size = alignUp(layout.stats_offset + sizeof(StatsBlock), page_size);
+    return layout;
+}
+
+/**
+ * @brief Process-wide tenant -> manager registry
+ */
+static std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::map<std::string, std::unique_ptr<SharedMemoryManager>>& registry() {
+    static std::map<std::string, std::unique_ptr<SharedMemoryManager>> managers;
+    return managers;
+}
+
+SharedMemoryManager::SharedMemoryManager(std::string tenant)
+    : tenant_(std::move(tenant)), segment_name_(segmentNameFor(tenant_)) {
+}
+
 SharedMemoryManager& SharedMemoryManager::getInstance() {
-    static SharedMemoryManager instance;
+    static SharedMemoryManager& instance = getInstance(std::string());
     return instance;
 }
 
-bool SharedMemoryManager::initializeServer() {
+SharedMemoryManager& SharedMemoryManager::getInstance(const std::string& tenant) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto& slot = registry()[tenant];
+    if (!slot) {
+        slot.reset(new SharedMemoryManager(tenant));
+    }
+    return *slot;
+}
+
+std::vector<std::string> SharedMemoryManager::tenants() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<std::string> names;
+    for (const auto& [tenant, mgr] : registry()) {
+        names.push_back(tenant);
+    }
+    return names;
+}
+
+std::string SharedMemoryManager::segmentNameFor(const std::string& tenant) {
+    return tenant.empty() ? SHARED_MEMORY_NAME : std::string(SHARED_MEMORY_NAME) + "." + tenant;
+}
+
+bool SharedMemoryManager::checkTenantName() const {
+    bool valid = tenant_.size() <= MAX_TENANT_NAME &&
+                 std::all_of(tenant_.begin(), tenant_.end(), [](char c) {
+                     return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-';
+                 });
+    if (!valid) {
+        std::cerr << "[SharedMemoryManager] Invalid tenant name: '" << tenant_ << "'" << std::endl;
+    }
+    return valid;
+}
+
+size_t SharedMemoryManager::requiredSegmentSize(uint32_t ring_capacity) {
+    return SegmentLayout::compute(ring_capacity, systemPageSize()).total_size;
+}
+
+bool SharedMemoryManager::initializeServer(const SharedMemoryOptions& options) {
+    releaseMapping();
+    
+    if (!checkTenantName()) return false;
+    
+    if (!isPowerOfTwo(options.ring_capacity)) {
+        std::cerr << "[SharedMemoryManager] Ring capacity must be a power of two: "
+                  << options.ring_capacity << std::endl;
+        return false;
+    }
+    
+    if (options.resume && resumeServer(options)) {
+        return true;
+    }
+    
     try {
-        // Remove any existing segment
-        shared_memory_object::remove(SHARED_MEMORY_NAME);
+        size_t page_size = options.backing_file.empty()
+            ? systemPageSize() : backingPageSize(options.backing_file);
+        SegmentLayout layout = SegmentLayout::compute(options.ring_capacity, page_size);
         
-        // Create new managed shared memory
-        segment_ = std::make_unique<managed_shared_memory>(
-            create_only,
-            SHARED_MEMORY_NAME,
-            SHARED_MEMORY_SIZE
-        );
+        if (options.backing_file.empty()) {
+            // Remove any existing segment
+            shared_memory_object::remove(segment_name_.c_str());
+            
+            shared_memory_object shm(create_only, segment_name_.c_str(), read_write);
+            shm.truncate(static_cast<offset_t>(layout.total_size));
+            region_ = std::make_unique<mapped_region>(shm, read_write, 0, layout.total_size);
+        } else {
+            // Boost cannot size a file mapping; create it with POSIX calls
+            int fd = ::open(options.backing_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0660);
+            if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(layout.total_size)) != 0) {
+                std::cerr << "[SharedMemoryManager] Cannot create backing file "
+                          << options.backing_file << ": " << std::strerror(errno) << std::endl;
+                if (fd >= 0) ::close(fd);
+                return false;
+            }
+            ::close(fd);
+            
+            file_mapping file(options.backing_file.c_str(), read_write);
+            region_ = std::make_unique<mapped_region>(file, read_write, 0, layout.total_size);
+        }
+        backing_file_ = options.backing_file;
+        
+        applyPagePolicy(options, true);
+        
+        char* base = static_cast<char*>(region_->get_address());
+        header_ = new (base) SharedMemoryHeader();
+        header_->layout_hash = sharedMemoryLayoutHash();
+        header_->ring_capacity = layout.ring_capacity;
+        header_->restart_state_offset = layout.restart_state_offset;
+        header_->ring_offset = layout.ring_offset;
+        header_->context_slab_offset = layout.context_slab_offset;
+        header_->consumer_table_offset = layout.consumer_table_offset;
+        header_->command_ring_offset = layout.command_ring_offset;
+        header_->stats_offset = layout.stats_offset;
+        header_->segment_size = layout.total_size;
         
-        // Allocate header
-        header_ = segment_->construct<SharedMemoryHeader>("header")();
+        restart_state_ = new (base + layout.restart_state_offset) RestartState();
+        ring_buffer_ = reinterpret_cast<PositionRecord*>(base + layout.ring_offset);
+        std::uninitialized_value_construct_n(ring_buffer_, layout.ring_capacity);
+        context_slab_ = reinterpret_cast<ContextSlot*>(base + layout.context_slab_offset);
+        std::uninitialized_value_construct_n(context_slab_, SharedMemoryHeader::CONTEXT_SLAB_SIZE);
+        consumer_table_ = reinterpret_cast<ConsumerSlot*>(base + layout.consumer_table_offset);
+        std::uninitialized_value_construct_n(consumer_table_, SharedMemoryHeader::MAX_CONSUMERS);
+        command_ring_ = new (base + layout.command_ring_offset) CommandRing();
+        stats_ = new (base + layout.stats_offset) StatsBlock();
+        ring_capacity_ = layout.ring_capacity;
+        
+        if (!validateLayout(region_->get_size())) {
+            std::cerr << "[SharedMemoryManager] Server layout failed validation" << std::endl;
+            releaseMapping();
+            return false;
+        }
         
-        // Allocate ring buffer
-        ring_buffer_ = segment_->construct<RingBufferEntry[]>
-                       ("ring_buffer")[SharedMemoryHeader::RING_BUFFER_SIZE]();
+        // Publish the header only once everything behind it is constructed
+        header_->magic.store(SharedMemoryHeader::MAGIC, std::memory_order_release);
         
-        header_->location_service_alive = true;
+        // Liveness is raised by the service loop via IPCWriter::signalAlive()
         is_ready_ = true;
         
-        std::cout << "[SharedMemoryManager] Server initialized successfully" << std::endl;
+        std::cout << "[SharedMemoryManager] Server initialized successfully ("
+                  << segment_name_ << ", " << layout.total_size << " bytes, "
+                  << layout.ring_capacity << " slots, page " << page_size << ")" << std::endl;
         return true;
-        
+    
     } catch (const interprocess_exception& e) {
         std::cerr << "[SharedMemoryManager] Server init failed: " << e.what() << std::endl;
+        releaseMapping();
         return false;
     }
 }
 
-bool SharedMemoryManager::connectClient() {
+bool SharedMemoryManager::connectClient(const SharedMemoryOptions& options) {
+    releaseMapping();
+    
+    if (!checkTenantName()) return false;
+    
     try {
-        // Open existing managed shared memory
-        segment_ = std::make_unique<managed_shared_memory>(open_only, SHARED_MEMORY_NAME);
+        // Open the existing segment and map all of it
+        boost::interprocess::mode_t mode = options.read_only ? read_only : read_write;
+        if (options.backing_file.empty()) {
+            shared_memory_object shm(open_only, segment_name_.c_str(), mode);
+            region_ = std::make_unique<mapped_region>(shm, mode);
+        } else {
+            file_mapping file(options.backing_file.c_str(), mode);
+            region_ = std::make_unique<mapped_region>(file, mode);
+        }
+        read_only_ = options.read_only;
+        backing_file_ = options.backing_file;
         
-        // Find the header and ring buffer
-        header_ = segment_->find<SharedMemoryHeader>("header").first;
-        ring_buffer_ = segment_->find<RingBufferEntry[]>("ring_buffer").first;
+        char* base = static_cast<char*>(region_->get_address());
+        header_ = reinterpret_cast<SharedMemoryHeader*>(base);
         
-        if (!header_ || !ring_buffer_) {
-            std::cerr << "[SharedMemoryManager] Could not find shared memory objects" << std::endl;
+        if (!checkAbi(region_->get_size())) {
+            releaseMapping();
+            return false;
+        }
+        if (!validateLayout(region_->get_size())) {
+            std::cerr << "[SharedMemoryManager] Shared memory layout does not match this build"
+                      << std::endl;
+            releaseMapping();
             return false;
         }
         
+        mapRegions();
+        applyPagePolicy(options, false);
+        
         is_ready_ = true;
-        std::cout << "[SharedMemoryManager] Client connected successfully" << std::endl;
+        std::cout << "[SharedMemoryManager] Client connected successfully ("
+                  << segment_name_ << ")" << std::endl;
         return true;
-        
+    
     } catch (const interprocess_exception& e) {
         std::cerr << "[SharedMemoryManager] Client connect failed: " << e.what() << std::endl;
+        releaseMapping();
         return false;
     }
 }
 
+bool SharedMemoryManager::resumeServer(const SharedMemoryOptions& options) {
+    try {
+        if (options.backing_file.empty()) {
+            shared_memory_object shm(open_only, segment_name_.c_str(), read_write);
+            region_ = std::make_unique<mapped_region>(shm, read_write);
+        } else {
+            if (::access(options.backing_file.c_str(), F_OK) != 0) return false;
+            file_mapping file(options.backing_file.c_str(), read_write);
+            region_ = std::make_unique<mapped_region>(file, read_write);
+        }
+    } catch (const interprocess_exception&) {
+        // Nothing to resume
+        releaseMapping();
+        return false;
+    }
+    
+    header_ = static_cast<SharedMemoryHeader*>(region_->get_address());
+    if (!checkAbi(region_->get_size()) || !validateLayout(region_->get_size())) {
+        std::cerr << "[SharedMemoryManager] Existing segment " << segment_name_
+                  << " cannot be resumed, recreating it" << std::endl;
+        releaseMapping();
+        return false;
+    }
+    if (header_->ring_capacity != options.ring_capacity) {
+        std::cerr << "[SharedMemoryManager] Existing segment has " << header_->ring_capacity
+                  << " slots, " << options.ring_capacity << " requested; recreating it" << std::endl;
+        releaseMapping();
+        return false;
+    }
+    
+    mapRegions();
+    backing_file_ = options.backing_file;
+    
+    // Client-side policy: prefault by touching pages, never by zeroing them
+    applyPagePolicy(options, false);
+    
+    // Liveness is raised again by the new service loop
+    header_->location_service_alive.store(false, std::memory_order_release);
+    
+    // last_full_sequence is stored after global_sequence, so a crash in between
+    // leaves it behind and the next delta would name the wrong base: find the
+    // newest full record again
+    uint64_t head = header_->global_sequence.load(std::memory_order_acquire);
+    uint64_t last_full = 0;
+    for (uint64_t seq = head; seq != 0 && head - seq < ring_capacity_; --seq) {
+        const PositionRecord& record = ring_buffer_[ringSlot(seq, ring_capacity_)];
+        if (record.sequence.load(std::memory_order_relaxed) == 2 * seq &&
+            record.data.record_type != RecordType::Position) {
+            last_full = seq;
+            break;
+        }
+    }
+    header_->last_full_sequence.store(last_full, std::memory_order_release);
+    
+    resumed_ = true;
+    is_ready_ = true;
+    std::cout << "[SharedMemoryManager] Resumed existing segment (" << segment_name_ << ", "
+              << ring_capacity_ << " slots, sequence "
+              << header_->global_sequence.load(std::memory_order_acquire) << ")" << std::endl;
+    return true;
+}
+
+void SharedMemoryManager::mapRegions() {
+    char* base = reinterpret_cast<char*>(header_);
+    ring_capacity_ = header_->ring_capacity;
+    restart_state_ = reinterpret_cast<RestartState*>(base + header_->restart_state_offset);
+    ring_buffer_ = reinterpret_cast<PositionRecord*>(base + header_->ring_offset);
+    context_slab_ = reinterpret_cast<ContextSlot*>(base + header_->context_slab_offset);
+    consumer_table_ = reinterpret_cast<ConsumerSlot*>(base + header_->consumer_table_offset);
+    command_ring_ = reinterpret_cast<CommandRing*>(base + header_->command_ring_offset);
+    stats_ = reinterpret_cast<StatsBlock*>(base + header_->stats_offset);
+}
+
+bool SharedMemoryManager::checkAbi(size_t mapped_size) const {
+    if (mapped_size < sizeof(SharedMemoryHeader)) {
+        std::cerr << "[SharedMemoryManager] Segment too small for a header ("
+                  << mapped_size << " bytes)" << std::endl;
+        return false;
+    }
+    
+    uint32_t magic = header_->magic.load(std::memory_order_acquire);
+    if (magic != SharedMemoryHeader::MAGIC) {
+        std::cerr << "[SharedMemoryManager] Bad magic 0x" << std::hex << magic << std::dec
+                  << " (segment not initialized or not an s2sgeo segment)" << std::endl;
+        return false;
+    }
+    
+    if (header_->version != SharedMemoryHeader::ABI_VERSION) {
+        std::cerr << "[SharedMemoryManager] Daemon uses shared memory ABI v" << header_->version
+                  << ", this build expects v" << SharedMemoryHeader::ABI_VERSION << std::endl;
+        return false;
+    }
+    
+    if (header_->layout_hash != sharedMemoryLayoutHash()) {
+        std::cerr << "[SharedMemoryManager] Layout hash mismatch: daemon 0x" << std::hex
+                  << header_->layout_hash << ", this build 0x" << sharedMemoryLayoutHash()
+                  << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SharedMemoryManager::validateLayout(size_t mapped_size) const {
+    if (!header_ || !isPowerOfTwo(header_->ring_capacity)) return false;
+    
+    SegmentLayout expected = SegmentLayout::compute(header_->ring_capacity, 1);
+    return header_->restart_state_offset == expected.restart_state_offset &&
+           header_->ring_offset == expected.ring_offset &&
+           header_->context_slab_offset == expected.context_slab_offset &&
+           header_->consumer_table_offset == expected.consumer_table_offset &&
+           header_->command_ring_offset == expected.command_ring_offset &&
+           header_->stats_offset == expected.stats_offset &&
+           header_->segment_size >= expected.total_size &&
+           header_->segment_size <= mapped_size &&
+           reinterpret_cast<uintptr_t>(header_) % CACHE_LINE_SIZE == 0;
+}
+
+void SharedMemoryManager::applyPagePolicy(const SharedMemoryOptions& options, bool is_server) {
+    char* base = static_cast<char*>(region_->get_address());
+    size_t size = region_->get_size();
+
+#ifdef MADV_HUGEPAGE
+    if (options.transparent_huge_pages && ::madvise(base, size, MADV_HUGEPAGE) != 0) {
+        std::cerr << "[SharedMemoryManager] MADV_HUGEPAGE failed: "
+                  << std::strerror(errno) << std::endl;
+    }
+#endif
+
+    // Fault every page in now rather than on the first lap of the ring
+    if (options.prefault) {
+        if (is_server) {
+            std::memset(base, 0, size);
+        } else {
+            size_t page_size = systemPageSize();
+            for (size_t offset = 0; offset < size; offset += page_size) {
+                (void)*static_cast<volatile const char*>(base + offset);
+            }
+        }
+    }
+    
+    if (options.lock_pages && ::mlock(base, size) != 0) {
+        std::cerr << "[SharedMemoryManager] mlock failed: " << std::strerror(errno) << std::endl;
+    }
+}
+
+void SharedMemoryManager::releaseMapping() {
+    header_ = nullptr;
+    restart_state_ = nullptr;
+    ring_buffer_ = nullptr;
+    context_slab_ = nullptr;
+    consumer_table_ = nullptr;
+    command_ring_ = nullptr;
+    stats_ = nullptr;
+    ring_capacity_ = 0;
+    region_.reset();
+    is_ready_ = false;
+    resumed_ = false;
+    read_only_ = false;
+}
+
+void SharedMemoryManager::detach() {
+    if (header_ && !read_only_) {
+        header_->location_service_alive = false;
+        
+        // Release readers blocked in waitForUpdate()
+        header_->update_futex.fetch_add(1, std::memory_order_seq_cst);
+        IPCNotifier::wakeAll(header_->update_futex);
+    }
+    releaseMapping();
+}
+
 void SharedMemoryManager::cleanup() {
     try {
-        if (header_) {
-            header_->location_service_alive = false;
+        detach();
+        if (backing_file_.empty()) {
+            shared_memory_object::remove(segment_name_.c_str());
+        } else {
+            file_mapping::remove(backing_file_.c_str());
+            backing_file_.clear();
         }
-        segment_.reset();
-        shared_memory_object::remove(SHARED_MEMORY_NAME);
-        is_ready_ = false;
         std::cout << "[SharedMemoryManager] Cleaned up" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "[SharedMemoryManager] Cleanup error: " << e.what() << std::endl;
@@ -89,8 +458,28 @@ SharedMemoryHeader* SharedMemoryManager::getHeader() {
     return header_;
 }
 
-RingBufferEntry* SharedMemoryManager::getRingBuffer() {
+RestartState* SharedMemoryManager::getRestartState() {
+    return restart_state_;
+}
+
+PositionRecord* SharedMemoryManager::getRingBuffer() {
     return ring_buffer_;
 }
 
+ContextSlot* SharedMemoryManager::getContextSlab() {
+    return context_slab_;
+}
+
+ConsumerSlot* SharedMemoryManager::getConsumerTable() {
+    return consumer_table_;
+}
+
+CommandRing* SharedMemoryManager::getCommandRing() {
+    return command_ring_;
+}
+
+StatsBlock* SharedMemoryManager::getStats() {
+    return stats_;
+}
+
 } // namespace s2sgeo
@@ -0,0 +1,41 @@
+/**
+ * @file SimdDispatch.cpp
+ * @brief CPU feature checks for the SIMD kernels
+ */
+
+#include "SimdDispatch.hpp"
+#include <initializer_list>
+
+namespace s2sgeo {
+
+bool simdPathSupported(SimdPath path) {
+    switch (path) {
+        case SimdPath::Scalar:
+            return true;
+#ifdef S2SGEO_SIMD_X86
+        case SimdPath::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case SimdPath::AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+SimdPath bestSimdPath() {
+    for (SimdPath path : {SimdPath::AVX512, SimdPath::AVX2}) {
+        if (simdPathSupported(path)) return path;
+    }
+    return SimdPath::Scalar;
+}
+
+const char* simdPathName(SimdPath path) {
+    switch (path) {
+        case SimdPath::AVX2: return "avx2";
+        case SimdPath::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+} // namespace s2sgeo
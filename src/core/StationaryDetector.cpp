@@ -0,0 +1,83 @@
+/**
+ * @file StationaryDetector.cpp
+ * @brief Stationarity from IMU variance and filter speed
+ */
+
+#include "StationaryDetector.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace s2sgeo {
+
+bool StationaryDetector::addImu(const ImuSample& sample) {
+    double accel = std::sqrt(sample.accel_x * sample.accel_x + sample.accel_y * sample.accel_y +
+                             sample.accel_z * sample.accel_z);
+    double gyro = std::sqrt(sample.gyro_x * sample.gyro_x + sample.gyro_y * sample.gyro_y +
+                            sample.gyro_z * sample.gyro_z);
+    
+    if (last_imu_us_ == 0) {
+        accel_mean_ = accel;
+        accel_variance_ = 0.0;
+        gyro_mean_ = gyro;
+    } else {
+        // Exponential moving mean and variance with time constant WINDOW_S
+        double dt = std::clamp((sample.timestamp_us - last_imu_us_) * 1e-6, 0.0, WINDOW_S);
+        double alpha = dt / WINDOW_S;
+        double deviation = accel - accel_mean_;
+        accel_mean_ += alpha * deviation;
+        accel_variance_ = (1.0 - alpha) * (accel_variance_ + alpha * deviation * deviation);
+        gyro_mean_ += alpha * (gyro - gyro_mean_);
+    }
+    last_imu_us_ = sample.timestamp_us;
+    
+    if (accel_variance_ > ACCEL_STD_THRESHOLD * ACCEL_STD_THRESHOLD || gyro_mean_ > GYRO_THRESHOLD) {
+        return moving();
+    }
+    still(sample.timestamp_us / 1000);
+    return false;
+}
+
+bool StationaryDetector::addSpeed(double speed_mps, int64_t timestamp_ms) {
+    if (!(speed_mps <= SPEED_THRESHOLD)) {
+        return moving();
+    }
+    still(timestamp_ms);
+    return false;
+}
+
+bool StationaryDetector::markMoving(int64_t timestamp_ms) {
+    bool woke = moving();
+    still(timestamp_ms);  // The clock restarts from here
+    return woke;
+}
+
+bool StationaryDetector::stationary(int64_t now_ms) {
+    if (still_since_ms_ != 0 && now_ms - last_still_ms_ > EVIDENCE_TIMEOUT_MS) {
+        moving();  // Stale: whatever happened since, we cannot tell
+    }
+    if (!stationary_ && still_since_ms_ != 0 && last_still_ms_ - still_since_ms_ >= SETTLE_MS) {
+        stationary_ = true;
+    }
+    return stationary_;
+}
+
+void StationaryDetector::reset() {
+    *this = StationaryDetector{};
+}
+
+void StationaryDetector::still(int64_t timestamp_ms) {
+    if (still_since_ms_ == 0) {
+        still_since_ms_ = timestamp_ms;
+    }
+    last_still_ms_ = std::max(last_still_ms_, timestamp_ms);
+}
+
+bool StationaryDetector::moving() {
+    bool was_stationary = stationary_;
+    stationary_ = false;
+    still_since_ms_ = 0;
+    last_still_ms_ = 0;
+    return was_stationary;
+}
+
+} // namespace s2sgeo
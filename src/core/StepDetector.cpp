@@ -3,32 +3,217 @@
  * @brief Step detection for Pedestrian Dead Reckoning
  */
 
+#include "StepDetector.hpp"
+#include <algorithm>
 #include <cmath>
+#include <numbers>
 
 namespace s2sgeo {
 
-// Step detection utilities for PDR
+namespace {
 
-class StepDetector {
-public:
-    static constexpr double STEP_THRESHOLD = 1.5;  // m/s^2
-    static constexpr double STEP_MIN_INTERVAL = 0.3;  // seconds
+constexpr double GRAVITY_MPS2 = 9.81;
+
+struct BlockSums {
+    double sum;
+    double sum_square;
+};
+
+/**
+ * @brief FIR over `in` (tap_count - 1 history samples, then n new ones) into
+ *        `out`, and the sum and sum of squares of the output
+ * @details One tap at a time over the whole block, and four partial sums, so
+ *          both loops vectorize without reassociating floating point.
+ */
+[[gnu::always_inline]] inline BlockSums lowPass(const double* taps, size_t tap_count, const double* in,
+                                                double* out, size_t n) {
+    std::fill_n(out, n, 0.0);
+    for (size_t k = 0; k < tap_count; ++k) {
+        double tap = taps[k];
+        const double* shifted = in + k;
+        for (size_t i = 0; i < n; ++i) {
+            out[i] += tap * shifted[i];
+        }
+    }
     
-    bool detectStep(double accel_z, double current_time_s) {
-        // Simple peak detection
-        if (current_time_s - last_step_time_s_ > STEP_MIN_INTERVAL) {
-            if (accel_z > STEP_THRESHOLD && last_accel_z_ < STEP_THRESHOLD) {
-                last_step_time_s_ = current_time_s;
-                return true;
+    double sum[4] = {0.0, 0.0, 0.0, 0.0};
+    double sum_square[4] = {0.0, 0.0, 0.0, 0.0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t lane = 0; lane < 4; ++lane) {
+            sum[lane] += out[i + lane];
+            sum_square[lane] += out[i + lane] * out[i + lane];
+        }
+    }
+    for (; i < n; ++i) {
+        sum[0] += out[i];
+        sum_square[0] += out[i] * out[i];
+    }
+    return {(sum[0] + sum[1]) + (sum[2] + sum[3]), (sum_square[0] + sum_square[1]) + (sum_square[2] + sum_square[3])};
+}
+
+BlockSums lowPassScalar(const double* taps, size_t tap_count, const double* in, double* out, size_t n) {
+    return lowPass(taps, tap_count, in, out, n);
+}
+
+#ifdef S2SGEO_SIMD_X86
+[[gnu::target("avx2,fma")]] BlockSums lowPassAVX2(const double* taps, size_t tap_count, const double* in,
+                                                   double* out, size_t n) {
+    return lowPass(taps, tap_count, in, out, n);
+}
+#endif
+
+} // namespace
+
+StepDetector::StepDetector(double sample_rate_hz) : simd_path_(bestSimdPath()) {
+    // Odd length, so the window has a centre sample to stamp peaks with
+    size_t length = static_cast<size_t>(std::max(3.0, std::round(FILTER_WINDOW_S * sample_rate_hz))) | 1;
+    taps_.resize(length);
+    double sum = 0.0;
+    for (size_t k = 0; k < length; ++k) {
+        taps_[k] = 0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * (k + 1) / (length + 1));
+        sum += taps_[k];
+    }
+    for (double& tap : taps_) {
+        tap /= sum;
+    }
+    
+    history_ = length - 1;
+    magnitude_.resize(history_ + BLOCK);
+    timestamps_.resize(history_ + BLOCK);
+    filtered_.resize(BLOCK);
+}
+
+size_t StepDetector::process(std::span<const int64_t> timestamps_us, std::span<const double> accel_x,
+                             std::span<const double> accel_y, std::span<const double> accel_z,
+                             std::vector<StepEvent>& events) {
+    size_t count = std::min({timestamps_us.size(), accel_x.size(), accel_y.size(), accel_z.size()});
+    size_t before = events.size();
+    for (size_t start = 0; start < count; start += BLOCK) {
+        size_t n = std::min(BLOCK, count - start);
+        double* magnitude = magnitude_.data() + history_;
+        const double* x = accel_x.data() + start;
+        const double* y = accel_y.data() + start;
+        const double* z = accel_z.data() + start;
+        for (size_t i = 0; i < n; ++i) {
+            magnitude[i] = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+        }
+        std::copy_n(timestamps_us.data() + start, n, timestamps_.data() + history_);
+        processBlock(n, events);
+    }
+    return events.size() - before;
+}
+
+size_t StepDetector::process(std::span<const ImuSample> samples, std::vector<StepEvent>& events) {
+    size_t before = events.size();
+    for (size_t start = 0; start < samples.size(); start += BLOCK) {
+        size_t n = std::min(BLOCK, samples.size() - start);
+        double* magnitude = magnitude_.data() + history_;
+        int64_t* timestamps = timestamps_.data() + history_;
+        const ImuSample* block = samples.data() + start;
+        for (size_t i = 0; i < n; ++i) {
+            magnitude[i] = block[i].accel_x * block[i].accel_x + block[i].accel_y * block[i].accel_y +
+                           block[i].accel_z * block[i].accel_z;
+            timestamps[i] = block[i].timestamp_us;
+        }
+        processBlock(n, events);
+    }
+    return events.size() - before;
+}
+
+void StepDetector::processBlock(size_t n, std::vector<StepEvent>& events) {
+    if (n == 0) return;
+    
+    if (!primed_) {
+        // No history yet: pretend the first sample had been there all along
+        std::fill_n(magnitude_.data(), history_, magnitude_[history_]);
+        std::fill_n(timestamps_.data(), history_, timestamps_[history_]);
+    }
+    
+    // Pass 2 and the block statistics
+    double* filtered = filtered_.data();
+    BlockSums sums;
+    switch (simd_path_) {
+#ifdef S2SGEO_SIMD_X86
+        case SimdPath::AVX512:
+        case SimdPath::AVX2:
+            sums = lowPassAVX2(taps_.data(), taps_.size(), magnitude_.data(), filtered, n);
+            break;
+#endif
+        default:
+            sums = lowPassScalar(taps_.data(), taps_.size(), magnitude_.data(), filtered, n);
+            break;
+    }
+    double block_mean = sums.sum / n;
+    double block_mean_square = sums.sum_square / n;
+    
+    const int64_t* centre_us = timestamps_.data() + history_ / 2;  // Input sample under each output
+    int64_t block_end_us = timestamps_[history_ + n - 1];
+    if (!primed_) {
+        mean_ = block_mean;
+        mean_square_ = block_mean_square;
+        previous_ = before_previous_ = filtered[0];
+        previous_us_ = centre_us[0];
+        primed_ = true;
+    } else {
+        double alpha = std::clamp((block_end_us - latest_us_) * 1e-6 / STATS_TIME_CONSTANT_S, 0.0, 1.0);
+        mean_ += alpha * (block_mean - mean_);
+        mean_square_ += alpha * (block_mean_square - mean_square_);
+    }
+    latest_us_ = block_end_us;
+    
+    // Thresholds in |a|^2 units: near 1 g, |a|^2 moves by about 2 g per m/s^2 of |a|
+    double std_dev = std::sqrt(std::max(0.0, mean_square_ - mean_ * mean_));
+    double threshold = mean_ + std::max(THRESHOLD_STDS * std_dev, 2.0 * GRAVITY_MPS2 * MIN_PEAK_ACCEL);
+    const int64_t min_interval_us = static_cast<int64_t>(MIN_STEP_INTERVAL_S * 1e6);
+    const int64_t max_interval_us = static_cast<int64_t>(MAX_STEP_INTERVAL_S * 1e6);
+    
+    // Pass 3: serial peak scan; `previous_` is a peak if it rose into it and falls after it
+    for (size_t j = 0; j < n; ++j) {
+        double value = filtered[j];
+        if (value < mean_) {
+            armed_ = true;
+        }
+        if (armed_ && previous_ > threshold && previous_ > before_previous_ && previous_ >= value &&
+            (last_step_us_ == 0 || previous_us_ - last_step_us_ >= min_interval_us)) {
+            int64_t interval_us = previous_us_ - last_step_us_;
+            bool walking = last_step_us_ != 0 && interval_us <= max_interval_us;
+            double interval_s = walking ? interval_us * 1e-6 : 0.0;
+            if (walking) {
+                interval_average_s_ = interval_average_s_ == 0.0
+                    ? interval_s : 0.75 * interval_average_s_ + 0.25 * interval_s;
             }
+            events.push_back({previous_us_, std::sqrt(previous_), interval_s});
+            last_step_us_ = previous_us_;
+            step_count_++;
+            armed_ = false;
         }
-        last_accel_z_ = accel_z;
-        return false;
+        before_previous_ = previous_;
+        previous_ = value;
+        previous_us_ = centre_us[j];
     }
     
-private:
-    double last_accel_z_ = 0.0;
-    double last_step_time_s_ = 0.0;
-};
+    // Keep the newest history_ samples in front of the next block
+    std::copy(magnitude_.begin() + n, magnitude_.begin() + n + history_, magnitude_.begin());
+    std::copy(timestamps_.begin() + n, timestamps_.begin() + n + history_, timestamps_.begin());
+}
+
+double StepDetector::cadence() const {
+    if (interval_average_s_ == 0.0 || latest_us_ - last_step_us_ > MAX_STEP_INTERVAL_S * 1e6) {
+        return 0.0;
+    }
+    return 60.0 / interval_average_s_;
+}
+
+void StepDetector::reset() {
+    primed_ = false;
+    mean_ = mean_square_ = 0.0;
+    previous_ = before_previous_ = 0.0;
+    previous_us_ = 0;
+    armed_ = false;
+    last_step_us_ = 0;
+    latest_us_ = 0;
+    interval_average_s_ = 0.0;
+}
 
 } // namespace s2sgeo
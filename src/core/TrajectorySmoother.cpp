@@ -0,0 +1,105 @@
+/**
+ * @file TrajectorySmoother.cpp
+ * @brief Forward filter + backward Rauch-Tung-Striebel pass
+ */
+
+#include "TrajectorySmoother.hpp"
+#include <cmath>
+
+namespace s2sgeo {
+
+namespace {
+
+using Model = ConstantVelocityModel<2>;
+using State = KalmanFilter::State;
+using Covariance = KalmanFilter::Covariance;
+
+/**
+ * @brief Re-express a state from one frame in another (velocities carry over)
+ */
+State toFrame(const State& x, const LocalTangentFrame& from, const LocalTangentFrame& to) {
+    GeodeticPoint position = from.toGeodetic(x(0), x(1));
+    EnuPoint enu = to.toEnu(position.latitude, position.longitude);
+    return State(enu.east, enu.north, x(2), x(3));
+}
+
+bool sameFrame(const LocalTangentFrame& a, const LocalTangentFrame& b) {
+    GeodeticPoint pa = a.anchorPoint(), pb = b.anchorPoint();
+    return pa.latitude == pb.latitude && pa.longitude == pb.longitude;
+}
+
+SmoothedFix toSmoothedFix(const State& x, const Covariance& P, const LocalTangentFrame& frame,
+                          int64_t timestamp_ms, FixOutcome outcome) {
+    GeodeticPoint position = frame.toGeodetic(x(0), x(1));
+    return {timestamp_ms, position.latitude, position.longitude, x(2), x(3),
+            std::sqrt(0.5 * (P(0, 0) + P(1, 1))), outcome};
+}
+
+} // namespace
+
+void TrajectorySmoother::smooth(std::span<const LocationFix> fixes, std::vector<SmoothedFix>& out) {
+    out.resize(fixes.size());
+    steps_.resize(fixes.size());
+    if (fixes.empty()) return;
+    
+    filter_.reset();
+    filter_.setProcessNoise(process_noise_);
+    filter_.setMeasurementNoise(measurement_noise_);
+    filter_.setTuning(tuning_);
+    
+    // Forward: the daemon's filter, keeping what the backward pass needs
+    int64_t last_update_ms = 0;
+    for (size_t k = 0; k < fixes.size(); ++k) {
+        Step& step = steps_[k];
+        step.dt = filterStepSeconds(last_update_ms, fixes[k].timestamp_ms);
+        last_update_ms = fixes[k].timestamp_ms;
+        
+        filter_.update(fixes[k]);
+        step.x = filter_.state();
+        step.P = filter_.covariance();
+        step.frame = filter_.frame();
+        step.q_scale = filter_.processNoiseScale();
+        step.outcome = filter_.lastOutcome();
+    }
+    
+    // Backward: x_s[k] = x_f[k] + C (x_s[k+1] - x_p[k+1]), C = P_f[k] A^T P_p[k+1]^-1,
+    // all in step k's frame
+    const Covariance Q = Model::processNoise(process_noise_);
+    size_t last = fixes.size() - 1;
+    State x_next = steps_[last].x;
+    Covariance P_next = steps_[last].P;
+    out[last] = toSmoothedFix(x_next, P_next, steps_[last].frame, fixes[last].timestamp_ms,
+                              steps_[last].outcome);
+    
+    for (size_t k = last; k-- > 0;) {
+        const Step& step = steps_[k];
+        const Step& next = steps_[k + 1];
+        
+        if (next.outcome == FixOutcome::Reinitialized) {
+            // The filter started over at k + 1: k ends the previous segment
+            x_next = step.x;
+            P_next = step.P;
+        } else {
+            State x_pred = step.x;
+            Covariance P_pred = step.P;
+            Model::predict(x_pred, P_pred, next.dt);
+            P_pred += step.q_scale * Q;
+            
+            // A P_f (P_f A^T is its transpose)
+            Covariance AP = step.P;
+            AP.topRows<2>() += next.dt * step.P.bottomRows<2>();
+            
+            // C^T = P_p^-1 A P_f (P_p is symmetric positive definite)
+            Covariance C = P_pred.llt().solve(AP).transpose();
+            
+            if (!sameFrame(step.frame, next.frame)) {
+                x_next = toFrame(x_next, next.frame, step.frame);
+            }
+            x_next = step.x + C * (x_next - x_pred);
+            P_next = step.P + C * (P_next - P_pred) * C.transpose();
+        }
+        out[k] = toSmoothedFix(x_next, P_next, step.frame, fixes[k].timestamp_ms, step.outcome);
+    }
+}
+
+} // namespace s2sgeo
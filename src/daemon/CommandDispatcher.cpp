@@ -6,6 +6,7 @@
 #include "CommandDispatcher.hpp"
 #include "PluginRegistry.hpp"
 #include "IPCManager.hpp"
+#include "IPCWriter.hpp"
 #include <iostream>
 #include <algorithm>
 #include <cctype>
@@ -19,7 +20,7 @@ static std::string toLower(const std::string& str) {
     return result;
 }
 
-bool CommandDispatcher::processCommand(const std::string& command) {
+bool CommandDispatcher::processCommand(const std::string& command, SharedMemoryManager& mgr) {
     std::string lower_cmd = toLower(command);
     
     std::cout << "[CommandDispatcher] Processing command: " << lower_cmd << std::endl;
@@ -38,13 +39,13 @@ bool CommandDispatcher::processCommand(const std::string& command) {
     else if (lower_cmd.find("running") != std::string::npos ||
              lower_cmd.find("walking") != std::string::npos) {
         // Footbased activities - use high accuracy level
-        setAccuracyLevel(1.0);
+        setAccuracyLevel(1.0, mgr);
         return PluginRegistry::getInstance().activateProvider("cycling");  // Reuse cycling for now
     }
     else if (lower_cmd.find("driving") != std::string::npos ||
              lower_cmd.find("car") != std::string::npos) {
         // Car-based - use lower accuracy level
-        setAccuracyLevel(0.5);
+        setAccuracyLevel(0.5, mgr);
         return PluginRegistry::getInstance().activateProvider("cycling");
     }
     else {
@@ -53,6 +54,25 @@ bool CommandDispatcher::processCommand(const std::string& command) {
     }
 }
 
+bool CommandDispatcher::execute(const CommandRecord& command, SharedMemoryManager& mgr) {
+    switch (command.type) {
+        case CommandType::ActivateProvider:
+            std::cout << "[CommandDispatcher] Activate provider: " << command.argument << std::endl;
+            if (!PluginRegistry::getInstance().activateProvider(command.argument)) {
+                return false;
+            }
+            IPCWriter::setActivePlugin(command.argument, mgr);
+            return true;
+        
+        case CommandType::SetAccuracy:
+            setAccuracyLevel(command.value, mgr);
+            return true;
+        
+        default:
+            return false;
+    }
+}
+
 std::string CommandDispatcher::getActivePlugin() {
     auto provider = PluginRegistry::getInstance().getActiveProvider();
     if (provider) {
@@ -61,11 +81,10 @@ std::string CommandDispatcher::getActivePlugin() {
     return "";
 }
 
-void CommandDispatcher::setAccuracyLevel(double level) {
+void CommandDispatcher::setAccuracyLevel(double level, SharedMemoryManager& mgr) {
     // Clamp to [0.0, 1.0]
     level = std::max(0.0, std::min(1.0, level));
     
-    auto& mgr = SharedMemoryManager::getInstance();
     if (mgr.isReady()) {
         auto* header = mgr.getHeader();
         if (header) {
@@ -4,18 +4,34 @@
  */
 
 #include "LocationService.hpp"
+#include "CommandDispatcher.hpp"
+#include "IPCCommandRing.hpp"
+#include "IPCReader.hpp"
+#include "IPCStats.hpp"
 #include "IPCWriter.hpp"
 #include "PluginRegistry.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <chrono>
 #include <thread>
 
 namespace s2sgeo {
 
+static int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t systemNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
 LocationService::LocationService()
-    : kalman_filter_(std::make_unique<KalmanFilter>()),
-      geometry_index_(std::make_unique<S2GeometryIndex>()) {
-    kalman_filter_->enablePDR(true);
+    : geometry_index_(std::make_unique<S2GeometryIndex>()) {
+    createTrack("", SharedMemoryManager::getInstance());
 }
 
 LocationService::~LocationService() {
@@ -31,6 +47,7 @@ void LocationService::start() {
 
 void LocationService::stop() {
     running_ = false;
+    requestWake();
     if (service_thread_.joinable()) {
         service_thread_.join();
     }
@@ -38,68 +55,444 @@ void LocationService::stop() {
 }
 
 void LocationService::setContextProvider(IContextProvider* provider) {
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
     context_provider_ = provider;
+    for (auto& [tenant, track] : tracks_) {
+        IPCWriter::setActivePlugin(provider ? provider->getName() : "", *track.shm);
+    }
     std::cout << "[LocationService] Set context provider: " 
               << (provider ? provider->getName() : "null") << std::endl;
 }
 
 void LocationService::injectLocation(double lat, double lon, double alt, int64_t timestamp) {
+    injectLocation("", lat, lon, alt, timestamp);
+}
+
+void LocationService::injectLocation(const std::string& tenant, double lat, double lon,
+                                     double alt, int64_t timestamp) {
     LocationFix fix(lat, lon, timestamp);
     fix.altitude = alt;
-    kalman_filter_->update(fix);
+    injectFix(tenant, fix);
+}
+
+void LocationService::injectFix(const std::string& tenant, const LocationFix& fix) {
+    if (!addTrack(tenant)) return;
+    
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
+    auto it = tracks_.find(tenant);
+    if (it == tracks_.end()) return;
+    
+    Track& track = it->second;
+    int64_t timestamp = fix.timestamp_ms;
+    if (!std::isfinite(fix.latitude) || !std::isfinite(fix.longitude) || timestamp < track.last_fix_ms) {
+        IPCStats::increment(StatCounter::DroppedFixes, 1, *track.shm);
+        return;
+    }
+    
+    int64_t now_ms = systemNowMs();
+    if (now_ms >= timestamp) {
+        IPCStats::recordLatency(LatencyMetric::SensorToFilter,
+                                static_cast<uint64_t>(now_ms - timestamp) * 1000000, *track.shm);
+    }
+    
+    flushImu(track);
+    track.kalman_filter->update(fix);
+    bool woke = false;
+    switch (track.kalman_filter->lastOutcome()) {
+        case FixOutcome::Gated:
+            IPCStats::increment(StatCounter::GatedFixes, 1, *track.shm);
+            woke = track.motion.markMoving(timestamp);
+            break;
+        case FixOutcome::Reinitialized:
+            IPCStats::increment(StatCounter::FilterRestarts, 1, *track.shm);
+            woke = track.motion.markMoving(timestamp);
+            break;
+        default:
+            break;
+    }
+    
+    // Doppler speed when the receiver has it; the filter's speed otherwise
+    WorldState filtered = track.kalman_filter->getSmoothedState();
+    double speed = (fix.measured & LocationFix::HAS_SPEED)
+        ? fix.speed : std::hypot(filtered.velocity_east_mps, filtered.velocity_north_mps);
+    woke = track.motion.addSpeed(speed, timestamp) || woke;
+    if (track.motion.stationary(timestamp)) {
+        track.kalman_filter->correctZeroVelocity();
+    }
+    
+    track.last_fix_ms = timestamp;
+    track.filtered_at_ns = steadyNowNs();
+    if (woke) {
+        requestWake();
+    }
+}
+
+void LocationService::injectImu(const std::string& tenant, std::span<const ImuSample> samples) {
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
+    auto it = tracks_.find(tenant);
+    if (it == tracks_.end()) return;
+    
+    Track& track = it->second;
+    if (samples.empty()) return;
+    
+    // Another clock (e.g. sensor uptime) would throw the filter's clock decades off
+    int64_t first_ms = samples.front().timestamp_us / 1000;
+    int64_t last_ms = samples.back().timestamp_us / 1000;
+    if (track.last_fix_ms != 0 && (first_ms < track.last_fix_ms - MAX_IMU_CLOCK_SKEW_MS ||
+                                   last_ms > track.last_fix_ms + MAX_IMU_CLOCK_SKEW_MS)) {
+        if (!track.imu_clock_skewed) {
+            std::cerr << "[LocationService] Tenant '" << tenant << "': IMU batch ending at " << last_ms
+                      << " ms is not on the fixes' clock (last fix " << track.last_fix_ms
+                      << " ms); dropping IMU data" << std::endl;
+            track.imu_clock_skewed = true;
+        }
+        return;
+    }
+    track.imu_clock_skewed = false;
+    
+    bool woke = false;
+    for (const ImuSample& sample : samples) {
+        track.imu.add(sample);
+        woke = track.motion.addImu(sample) || woke;
+    }
+    step_events_.clear();
+    track.kalman_filter->addSteps(static_cast<uint32_t>(track.steps.process(samples, step_events_)));
+    if (woke) {
+        requestWake();
+    }
+}
+
+void LocationService::requestWake() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_requested_ = true;
+    }
+    wake_cv_.notify_one();
+}
+
+void LocationService::flushImu(Track& track) {
+    if (track.imu.empty()) return;
+    
+    ImuDelta delta = track.imu.take();
+    if (track.idle) return;  // At rest the batch is sensor noise: drop it rather than drift on it
+    track.kalman_filter->predictImu(delta);
+    track.filtered_at_ns = steadyNowNs();
+}
+
+bool LocationService::addTrack(const std::string& tenant, const SharedMemoryOptions& options) {
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
+    if (tracks_.count(tenant)) return true;
+    
+    auto& shm = SharedMemoryManager::getInstance(tenant);
+    if (!shm.initializeServer(options)) {
+        std::cerr << "[LocationService] Cannot create segment for tenant " << tenant << std::endl;
+        return false;
+    }
+    createTrack(tenant, shm);
+    if (context_provider_) {
+        IPCWriter::setActivePlugin(context_provider_->getName(), shm);
+    }
+    std::cout << "[LocationService] Tracking tenant " << tenant
+              << " (" << tracks_.size() << " tracks)" << std::endl;
+    return true;
+}
+
+bool LocationService::removeTrack(const std::string& tenant) {
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
+    auto it = tracks_.find(tenant);
+    if (it == tracks_.end()) return false;
+    
+    it->second.shm->cleanup();
+    tracks_.erase(it);
+    return true;
+}
+
+std::vector<uint8_t> LocationService::checkpointTrack(const std::string& tenant) const {
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
+    auto it = tracks_.find(tenant);
+    if (it == tracks_.end()) return {};
+    return it->second.kalman_filter->checkpoint();
+}
+
+bool LocationService::restoreTrack(const std::string& tenant, std::span<const uint8_t> checkpoint) {
+    if (!addTrack(tenant)) return false;
+    
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
+    auto it = tracks_.find(tenant);
+    if (it == tracks_.end()) return false;
+    
+    Track& track = it->second;
+    if (!track.kalman_filter->restore(checkpoint)) {
+        std::cerr << "[LocationService] Rejected filter checkpoint for tenant '" << tenant
+                  << "' (" << checkpoint.size() << " bytes)" << std::endl;
+        return false;
+    }
+    
+    // Fixes older than the checkpoint's newest are stale now; motion evidence starts over
+    track.last_fix_ms = track.kalman_filter->getSmoothedState().last_update_ms;
+    track.imu.reset();
+    track.motion.reset();
+    track.steps.reset();
+    track.idle = false;
+    track.filtered_at_ns = steadyNowNs();
+    std::cout << "[LocationService] Restored filter checkpoint for tenant '" << tenant << "'" << std::endl;
+    return true;
+}
+
+size_t LocationService::trackCount() const {
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
+    return tracks_.size();
+}
+
+LocationService::Track& LocationService::createTrack(const std::string& tenant,
+                                                     SharedMemoryManager& shm) {
+    Track& track = tracks_[tenant];
+    track.shm = &shm;
+    track.kalman_filter = std::make_unique<KalmanFilter>();
+    track.kalman_filter->enablePDR(true);
+    if (shm.wasResumed()) {
+        resumeTrack(tenant, track);
+    }
+    return track;
+}
+
+void LocationService::resumeTrack(const std::string& tenant, Track& track) {
+    FilterSnapshot snapshot;
+    bool restored = IPCWriter::loadFilterSnapshot(snapshot, *track.shm);
+    if (restored) {
+        track.kalman_filter->restore(snapshot);
+    }
+    
+    // The context in the slab already matches the last cell: don't refetch it
+    PositionData position;
+    if (IPCReader::readLatestPosition(position, nullptr, *track.shm)) {
+        track.last_s2_cell = position.s2_cell_id;
+        track.s2_level = position.s2_cell_level;
+    }
+    std::cout << "[LocationService] Resumed tenant '" << tenant << "' at cell " << std::hex
+              << track.last_s2_cell << std::dec << " (filter "
+              << (restored ? "restored" : "cold") << ")" << std::endl;
+}
+
+void LocationService::updateTrack(Track& track, WorldState& state) {
+    // 1. Get smoothed state from Kalman filter, advanced by any queued IMU samples
+    flushImu(track);
+    state = track.kalman_filter->getSmoothedState();
+    
+    // 2. Detect S2 cell
+    uint64_t current_s2 = geometry_index_->latLonToCell(
+        state.smoothed_lat, state.smoothed_lon, track.s2_level
+    );
+    state.s2_cell_id = current_s2;
+    state.s2_cell_level = track.s2_level;
+    
+    // 3. Check if we crossed a boundary (context is only republished then)
+    if (current_s2 != track.last_s2_cell && context_provider_) {
+        track.last_s2_cell = current_s2;
+        int64_t fetch_start_ns = steadyNowNs();
+        ContextFrame context = context_provider_->getContext(
+            state.smoothed_lat, state.smoothed_lon
+        );
+        IPCStats::recordLatency(LatencyMetric::ProviderFetch,
+                                steadyNowNs() - fetch_start_ns, *track.shm);
+        IPCStats::increment(StatCounter::CellCrossings, 1, *track.shm);
+        IPCWriter::publishContext(context, {}, *track.shm);
+        std::cout << "[LocationService] Cell boundary crossed: " << std::hex 
+                  << current_s2 << std::dec << std::endl;
+    }
+    
+    // 4. Write to shared memory (one position record per update)
+    IPCWriter::writePosition(state, *track.shm);
+    IPCWriter::saveFilterSnapshot(track.kalman_filter->snapshot(), *track.shm);
+    IPCWriter::signalAlive(*track.shm);
+    if (track.filtered_at_ns != 0) {
+        IPCStats::recordLatency(LatencyMetric::FilterToPublish,
+                                steadyNowNs() - track.filtered_at_ns, *track.shm);
+        track.filtered_at_ns = 0;
+    }
+}
+
+void LocationService::publishHeartbeat(Track& track, WorldState& state) {
+    flushImu(track);
+    state = track.kalman_filter->getSmoothedState();
+    
+    // The held position, timestamped now: a position record, no S2 lookup or snapshot
+    IPCWriter::updateLocation(state.smoothed_lat, state.smoothed_lon, state.smoothed_altitude,
+                              systemNowMs(), *track.shm);
+    IPCWriter::signalAlive(*track.shm);
+    IPCStats::increment(StatCounter::IdleHeartbeats, 1, *track.shm);
+    track.filtered_at_ns = 0;
+}
+
+void LocationService::processCommands(const std::string& tenant, Track& track) {
+    CommandRecord command;
+    while (IPCCommandRing::pop(command, *track.shm)) {
+        switch (command.type) {
+            case CommandType::SetS2Level:
+                if (command.int_value < 0 || command.int_value > 30) {
+                    std::cerr << "[LocationService] Ignoring invalid S2 level "
+                              << command.int_value << std::endl;
+                    break;
+                }
+                track.s2_level = command.int_value;
+                track.last_s2_cell = 0;  // Cell ids change with the level
+                std::cout << "[LocationService] Tenant '" << tenant << "' S2 level set to "
+                          << track.s2_level << std::endl;
+                break;
+            
+            case CommandType::ForceRefresh:
+                track.last_s2_cell = 0;
+                break;
+            
+            case CommandType::ActivateProvider:
+                if (CommandDispatcher::execute(command, *track.shm)) {
+                    // The registry is daemon-wide: switch every track over
+                    context_provider_ = PluginRegistry::getInstance().getActiveProvider();
+                    for (auto& [other_tenant, other] : tracks_) {
+                        IPCWriter::setActivePlugin(command.argument, *other.shm);
+                        other.last_s2_cell = 0;
+                    }
+                }
+                break;
+            
+            default:
+                if (!CommandDispatcher::execute(command, *track.shm)) {
+                    std::cerr << "[LocationService] Unhandled command type "
+                              << static_cast<uint32_t>(command.type) << std::endl;
+                }
+                break;
+        }
+    }
+}
+
+void LocationService::checkConsumers(const std::string& tenant, Track& track) {
+    ConsumerLagReport report = IPCWriter::publishConsumerLag(*track.shm);
+    uint32_t capacity = track.shm->getRingCapacity();
+    
+    // Warn at half a ring: one more stall of that length and the consumer drops entries
+    if (report.max_lag > capacity / 2) {
+        std::cerr << "[LocationService] Consumer '" << report.slowest_consumer << "' on tenant '"
+                  << tenant << "' is " << report.max_lag << " entries behind (ring holds "
+                  << capacity << ")" << std::endl;
+    }
+    if (report.total_overruns > track.reported_overruns) {
+        std::cerr << "[LocationService] Consumers on tenant '" << tenant << "' lost "
+                  << (report.total_overruns - track.reported_overruns)
+                  << " entries to ring overruns" << std::endl;
+    }
+    track.reported_overruns = report.total_overruns;
+    if (report.reclaimed_slots > 0) {
+        std::cout << "[LocationService] Reclaimed " << report.reclaimed_slots
+                  << " consumer slot(s) of exited processes" << std::endl;
+    }
 }
 
 void LocationService::runServiceLoop() {
     std::cout << "[LocationService] Service loop started" << std::endl;
     
     int iteration = 0;
+    int64_t due_ns = 0;  // When this tick was due; 0 on the first tick and after a wake
     while (running_) {
         try {
-            // 1. Get smoothed state from Kalman filter
-            WorldState state = kalman_filter_->getSmoothedState();
-            
-            // 2. Detect S2 cell
-            uint64_t current_s2 = geometry_index_->latLonToCell(
-                state.smoothed_lat, state.smoothed_lon, 16
-            );
-            state.s2_cell_id = current_s2;
-            state.s2_cell_level = 16;
+            // Jitter: how far this tick landed from the end of the previous sleep
+            int64_t tick_ns = steadyNowNs();
+            uint64_t jitter_ns = due_ns == 0 ? 0 : static_cast<uint64_t>(std::llabs(tick_ns - due_ns));
+            int64_t now_ms = systemNowMs();
             
-            // 3. Check if we crossed a boundary
-            ContextFrame context{};
-            if (current_s2 != last_s2_cell_ && context_provider_) {
-                last_s2_cell_ = current_s2;
-                context = context_provider_->getContext(
-                    state.smoothed_lat, state.smoothed_lon
-                );
-                std::cout << "[LocationService] Cell boundary crossed: " << std::hex 
-                          << current_s2 << std::dec << std::endl;
+            WorldState state{};
+            size_t track_count = 0;
+            bool all_idle = true;
+            {
+                std::lock_guard<std::mutex> lock(tracks_mutex_);
+                for (auto& [tenant, track] : tracks_) {
+                    IPCStats::increment(StatCounter::LoopIterations, 1, *track.shm);
+                    if (due_ns != 0) {
+                        IPCStats::recordLatency(LatencyMetric::LoopJitter, jitter_ns, *track.shm);
+                    }
+                    try {
+                        processCommands(tenant, track);
+                        
+                        bool idle = track.motion.stationary(now_ms);
+                        if (idle != track.idle) {
+                            track.idle = idle;
+                            track.heartbeat_ns = tick_ns;
+                            if (idle) {
+                                IPCStats::increment(StatCounter::StationaryPeriods, 1, *track.shm);
+                            }
+                            std::cout << "[LocationService] Tenant '" << tenant << "' "
+                                      << (idle ? "stationary, heartbeats only" : "moving") << std::endl;
+                        }
+                        // last_s2_cell == 0: a command asked for the context to be republished
+                        if (!idle || (track.last_s2_cell == 0 && context_provider_)) {
+                            updateTrack(track, state);
+                        } else if (tick_ns - track.heartbeat_ns >= std::chrono::nanoseconds(IDLE_HEARTBEAT_PERIOD).count()) {
+                            publishHeartbeat(track, state);
+                            track.heartbeat_ns = tick_ns;
+                        }
+                        all_idle = all_idle && idle;
+                        if (iteration % 10 == 0) {
+                            checkConsumers(tenant, track);
+                        }
+                    } catch (const std::exception& e) {
+                        std::cerr << "[LocationService] Error on tenant " << tenant
+                                  << ": " << e.what() << std::endl;
+                    }
+                }
+                track_count = tracks_.size();
             }
             
-            // 4. Write to shared memory
-            IPCWriter::writeState(state, context);
-            IPCWriter::signalAlive();
-            
             // 5. Log every 10 iterations
             if (iteration % 10 == 0) {
-                std::cout << "[LocationService] Iteration " << iteration 
-                          << " - Lat: " << state.smoothed_lat 
-                          << " Lon: " << state.smoothed_lon << std::endl;
+                if (track_count == 1) {
+                    std::cout << "[LocationService] Iteration " << iteration 
+                              << " - Lat: " << state.smoothed_lat 
+                              << " Lon: " << state.smoothed_lon << std::endl;
+                } else {
+                    std::cout << "[LocationService] Iteration " << iteration
+                              << " - " << track_count << " tracks" << std::endl;
+                }
             }
             
             iteration++;
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
             
+            // Every track at rest: sleep a heartbeat period unless one starts moving,
+            // checking the command rings (in another process: no wakeup) every LOOP_PERIOD
+            std::chrono::milliseconds period = all_idle && track_count > 0 ? IDLE_HEARTBEAT_PERIOD : LOOP_PERIOD;
+            int64_t sleep_until_ns = tick_ns + std::chrono::nanoseconds(period).count();
+            bool woken = false;
+            while (!woken && running_) {
+                int64_t remaining_ns = sleep_until_ns - steadyNowNs();
+                if (remaining_ns <= 0) break;
+                {
+                    std::unique_lock<std::mutex> wake_lock(wake_mutex_);
+                    woken = wake_cv_.wait_for(wake_lock, std::min(std::chrono::nanoseconds(remaining_ns),
+                                                                  std::chrono::nanoseconds(LOOP_PERIOD)),
+                                              [this] { return wake_requested_ || !running_; });
+                    wake_requested_ = false;
+                }
+                // tracks_mutex_ is taken before wake_mutex_ elsewhere: check with wake_mutex_ released
+                woken = woken || (period != LOOP_PERIOD && commandsPending());
+            }
+            due_ns = woken ? 0 : sleep_until_ns;
+        
         } catch (const std::exception& e) {
             std::cerr << "[LocationService] Error in loop: " << e.what() << std::endl;
         }
     }
 }
 
+bool LocationService::commandsPending() const {
+    std::lock_guard<std::mutex> lock(tracks_mutex_);
+    for (const auto& [tenant, track] : tracks_) {
+        if (IPCCommandRing::pending(*track.shm)) return true;
+    }
+    return false;
+}
+
 LocationFix LocationService::pollSensors() {
     // Mock implementation - would call actual GPS/IMU in production
     LocationFix fix;
-    fix.latitude = 37.7749 + (iteration % 100) * 0.0001;
+    fix.latitude = 37.7749 + (poll_count_++ % 100) * 0.0001;
     fix.longitude = -122.4194;
     fix.altitude = 100.0;
     fix.timestamp_ms = std::chrono::system_clock::now().time_since_epoch().count();
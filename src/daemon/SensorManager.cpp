@@ -25,6 +25,9 @@ LocationFix SensorManager::pollGPS() {
     fix.accuracy = 10.0;
     fix.speed = 5.0;
     fix.heading = 90.0;
+    fix.speed_accuracy = 0.5;
+    fix.heading_accuracy = 10.0;
+    fix.measured = LocationFix::HAS_SPEED | LocationFix::HAS_HEADING;
     
     return fix;
 }
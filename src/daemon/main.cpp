@@ -9,8 +9,12 @@
 #include "CyclingContextProvider.hpp"
 #include "DatingContextProvider.hpp"
 #include "IPCManager.hpp"
+#include "IPCReader.hpp"
+#include <cstdlib>
 #include <iostream>
+#include <string>
 #include <thread>
+#include <vector>
 #include <chrono>
 
 int main(int argc, char* argv[]) {
@@ -18,9 +22,31 @@ int main(int argc, char* argv[]) {
     std::cout << "S2S Geospatial Adapter - Daemon" << std::endl;
     std::cout << "================================" << std::endl;
     
+    // Segment options: --ring-capacity N, --shm-file PATH, --thp, --lock-pages,
+    // --resume (continue from the segments a previous daemon left behind)
+    // Extra tracked devices: --tenant NAME (repeatable, one segment each)
+    s2sgeo::SharedMemoryOptions shm_options;
+    std::vector<std::string> tenants;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--ring-capacity" && i + 1 < argc) {
+            shm_options.ring_capacity = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--shm-file" && i + 1 < argc) {
+            shm_options.backing_file = argv[++i];
+        } else if (arg == "--thp") {
+            shm_options.transparent_huge_pages = true;
+        } else if (arg == "--lock-pages") {
+            shm_options.lock_pages = true;
+        } else if (arg == "--resume") {
+            shm_options.resume = true;
+        } else if (arg == "--tenant" && i + 1 < argc) {
+            tenants.push_back(argv[++i]);
+        }
+    }
+    
     // Initialize shared memory
     auto& shm_mgr = s2sgeo::SharedMemoryManager::getInstance();
-    if (!shm_mgr.initializeServer()) {
+    if (!shm_mgr.initializeServer(shm_options)) {
         std::cerr << "Failed to initialize shared memory" << std::endl;
         return 1;
     }
@@ -37,11 +63,23 @@ int main(int argc, char* argv[]) {
     // Start location service
     auto location_service = std::make_unique<s2sgeo::LocationService>();
     
-    // Activate cycling by default
-    if (registry.activateProvider("cycling")) {
+    // Activate the provider a resumed segment was using, cycling otherwise
+    std::string provider = "cycling";
+    if (shm_mgr.wasResumed()) {
+        std::string previous = s2sgeo::IPCReader::getActivePlugin(shm_mgr);
+        if (!previous.empty()) provider = previous;
+    }
+    if (registry.activateProvider(provider)) {
         location_service->setContextProvider(registry.getActiveProvider());
     }
     
+    // Tenant segments share the page policy but never a backing file
+    s2sgeo::SharedMemoryOptions tenant_options = shm_options;
+    tenant_options.backing_file.clear();
+    for (const auto& tenant : tenants) {
+        location_service->addTrack(tenant, tenant_options);
+    }
+    
     location_service->start();
     
     // Simulate some location updates
@@ -52,6 +90,9 @@ int main(int argc, char* argv[]) {
         int64_t timestamp_ms = std::chrono::system_clock::now().time_since_epoch().count() / 1000000;
         
         location_service->injectLocation(lat, lon, 50.0 + i * 0.5, timestamp_ms);
+        for (const auto& tenant : tenants) {
+            location_service->injectLocation(tenant, lat, lon, 50.0 + i * 0.5, timestamp_ms);
+        }
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
@@ -0,0 +1,105 @@
+/**
+ * @file main.cpp (Stat)
+ * @brief s2sgeo_stat: print the daemon's shared memory instrumentation
+ */
+
+#include "IPCManager.hpp"
+#include "IPCStats.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+
+/**
+ * @brief Print one report
+ * @return total_updates at the time of the report, for the next rate
+ */
+static uint64_t printStats(s2sgeo::SharedMemoryManager& shm_mgr, uint64_t previous_updates,
+                           double interval_s) {
+    using namespace s2sgeo;
+    
+    StatsSnapshot stats;
+    if (!IPCStats::snapshot(stats, shm_mgr)) return previous_updates;
+    
+    const SharedMemoryHeader* header = shm_mgr.getHeader();
+    uint64_t updates = header->total_updates.load(std::memory_order_relaxed);
+    
+    std::printf("%-18s %10s %10s %10s %10s %10s %10s\n",
+                "latency (us)", "count", "mean", "p50", "p90", "p99", "max");
+    for (size_t m = 0; m < StatsBlock::NUM_HISTOGRAMS; ++m) {
+        const HistogramSnapshot& h = stats.histograms[m];
+        std::printf("%-18s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                    IPCStats::metricName(static_cast<LatencyMetric>(m)),
+                    static_cast<unsigned long long>(h.count), h.meanNs() / 1e3,
+                    h.percentileNs(0.50) / 1e3, h.percentileNs(0.90) / 1e3,
+                    h.percentileNs(0.99) / 1e3, h.max_ns / 1e3);
+    }
+    
+    for (size_t c = 0; c < static_cast<size_t>(StatCounter::Count); ++c) {
+        std::printf("%-18s %10llu\n", IPCStats::counterName(static_cast<StatCounter>(c)),
+                    static_cast<unsigned long long>(stats.counters[c]));
+    }
+    
+    std::printf("%-18s %10llu (%.1f/s)\n", "updates",
+                static_cast<unsigned long long>(updates),
+                interval_s > 0 ? (updates - previous_updates) / interval_s : 0.0);
+    std::printf("%-18s %10llu\n", "context_updates",
+                static_cast<unsigned long long>(
+                    header->total_context_updates.load(std::memory_order_relaxed)));
+    std::printf("%-18s %10llu\n", "read_retries",
+                static_cast<unsigned long long>(header->read_retries.load(std::memory_order_relaxed)));
+    std::printf("%-18s %10llu\n", "failed_reads",
+                static_cast<unsigned long long>(header->failed_reads.load(std::memory_order_relaxed)));
+    std::printf("%-18s %10u (max lag %llu)\n", "consumers",
+                header->active_consumers.load(std::memory_order_relaxed),
+                static_cast<unsigned long long>(
+                    header->max_consumer_lag.load(std::memory_order_relaxed)));
+    std::printf("%-18s %10s\n\n", "daemon",
+                header->location_service_alive.load(std::memory_order_relaxed) ? "alive" : "down");
+    std::fflush(stdout);
+    return updates;
+}
+
+int main(int argc, char* argv[]) {
+    // --tenant NAME and --shm-file PATH select the segment like the adapter;
+    // --interval MS sets the refresh period, --once prints a single report
+    s2sgeo::SharedMemoryOptions shm_options;
+    shm_options.read_only = true;
+    shm_options.prefault = false;
+    std::string tenant;
+    int interval_ms = 1000;
+    bool once = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--shm-file" && i + 1 < argc) {
+            shm_options.backing_file = argv[++i];
+        } else if (arg == "--tenant" && i + 1 < argc) {
+            tenant = argv[++i];
+        } else if (arg == "--interval" && i + 1 < argc) {
+            interval_ms = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--once") {
+            once = true;
+        }
+    }
+    
+    auto& shm_mgr = s2sgeo::SharedMemoryManager::getInstance(tenant);
+    if (!shm_mgr.connectClient(shm_options)) {
+        std::cerr << "Failed to attach to " << shm_mgr.segmentName() << std::endl;
+        return 1;
+    }
+    
+    uint64_t previous_updates = shm_mgr.getHeader()->total_updates.load(std::memory_order_relaxed);
+    if (once) {
+        printStats(shm_mgr, previous_updates, 0.0);
+        return 0;
+    }
+    
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        previous_updates = printStats(shm_mgr, previous_updates, interval_ms / 1000.0);
+    }
+}
@@ -3,12 +3,19 @@
  * @brief Unit tests for IPC layer
  */
 
+#include "IPCCommandRing.hpp"
 #include "IPCManager.hpp"
 #include "IPCWriter.hpp"
 #include "IPCReader.hpp"
+#include "IPCStats.hpp"
 #include "gtest/gtest.h"
 #include <thread>
 #include <chrono>
+#include <cstring>
+#include <tuple>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace s2sgeo;
 
@@ -46,14 +53,14 @@ TEST_F(IPCTest, WriteReadTest) {
     mgr.initializeServer();
     
     // Write state
-    WorldState write_state;
+    WorldState write_state{};
     write_state.smoothed_lat = 37.7749;
     write_state.smoothed_lon = -122.4194;
     write_state.smoothed_altitude = 50.0;
     write_state.is_moving = true;
     write_state.step_count = 42;
     
-    ContextFrame context;
+    ContextFrame context{};
     strcpy(context.road_name, "Main St");
     
     IPCWriter::writeState(write_state, context);
@@ -70,8 +77,14 @@ TEST_F(IPCTest, WriteReadTest) {
     EXPECT_NE(buffer, nullptr);
     
     // Basic ring buffer sanity check
-    EXPECT_EQ(buffer[0].state.smoothed_lat, 37.7749);
-    EXPECT_EQ(buffer[0].state.smoothed_lon, -122.4194);
+    EXPECT_EQ(buffer[0].data.latitude, 37.7749);
+    EXPECT_EQ(buffer[0].data.longitude, -122.4194);
+    
+    // Full reconstruction joins the position record with its context
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context));
+    EXPECT_EQ(read_state.smoothed_lat, 37.7749);
+    EXPECT_EQ(read_state.step_count, 42u);
+    EXPECT_STREQ(read_context.road_name, "Main St");
 }
 
 TEST_F(IPCTest, AliveSignalTest) {
@@ -98,6 +111,1200 @@ TEST_F(IPCTest, HeaderMetadataTest) {
     EXPECT_STREQ(header->active_plugin, "cycling");
 }
 
+TEST_F(IPCTest, ReadBeforeFirstWriteTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    mgr.initializeServer();
+    
+    WorldState state;
+    ContextFrame context;
+    EXPECT_FALSE(IPCReader::readLatestState(state, context));
+}
+
+// Every field of a stress-test entry is derived from one counter, so a torn
+// read shows up as a mismatch between fields of the same copy.
+static void fillStressEntry(uint32_t k, WorldState& state, ContextFrame& context) {
+    state.update_sequence = k;
+    state.smoothed_lat = static_cast<double>(k);
+    state.smoothed_lon = -static_cast<double>(k);
+    state.step_count = k;
+    std::memset(state.context_json, 'a' + (k % 26), sizeof(state.context_json) - 1);
+    state.context_json[sizeof(state.context_json) - 1] = '\0';
+    
+    context.timestamp_ms = k;
+    std::memset(context.hazards, 'A' + (k % 26), sizeof(context.hazards) - 1);
+    context.hazards[sizeof(context.hazards) - 1] = '\0';
+}
+
+static bool isConsistentStressEntry(const WorldState& state, const ContextFrame& context) {
+    uint32_t k = state.update_sequence;
+    return state.smoothed_lat == static_cast<double>(k) &&
+           state.smoothed_lon == -static_cast<double>(k) &&
+           state.step_count == k &&
+           context.timestamp_ms == k &&
+           state.context_json[0] == 'a' + static_cast<char>(k % 26) &&
+           state.context_json[sizeof(state.context_json) - 2] == state.context_json[0] &&
+           context.hazards[0] == 'A' + static_cast<char>(k % 26) &&
+           context.hazards[sizeof(context.hazards) - 2] == context.hazards[0];
+}
+
+// Stress entries are written once per k, so ring sequence k holds entry k
+static bool isConsistentStressPosition(const IPCUpdate& update) {
+    double k = static_cast<double>(update.sequence);
+    return update.position.latitude == k &&
+           update.position.longitude == -k &&
+           update.position.step_count == update.sequence &&
+           update.position.context_id == update.sequence;
+}
+
+TEST_F(IPCTest, SeqlockStressAcrossProcessesTest) {
+    constexpr int NUM_READERS = 4;
+    constexpr int READS_PER_READER = 20000;
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    WorldState state{};
+    ContextFrame context{};
+    uint32_t k = 1;
+    fillStressEntry(k, state, context);
+    IPCWriter::writeState(state, context);
+    
+    std::vector<pid_t> readers;
+    for (int i = 0; i < NUM_READERS; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            // Child: attach as a client and count torn reads
+            int torn = 0;
+            if (!SharedMemoryManager::getInstance().connectClient()) _exit(2);
+            for (int n = 0; n < READS_PER_READER; ++n) {
+                WorldState rs;
+                ContextFrame rc;
+                if (IPCReader::readLatestState(rs, rc) && !isConsistentStressEntry(rs, rc)) {
+                    ++torn;
+                }
+            }
+            _exit(torn == 0 ? 0 : 1);
+        }
+        readers.push_back(pid);
+    }
+    
+    // Parent: hammer the ring until every reader has finished
+    size_t running = readers.size();
+    std::vector<int> statuses(readers.size(), -1);
+    while (running > 0) {
+        fillStressEntry(++k, state, context);
+        IPCWriter::writeState(state, context);
+        
+        for (size_t i = 0; i < readers.size(); ++i) {
+            if (statuses[i] != -1) continue;
+            int status = 0;
+            if (waitpid(readers[i], &status, WNOHANG) == readers[i]) {
+                statuses[i] = status;
+                --running;
+            }
+        }
+    }
+    
+    for (int status : statuses) {
+        ASSERT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+    
+    auto* header = mgr.getHeader();
+    EXPECT_EQ(header->total_updates.load(), k);
+    std::cout << "[SeqlockStress] writes=" << k
+              << " retries=" << header->read_retries.load()
+              << " failed=" << header->failed_reads.load() << std::endl;
+}
+
+TEST_F(IPCTest, DrainSinceCursorTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    WorldState state{};
+    ContextFrame context{};
+    for (uint32_t k = 1; k <= 10; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    
+    std::vector<IPCUpdate> batch(16);
+    IPCCursor cursor;
+    DrainResult result = cursor.drain(batch);
+    
+    ASSERT_EQ(result.count, 10u);
+    EXPECT_EQ(result.lapped, 0u);
+    EXPECT_EQ(result.last_sequence, 10u);
+    for (size_t i = 0; i < result.count; ++i) {
+        EXPECT_EQ(batch[i].sequence, i + 1);
+        EXPECT_TRUE(isConsistentStressPosition(batch[i]));
+    }
+    
+    // Nothing new: empty drain, cursor unchanged
+    result = cursor.drain(batch);
+    EXPECT_EQ(result.count, 0u);
+    EXPECT_EQ(cursor.position(), 10u);
+    
+    // Output span smaller than the backlog: drains in several calls
+    for (uint32_t k = 11; k <= 15; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    result = cursor.drain(std::span<IPCUpdate>(batch).first(3));
+    EXPECT_EQ(result.count, 3u);
+    EXPECT_EQ(cursor.position(), 13u);
+    result = cursor.drain(batch);
+    EXPECT_EQ(result.count, 2u);
+    EXPECT_EQ(cursor.position(), 15u);
+}
+
+TEST_F(IPCTest, DrainReportsLappedEntriesTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    constexpr uint32_t OVERRUN = 100;
+    constexpr uint32_t TOTAL = SharedMemoryHeader::RING_BUFFER_SIZE + OVERRUN;
+    
+    WorldState state{};
+    ContextFrame context{};
+    IPCCursor slow_cursor;
+    IPCCursor fast_cursor;
+    std::vector<IPCUpdate> batch(SharedMemoryHeader::RING_BUFFER_SIZE);
+    
+    for (uint32_t k = 1; k <= TOTAL; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+        if (k == OVERRUN) {
+            EXPECT_EQ(fast_cursor.drain(batch).count, OVERRUN);
+        }
+    }
+    
+    // The slow consumer lost the first OVERRUN entries
+    DrainResult slow = slow_cursor.drain(batch);
+    EXPECT_EQ(slow.lapped, OVERRUN);
+    EXPECT_EQ(slow.count, SharedMemoryHeader::RING_BUFFER_SIZE);
+    EXPECT_EQ(batch[0].sequence, OVERRUN + 1);
+    EXPECT_EQ(slow_cursor.position(), TOTAL);
+    
+    // The independent fast consumer kept up and lost nothing
+    DrainResult fast = fast_cursor.drain(batch);
+    EXPECT_EQ(fast.lapped, 0u);
+    EXPECT_EQ(fast.count, SharedMemoryHeader::RING_BUFFER_SIZE);
+    EXPECT_EQ(fast_cursor.position(), TOTAL);
+}
+
+TEST_F(IPCTest, DrainAcrossProcessesTest) {
+    constexpr int NUM_READERS = 4;
+    constexpr uint32_t TOTAL = 200000;
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    std::vector<pid_t> readers;
+    for (int i = 0; i < NUM_READERS; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            // Child: every sequence must be either delivered in order or reported lapped
+            if (!SharedMemoryManager::getInstance().connectClient()) _exit(2);
+            std::vector<IPCUpdate> batch(64);
+            IPCCursor cursor;
+            uint64_t delivered = 0;
+            uint64_t expected_next = 1;
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+            while (cursor.position() < TOTAL) {
+                uint64_t lapped_before = cursor.totalLapped();
+                DrainResult result = cursor.drain(batch);
+                expected_next += cursor.totalLapped() - lapped_before;
+                for (size_t n = 0; n < result.count; ++n) {
+                    if (batch[n].sequence != expected_next ||
+                        !isConsistentStressPosition(batch[n])) {
+                        _exit(1);
+                    }
+                    ++expected_next;
+                }
+                delivered += result.count;
+                if (std::chrono::steady_clock::now() > deadline) _exit(3);
+            }
+            _exit(delivered + cursor.totalLapped() == TOTAL ? 0 : 4);
+        }
+        readers.push_back(pid);
+    }
+    
+    WorldState state{};
+    ContextFrame context{};
+    for (uint32_t k = 1; k <= TOTAL; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    
+    for (pid_t pid : readers) {
+        int status = 0;
+        ASSERT_EQ(waitpid(pid, &status, 0), pid);
+        ASSERT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+}
+
+TEST_F(IPCTest, WaitForUpdateTimesOutTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(IPCReader::waitForUpdate(0, std::chrono::milliseconds(20)));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+    
+    // Already-published entries return immediately
+    WorldState state{};
+    ContextFrame context{};
+    IPCWriter::writeState(state, context);
+    EXPECT_TRUE(IPCReader::waitForUpdate(0, std::chrono::milliseconds(0)));
+    EXPECT_FALSE(IPCReader::waitForUpdate(1, std::chrono::milliseconds(0)));
+}
+
+TEST_F(IPCTest, WaitForUpdateWakesAcrossProcessesTest) {
+    constexpr int ROUNDS = 200;
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        // Child: block for each update, then check it is readable
+        if (!SharedMemoryManager::getInstance().connectClient()) _exit(2);
+        uint64_t seen = 0;
+        for (int n = 0; n < ROUNDS; ++n) {
+            if (!IPCReader::waitForUpdate(seen, std::chrono::seconds(5))) _exit(1);
+            WorldState rs;
+            ContextFrame rc;
+            if (!IPCReader::readLatestState(rs, rc)) _exit(3);
+            seen = IPCReader::latestSequence();
+        }
+        _exit(0);
+    }
+    
+    // Parent: publish slowly enough that the child is asleep for most rounds
+    WorldState state{};
+    ContextFrame context{};
+    for (uint32_t k = 1; k <= ROUNDS; ++k) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(mgr.getHeader()->futex_waiters.load(), 0u);
+}
+
+TEST_F(IPCTest, RingLayoutTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(mgr.getRingBuffer()) % CACHE_LINE_SIZE, 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(mgr.getContextSlab()) % CACHE_LINE_SIZE, 0u);
+    
+    // A client resolves the ring and slab through the header offsets
+    ASSERT_TRUE(mgr.connectClient());
+    EXPECT_NE(mgr.getRingBuffer(), nullptr);
+    EXPECT_NE(mgr.getContextSlab(), nullptr);
+}
+
+TEST_F(IPCTest, ContextDeduplicationTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    WorldState state{};
+    ContextFrame context{};
+    strcpy(context.road_name, "Main St");
+    
+    for (int i = 0; i < 100; ++i) {
+        state.smoothed_lat = 37.0 + i * 0.0001;
+        IPCWriter::writeState(state, context);
+    }
+    
+    auto* header = mgr.getHeader();
+    EXPECT_EQ(header->total_updates.load(), 100u);
+    EXPECT_EQ(header->total_context_updates.load(), 1u);
+    EXPECT_EQ(header->context_id.load(), 1u);
+    
+    // A new context gets a new id; the old one stays readable until recycled
+    strcpy(context.road_name, "Side St");
+    IPCWriter::writeState(state, context);
+    EXPECT_EQ(header->context_id.load(), 2u);
+    
+    ContextPayload payload;
+    ASSERT_TRUE(IPCReader::readContext(1, payload));
+    EXPECT_STREQ(payload.frame.road_name, "Main St");
+    ASSERT_TRUE(IPCReader::readContext(2, payload));
+    EXPECT_STREQ(payload.frame.road_name, "Side St");
+    EXPECT_FALSE(IPCReader::readContext(3, payload));
+    
+    for (uint32_t id = 3; id <= 2 + SharedMemoryHeader::CONTEXT_SLAB_SIZE; ++id) {
+        context.timestamp_ms = id;
+        IPCWriter::publishContext(context);
+    }
+    EXPECT_FALSE(IPCReader::readContext(1, payload));
+}
+
+TEST_F(IPCTest, UpdateLocationCarriesStateForwardTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    WorldState state{};
+    state.smoothed_lat = 37.7749;
+    state.smoothed_lon = -122.4194;
+    state.s2_cell_id = 0x808580bc;
+    state.s2_cell_level = 16;
+    state.step_count = 7;
+    state.velocity_east_mps = 1.25;
+    state.velocity_north_mps = -400.0;  // Saturates at -327.67 m/s
+    ContextFrame context{};
+    strcpy(context.road_name, "Main St");
+    IPCWriter::writeState(state, context);
+    
+    IPCWriter::updateLocation(37.7750, -122.4195, 12.0, 5000);
+    
+    PositionData position;
+    uint64_t sequence = 0;
+    ASSERT_TRUE(IPCReader::readLatestPosition(position, &sequence));
+    EXPECT_EQ(sequence, 2u);
+    EXPECT_EQ(position.record_type, RecordType::Position);
+    EXPECT_EQ(position.latitude, 37.7750);
+    EXPECT_EQ(position.longitude, -122.4195);
+    EXPECT_EQ(position.last_update_ms, 5000);
+    EXPECT_EQ(position.s2_cell_id, 0x808580bcu);
+    EXPECT_EQ(position.step_count, 7u);
+    EXPECT_EQ(position.context_id, 1u);
+    
+    // The ring itself holds only the delta
+    const PositionData& raw = mgr.getRingBuffer()[1].data;
+    EXPECT_EQ(raw.record_type, RecordType::Position);
+    EXPECT_EQ(raw.base_offset, 1u);
+    EXPECT_EQ(raw.s2_cell_id, 0u);
+    
+    // Projections see the merged state too
+    EXPECT_EQ(IPCReader::readLatestField(&PositionData::step_count).value_or(0), 7u);
+    
+    WorldState read_state;
+    ContextFrame read_context;
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context));
+    EXPECT_EQ(read_state.smoothed_lat, 37.7750);
+    EXPECT_EQ(read_state.s2_cell_id, 0x808580bcu);
+    EXPECT_DOUBLE_EQ(read_state.velocity_east_mps, 1.25);
+    EXPECT_DOUBLE_EQ(read_state.velocity_north_mps, -327.67);
+    EXPECT_STREQ(read_context.road_name, "Main St");
+}
+
+TEST_F(IPCTest, RecordTypesTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    SharedMemoryOptions options;
+    options.ring_capacity = 16;  // Delta chains are capped at 8 records
+    ASSERT_TRUE(mgr.initializeServer(options));
+    auto* buffer = mgr.getRingBuffer();
+    
+    WorldState state{};
+    state.step_count = 3;
+    ContextFrame context{};
+    strcpy(context.road_name, "Main St");
+    IPCWriter::writeState(state, context);
+    EXPECT_EQ(buffer[0].data.record_type, RecordType::ContextChanged);
+    
+    IPCWriter::writeState(state, context);
+    EXPECT_EQ(buffer[1].data.record_type, RecordType::FullState);
+    
+    for (int i = 0; i < 8; ++i) {
+        IPCWriter::updateLocation(1.0 + i, 2.0, 3.0, 100 + i);
+        EXPECT_EQ(buffer[2 + i].data.record_type, RecordType::Position);
+        EXPECT_EQ(buffer[2 + i].data.base_offset, i + 1);
+    }
+    
+    // Chain limit reached: a full record carried forward from the base
+    IPCWriter::updateLocation(9.0, 2.0, 3.0, 108);
+    EXPECT_EQ(buffer[10].data.record_type, RecordType::FullState);
+    EXPECT_EQ(buffer[10].data.step_count, 3u);
+    EXPECT_EQ(mgr.getHeader()->last_full_sequence.load(), 11u);
+    
+    // New context: the next record says so, even on the fast path
+    strcpy(context.road_name, "Oak Ave");
+    IPCWriter::publishContext(context);
+    IPCWriter::updateLocation(10.0, 2.0, 3.0, 109);
+    EXPECT_EQ(buffer[11].data.record_type, RecordType::ContextChanged);
+    EXPECT_EQ(buffer[11].data.context_id, 2u);
+    IPCWriter::updateLocation(11.0, 2.0, 3.0, 110);
+    EXPECT_EQ(buffer[12].data.record_type, RecordType::Position);
+    
+    // A drain reconstructs every delta against its base
+    std::vector<IPCUpdate> batch(16);
+    DrainResult result = IPCReader::readSince(0, batch);
+    ASSERT_EQ(result.count, 13u);
+    for (size_t i = 0; i < result.count; ++i) {
+        EXPECT_EQ(batch[i].position.step_count, 3u) << "sequence " << batch[i].sequence;
+    }
+    EXPECT_EQ(batch[12].position.latitude, 11.0);
+    EXPECT_EQ(batch[12].position.context_id, 2u);
+    
+    // Starting mid-chain, the base is fetched from the ring
+    result = IPCReader::readSince(5, batch);
+    ASSERT_GT(result.count, 0u);
+    EXPECT_EQ(batch[0].position.record_type, RecordType::Position);
+    EXPECT_EQ(batch[0].position.step_count, 3u);
+}
+
+TEST_F(IPCTest, DeltaReconstructionAcrossProcessesTest) {
+    constexpr int NUM_READERS = 3;
+    constexpr int READS_PER_READER = 30000;
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    // Every 4th update is a full state with step_count = k; the others are
+    // Position records that must inherit that step count
+    WorldState state{};
+    ContextFrame context{};
+    auto write = [&](uint32_t k) {
+        if (k % 4 == 0) {
+            state.smoothed_lat = k;
+            state.smoothed_lon = -static_cast<double>(k);
+            state.step_count = k;
+            IPCWriter::writeState(state, context);
+        } else {
+            IPCWriter::updateLocation(k, -static_cast<double>(k), 0.0, k);
+        }
+    };
+    uint32_t k = 0;
+    write(k);
+    
+    std::vector<pid_t> readers;
+    for (int i = 0; i < NUM_READERS; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            int torn = 0;
+            if (!SharedMemoryManager::getInstance().connectClient()) _exit(2);
+            for (int n = 0; n < READS_PER_READER; ++n) {
+                PositionData position;
+                if (IPCReader::readLatestPosition(position)) {
+                    uint32_t lat = static_cast<uint32_t>(position.latitude);
+                    if (position.longitude != -position.latitude ||
+                        position.step_count != lat - lat % 4) {
+                        ++torn;
+                    }
+                }
+            }
+            _exit(torn == 0 ? 0 : 1);
+        }
+        readers.push_back(pid);
+    }
+    
+    size_t running = readers.size();
+    std::vector<int> statuses(readers.size(), -1);
+    while (running > 0) {
+        write(++k);
+        for (size_t i = 0; i < readers.size(); ++i) {
+            if (statuses[i] != -1) continue;
+            int status = 0;
+            if (waitpid(readers[i], &status, WNOHANG) == readers[i]) {
+                statuses[i] = status;
+                --running;
+            }
+        }
+    }
+    
+    for (int status : statuses) {
+        ASSERT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+}
+
+TEST_F(IPCTest, RecordViewTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    RecordView view;
+    EXPECT_FALSE(IPCReader::viewLatest(view));
+    
+    WorldState state{};
+    ContextFrame context{};
+    fillStressEntry(7, state, context);
+    IPCWriter::writeState(state, context);
+    
+    ASSERT_TRUE(IPCReader::viewLatest(view));
+    EXPECT_EQ(view.sequence(), 1u);
+    EXPECT_EQ(view.data().latitude, 7.0);
+    EXPECT_EQ(view.data().step_count, 7u);
+    EXPECT_TRUE(view.validate());
+    
+    // The view points into shared memory: once the slot is reused it no longer validates
+    for (uint32_t k = 8; k < 8 + mgr.getRingCapacity(); ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    EXPECT_FALSE(view.validate());
+    
+    ContextView context_view;
+    ASSERT_TRUE(IPCReader::viewContext(mgr.getHeader()->context_id.load(), context_view));
+    EXPECT_EQ(context_view.frame().timestamp_ms, 7u + mgr.getRingCapacity());
+    EXPECT_TRUE(context_view.validate());
+    EXPECT_FALSE(IPCReader::viewContext(1, context_view));  // Recycled long ago
+    EXPECT_FALSE(IPCReader::viewContext(0, context_view));
+}
+
+TEST_F(IPCTest, ProjectionTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    EXPECT_FALSE(IPCReader::readLatestField(&PositionData::s2_cell_id).has_value());
+    
+    WorldState state{};
+    state.smoothed_lat = 37.7749;
+    state.smoothed_lon = -122.4194;
+    state.s2_cell_id = 0x8085808000000000ULL;
+    ContextFrame context{};
+    strcpy(context.road_name, "Main St");
+    IPCWriter::writeState(state, context);
+    
+    auto cell = IPCReader::readLatestField(&PositionData::s2_cell_id);
+    ASSERT_TRUE(cell.has_value());
+    EXPECT_EQ(*cell, 0x8085808000000000ULL);
+    
+    auto lat_lon = IPCReader::readProjected([](const PositionData& data) {
+        return std::make_pair(data.latitude, data.longitude);
+    });
+    ASSERT_TRUE(lat_lon.has_value());
+    EXPECT_DOUBLE_EQ(lat_lon->first, 37.7749);
+    EXPECT_DOUBLE_EQ(lat_lon->second, -122.4194);
+    
+    auto context_id = IPCReader::readLatestField(&PositionData::context_id);
+    ASSERT_TRUE(context_id.has_value());
+    auto road = IPCReader::readContextProjected(*context_id, [](const ContextPayload& payload) {
+        return std::string(payload.frame.road_name);
+    });
+    EXPECT_EQ(road.value_or(""), "Main St");
+}
+
+TEST_F(IPCTest, ProjectionStressAcrossProcessesTest) {
+    constexpr int NUM_READERS = 4;
+    constexpr int READS_PER_READER = 50000;
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    WorldState state{};
+    ContextFrame context{};
+    uint32_t k = 1;
+    fillStressEntry(k, state, context);
+    IPCWriter::writeState(state, context);
+    
+    std::vector<pid_t> readers;
+    for (int i = 0; i < NUM_READERS; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            // Child: project fields in place; a validated projection must never be torn
+            int torn = 0;
+            if (!SharedMemoryManager::getInstance().connectClient()) _exit(2);
+            for (int n = 0; n < READS_PER_READER; ++n) {
+                auto fields = IPCReader::readProjected([](const PositionData& data) {
+                    return std::make_tuple(data.latitude, data.longitude, data.step_count);
+                });
+                if (fields) {
+                    auto [lat, lon, steps] = *fields;
+                    if (lat != steps || lon != -lat) ++torn;
+                }
+            }
+            _exit(torn == 0 ? 0 : 1);
+        }
+        readers.push_back(pid);
+    }
+    
+    size_t running = readers.size();
+    std::vector<int> statuses(readers.size(), -1);
+    while (running > 0) {
+        fillStressEntry(++k, state, context);
+        IPCWriter::writeState(state, context);
+        
+        for (size_t i = 0; i < readers.size(); ++i) {
+            if (statuses[i] != -1) continue;
+            int status = 0;
+            if (waitpid(readers[i], &status, WNOHANG) == readers[i]) {
+                statuses[i] = status;
+                --running;
+            }
+        }
+    }
+    
+    for (int status : statuses) {
+        ASSERT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+}
+
+TEST_F(IPCTest, SegmentSizedFromRingCapacityTest) {
+    size_t default_size = SharedMemoryManager::requiredSegmentSize(SharedMemoryHeader::RING_BUFFER_SIZE);
+    EXPECT_GE(default_size, sizeof(SharedMemoryHeader) +
+                            sizeof(PositionRecord) * SharedMemoryHeader::RING_BUFFER_SIZE +
+                            sizeof(ContextSlot) * SharedMemoryHeader::CONTEXT_SLAB_SIZE);
+    EXPECT_EQ(default_size % static_cast<size_t>(sysconf(_SC_PAGESIZE)), 0u);
+    EXPECT_GT(SharedMemoryManager::requiredSegmentSize(4096), default_size);
+    
+    // Smaller ring: writes wrap at the configured capacity
+    SharedMemoryOptions options;
+    options.ring_capacity = 16;
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer(options));
+    EXPECT_EQ(mgr.getRingCapacity(), 16u);
+    
+    WorldState state{};
+    ContextFrame context{};
+    for (uint32_t k = 1; k <= 40; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    EXPECT_EQ(mgr.getRingBuffer()[ringSlot(40, 16)].sequence.load(), 2u * 40u);
+    
+    std::vector<IPCUpdate> batch(64);
+    DrainResult result = IPCReader::readSince(0, batch);
+    EXPECT_EQ(result.count, 16u);
+    EXPECT_EQ(result.lapped, 24u);
+    
+    WorldState read_state;
+    ContextFrame read_context;
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context));
+    EXPECT_EQ(read_state.step_count, 40u);
+}
+
+TEST_F(IPCTest, RejectsInvalidRingCapacityTest) {
+    SharedMemoryOptions options;
+    options.ring_capacity = 1000;
+    EXPECT_FALSE(SharedMemoryManager::getInstance().initializeServer(options));
+    EXPECT_FALSE(SharedMemoryManager::getInstance().isReady());
+}
+
+TEST_F(IPCTest, ClientRejectsMismatchedLayoutTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    // Simulate a daemon built with a different layout
+    mgr.getHeader()->ring_offset += CACHE_LINE_SIZE;
+    EXPECT_FALSE(mgr.connectClient());
+    EXPECT_FALSE(mgr.isReady());
+}
+
+TEST_F(IPCTest, ClientRejectsMismatchedAbiTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    auto* header = mgr.getHeader();
+    EXPECT_EQ(header->magic.load(), SharedMemoryHeader::MAGIC);
+    EXPECT_EQ(header->version, SharedMemoryHeader::ABI_VERSION);
+    EXPECT_EQ(header->layout_hash, sharedMemoryLayoutHash());
+    
+    // Older daemon
+    header->version = SharedMemoryHeader::ABI_VERSION - 1;
+    EXPECT_FALSE(mgr.connectClient());
+    
+    // Same version, different struct layout
+    ASSERT_TRUE(mgr.initializeServer());
+    mgr.getHeader()->layout_hash ^= 1;
+    EXPECT_FALSE(mgr.connectClient());
+    
+    // Segment that was never (or not yet) published
+    ASSERT_TRUE(mgr.initializeServer());
+    mgr.getHeader()->magic.store(0);
+    EXPECT_FALSE(mgr.connectClient());
+    
+    ASSERT_TRUE(mgr.initializeServer());
+    EXPECT_TRUE(mgr.connectClient());
+}
+
+TEST_F(IPCTest, HeaderOwnershipLinesTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    auto* header = mgr.getHeader();
+    
+    auto line = [header](const void* field) {
+        return (reinterpret_cast<uintptr_t>(field) - reinterpret_cast<uintptr_t>(header)) /
+               CACHE_LINE_SIZE;
+    };
+    
+    // Writer-hot fields share a line that no reader writes to
+    EXPECT_EQ(line(&header->global_sequence), line(&header->total_updates));
+    EXPECT_EQ(line(&header->global_sequence), line(&header->update_futex));
+    EXPECT_NE(line(&header->global_sequence), line(&header->read_retries));
+    EXPECT_NE(line(&header->global_sequence), line(&header->futex_waiters));
+    EXPECT_NE(line(&header->global_sequence), line(&header->location_service_alive));
+    EXPECT_NE(line(&header->read_retries), line(&header->location_service_alive));
+}
+
+TEST_F(IPCTest, StatsHistogramTest) {
+    EXPECT_EQ(IPCStats::bucketFor(0), 0u);
+    EXPECT_EQ(IPCStats::bucketFor(1), 1u);
+    EXPECT_EQ(IPCStats::bucketFor(1000), 10u);   // [512, 1024)
+    EXPECT_EQ(IPCStats::bucketFor(1024), 11u);
+    EXPECT_EQ(IPCStats::bucketFor(UINT64_MAX), LatencyHistogram::BUCKETS - 1);
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    // 90 fast samples, 10 slow ones
+    for (int i = 0; i < 90; ++i) {
+        IPCStats::recordLatency(LatencyMetric::ProviderFetch, 1000);
+    }
+    for (int i = 0; i < 10; ++i) {
+        IPCStats::recordLatency(LatencyMetric::ProviderFetch, 2000000);
+    }
+    IPCStats::increment(StatCounter::CellCrossings, 3);
+    
+    // Publishing an identical context is a cache hit
+    ContextFrame context{};
+    std::strcpy(context.road_name, "Market St");
+    IPCWriter::publishContext(context);
+    IPCWriter::publishContext(context);
+    
+    // A read-only client sees the same numbers
+    SharedMemoryOptions options;
+    options.read_only = true;
+    ASSERT_TRUE(mgr.connectClient(options));
+    
+    StatsSnapshot stats;
+    ASSERT_TRUE(IPCStats::snapshot(stats, mgr));
+    const HistogramSnapshot& fetch = stats.histogram(LatencyMetric::ProviderFetch);
+    EXPECT_EQ(fetch.count, 100u);
+    EXPECT_EQ(fetch.max_ns, 2000000u);
+    EXPECT_DOUBLE_EQ(fetch.meanNs(), (90 * 1000.0 + 10 * 2000000.0) / 100);
+    EXPECT_EQ(fetch.percentileNs(0.5), 1023u);     // Upper bound of [512, 1024)
+    EXPECT_EQ(fetch.percentileNs(0.9), 1023u);
+    EXPECT_EQ(fetch.percentileNs(0.99), 2000000u); // Bucket bound clamped to max
+    EXPECT_EQ(stats.histogram(LatencyMetric::LoopJitter).count, 0u);
+    EXPECT_EQ(stats.histogram(LatencyMetric::LoopJitter).percentileNs(0.5), 0u);
+    EXPECT_EQ(stats.counter(StatCounter::CellCrossings), 3u);
+    EXPECT_EQ(stats.counter(StatCounter::ContextCacheHits), 1u);
+    EXPECT_EQ(stats.counter(StatCounter::DroppedFixes), 0u);
+}
+
+TEST_F(IPCTest, FileBackedPrefaultedSegmentTest) {
+    SharedMemoryOptions options;
+    options.backing_file = "/tmp/s2sgeo_test_segment";
+    options.prefault = true;
+    options.lock_pages = true;  // Best effort: failure is logged, not fatal
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer(options));
+    
+    WorldState state{};
+    ContextFrame context{};
+    fillStressEntry(1, state, context);
+    IPCWriter::writeState(state, context);
+    
+    ASSERT_TRUE(mgr.connectClient(options));
+    WorldState read_state;
+    ContextFrame read_context;
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context));
+    EXPECT_TRUE(isConsistentStressEntry(read_state, read_context));
+    
+    mgr.cleanup();
+    EXPECT_NE(access(options.backing_file.c_str(), F_OK), 0);
+}
+
+TEST_F(IPCTest, ResumeFileBackedSegmentTest) {
+    SharedMemoryOptions options;
+    options.backing_file = "/tmp/s2sgeo_test_resume";
+    options.ring_capacity = 64;
+    options.resume = true;
+    unlink(options.backing_file.c_str());
+    
+    // Nothing to resume yet: a fresh segment is created
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer(options));
+    EXPECT_FALSE(mgr.wasResumed());
+    
+    WorldState state{};
+    ContextFrame context{};
+    for (uint32_t k = 1; k <= 100; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    IPCWriter::setActivePlugin("dating");
+    FilterSnapshot saved{};
+    saved.state[0] = 37.7749;
+    saved.covariance[5] = 2.5;
+    saved.last_update_ms = 1234;
+    saved.step_count = 42;
+    IPCWriter::saveFilterSnapshot(saved);
+    
+    // Daemon goes away without removing the file, then comes back
+    mgr.detach();
+    ASSERT_TRUE(mgr.initializeServer(options));
+    EXPECT_TRUE(mgr.wasResumed());
+    EXPECT_FALSE(IPCReader::isLocationServiceAlive());
+    EXPECT_EQ(IPCReader::latestSequence(), 100u);
+    EXPECT_EQ(IPCReader::getActivePlugin(), "dating");
+    
+    WorldState read_state;
+    ContextFrame read_context;
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context));
+    EXPECT_TRUE(isConsistentStressEntry(read_state, read_context));
+    EXPECT_EQ(read_state.step_count, state.step_count);
+    
+    FilterSnapshot loaded;
+    ASSERT_TRUE(IPCWriter::loadFilterSnapshot(loaded));
+    EXPECT_EQ(loaded.state[0], saved.state[0]);
+    EXPECT_EQ(loaded.covariance[5], saved.covariance[5]);
+    EXPECT_EQ(loaded.last_update_ms, 1234);
+    EXPECT_EQ(loaded.step_count, 42u);
+    
+    // The sequence carries on where the previous daemon stopped
+    fillStressEntry(101, state, context);
+    IPCWriter::writeState(state, context);
+    EXPECT_EQ(IPCReader::latestSequence(), 101u);
+    
+    // A snapshot torn by a crash mid-save is ignored
+    mgr.getRestartState()->sequence.fetch_add(1);
+    EXPECT_FALSE(IPCWriter::loadFilterSnapshot(loaded));
+    
+    // A different ring capacity cannot be resumed
+    mgr.detach();
+    options.ring_capacity = 128;
+    ASSERT_TRUE(mgr.initializeServer(options));
+    EXPECT_FALSE(mgr.wasResumed());
+    EXPECT_EQ(IPCReader::latestSequence(), 0u);
+    EXPECT_FALSE(IPCWriter::loadFilterSnapshot(loaded));
+    
+    mgr.cleanup();
+    EXPECT_NE(access(options.backing_file.c_str(), F_OK), 0);
+}
+
+TEST_F(IPCTest, ResumeAfterCrashMidPublishTest) {
+    SharedMemoryOptions options;
+    options.backing_file = "/tmp/s2sgeo_test_resume_crash";
+    options.ring_capacity = 16;
+    options.resume = true;
+    unlink(options.backing_file.c_str());
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer(options));
+    WorldState state{};
+    ContextFrame context{};
+    for (uint32_t k = 1; k <= 20; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    
+    // Crash while entry 21 was being copied: its slot is odd, global_sequence still 20
+    PositionRecord& torn = mgr.getRingBuffer()[ringSlot(21, 16)];
+    torn.sequence.store(2 * 21 - 1);
+    torn.data.step_count = 0xdead;
+    mgr.detach();
+    
+    ASSERT_TRUE(mgr.initializeServer(options));
+    ASSERT_TRUE(mgr.wasResumed());
+    WorldState read_state;
+    ContextFrame read_context;
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context));
+    EXPECT_EQ(read_state.step_count, 20u);
+    
+    // The resumed writer rewrites entry 21 in its own slot and carries on
+    for (uint32_t k = 21; k <= 24; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    for (uint64_t seq = 24 - 16 + 1; seq <= 24; ++seq) {
+        EXPECT_EQ(mgr.getRingBuffer()[ringSlot(seq, 16)].sequence.load(), 2 * seq) << "entry " << seq;
+    }
+    std::vector<IPCUpdate> batch(16);
+    DrainResult result = IPCReader::readSince(18, batch);
+    ASSERT_EQ(result.count, 6u);
+    EXPECT_EQ(result.lapped, 0u);
+    for (size_t i = 0; i < result.count; ++i) {
+        EXPECT_EQ(batch[i].sequence, 19 + i);
+        EXPECT_EQ(batch[i].position.step_count, 19 + i);
+    }
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context));
+    EXPECT_EQ(read_state.step_count, 24u);
+    
+    mgr.cleanup();
+}
+
+TEST_F(IPCTest, ResumeFindsNewestFullRecordTest) {
+    SharedMemoryOptions options;
+    options.backing_file = "/tmp/s2sgeo_test_resume_base";
+    options.ring_capacity = 16;
+    options.resume = true;
+    unlink(options.backing_file.c_str());
+    
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer(options));
+    WorldState state{};
+    state.step_count = 5;
+    ContextFrame context{};
+    IPCWriter::writeState(state, context);
+    IPCWriter::writeState(state, context);
+    for (int i = 0; i < 3; ++i) {
+        IPCWriter::updateLocation(1.0 + i, 2.0, 3.0, 100 + i);
+    }
+    
+    // Crash right after publishing full entry 6, before last_full_sequence moved
+    state.step_count = 6;
+    IPCWriter::writeState(state, context);
+    mgr.getHeader()->last_full_sequence.store(2);
+    mgr.detach();
+    
+    ASSERT_TRUE(mgr.initializeServer(options));
+    ASSERT_TRUE(mgr.wasResumed());
+    EXPECT_EQ(mgr.getHeader()->last_full_sequence.load(), 6u);
+    
+    // The next delta is based on entry 6, not entry 2
+    IPCWriter::updateLocation(4.0, 2.0, 3.0, 103);
+    const PositionData& delta = mgr.getRingBuffer()[ringSlot(7, 16)].data;
+    ASSERT_EQ(delta.record_type, RecordType::Position);
+    EXPECT_EQ(delta.base_offset, 1u);
+    WorldState read_state;
+    ContextFrame read_context;
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context));
+    EXPECT_EQ(read_state.step_count, 6u);
+    
+    mgr.cleanup();
+}
+
+TEST_F(IPCTest, TenantSegmentsAreIndependentTest) {
+    auto& alice = SharedMemoryManager::getInstance("alice");
+    auto& bob = SharedMemoryManager::getInstance("bob");
+    EXPECT_EQ(&alice, &SharedMemoryManager::getInstance("alice"));
+    EXPECT_NE(&alice, &bob);
+    EXPECT_EQ(alice.segmentName(), "s2sgeo_shm.alice");
+    EXPECT_EQ(SharedMemoryManager::getInstance().segmentName(), "s2sgeo_shm");
+    
+    ASSERT_TRUE(alice.initializeServer());
+    ASSERT_TRUE(bob.initializeServer());
+    
+    WorldState state{};
+    ContextFrame context{};
+    fillStressEntry(1, state, context);
+    IPCWriter::writeState(state, context, alice);
+    for (uint32_t k = 10; k < 13; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context, bob);
+    }
+    
+    // Default tenant was never initialized
+    EXPECT_EQ(IPCReader::latestSequence(), 0u);
+    EXPECT_EQ(IPCReader::latestSequence(alice), 1u);
+    EXPECT_EQ(IPCReader::latestSequence(bob), 3u);
+    
+    WorldState read_state;
+    ContextFrame read_context;
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context, alice));
+    EXPECT_EQ(read_state.step_count, 1u);
+    ASSERT_TRUE(IPCReader::readLatestState(read_state, read_context, bob));
+    EXPECT_EQ(read_state.step_count, 12u);
+    
+    std::vector<IPCUpdate> batch(8);
+    IPCCursor cursor(0, bob);
+    EXPECT_EQ(cursor.drain(batch).count, 3u);
+    
+    alice.cleanup();
+    bob.cleanup();
+    EXPECT_FALSE(alice.connectClient());
+}
+
+TEST_F(IPCTest, TenantAcrossProcessesTest) {
+    auto& tenant = SharedMemoryManager::getInstance("device-42");
+    ASSERT_TRUE(tenant.initializeServer());
+    
+    WorldState state{};
+    ContextFrame context{};
+    fillStressEntry(42, state, context);
+    IPCWriter::writeState(state, context, tenant);
+    IPCWriter::signalAlive(tenant);
+    
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        auto& client = SharedMemoryManager::getInstance("device-42");
+        if (!client.connectClient()) _exit(2);
+        auto steps = IPCReader::readLatestField(&PositionData::step_count, client);
+        bool ok = steps && *steps == 42u && IPCReader::isLocationServiceAlive(client) &&
+                  !IPCReader::isLocationServiceAlive();
+        _exit(ok ? 0 : 1);
+    }
+    
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    tenant.cleanup();
+}
+
+TEST_F(IPCTest, RejectsInvalidTenantNameTest) {
+    auto& bad = SharedMemoryManager::getInstance("../etc/passwd");
+    EXPECT_FALSE(bad.initializeServer());
+    EXPECT_FALSE(bad.connectClient());
+    EXPECT_FALSE(SharedMemoryManager::getInstance(std::string(100, 'x')).initializeServer());
+}
+
+TEST_F(IPCTest, ConsumerLagAndOverrunTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    IPCCursor cursor;
+    ASSERT_TRUE(cursor.attach("telemetry"));
+    
+    WorldState state{};
+    ContextFrame context{};
+    for (uint32_t k = 1; k <= 100; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    
+    ConsumerLagReport report = IPCWriter::publishConsumerLag();
+    EXPECT_EQ(report.active_consumers, 1u);
+    EXPECT_EQ(report.max_lag, 100u);
+    EXPECT_EQ(report.slowest_consumer, "telemetry");
+    EXPECT_EQ(IPCReader::maxConsumerLag(), 100u);
+    EXPECT_EQ(mgr.getHeader()->active_consumers.load(), 1u);
+    
+    std::vector<IPCUpdate> batch(256);
+    cursor.drain(batch);
+    EXPECT_EQ(IPCWriter::publishConsumerLag().max_lag, 0u);
+    
+    // Fall more than a ring behind: the drain's lapped count shows up as overruns
+    uint32_t capacity = mgr.getRingCapacity();
+    for (uint32_t k = 101; k <= 100 + capacity + 50; ++k) {
+        fillStressEntry(k, state, context);
+        IPCWriter::writeState(state, context);
+    }
+    EXPECT_EQ(IPCWriter::publishConsumerLag().max_lag, capacity + 50u);
+    cursor.drain(batch);
+    report = IPCWriter::publishConsumerLag();
+    EXPECT_EQ(report.total_overruns, 50u);
+    EXPECT_EQ(report.max_lag, capacity - batch.size());
+    
+    cursor.detach();
+    EXPECT_EQ(IPCWriter::publishConsumerLag().active_consumers, 0u);
+}
+
+TEST_F(IPCTest, ConsumerTableLimitTest) {
+    ASSERT_TRUE(SharedMemoryManager::getInstance().initializeServer());
+    
+    std::vector<int32_t> slots;
+    for (size_t i = 0; i < SharedMemoryHeader::MAX_CONSUMERS; ++i) {
+        slots.push_back(IPCReader::registerConsumer("reader"));
+        EXPECT_GE(slots.back(), 0);
+    }
+    EXPECT_EQ(IPCReader::registerConsumer("one-too-many"), -1);
+    
+    IPCReader::unregisterConsumer(slots.front());
+    EXPECT_EQ(IPCReader::registerConsumer("reuses-slot"), slots.front());
+}
+
+TEST_F(IPCTest, ReclaimsSlotsOfExitedConsumersTest) {
+    ASSERT_TRUE(SharedMemoryManager::getInstance().initializeServer());
+    
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        // Register and exit without unregistering, as a crashed adapter would
+        if (!SharedMemoryManager::getInstance().connectClient()) _exit(2);
+        _exit(IPCReader::registerConsumer("crashy") >= 0 ? 0 : 1);
+    }
+    
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+    
+    ConsumerLagReport report = IPCWriter::publishConsumerLag();
+    EXPECT_EQ(report.reclaimed_slots, 1u);
+    EXPECT_EQ(report.active_consumers, 0u);
+    EXPECT_EQ(IPCWriter::publishConsumerLag().reclaimed_slots, 0u);
+}
+
+TEST_F(IPCTest, CommandRingRoundTripTest) {
+    ASSERT_TRUE(SharedMemoryManager::getInstance().initializeServer());
+    
+    CommandRecord command;
+    EXPECT_FALSE(IPCCommandRing::pop(command));
+    
+    EXPECT_TRUE(IPCCommandRing::activateProvider("dating"));
+    EXPECT_TRUE(IPCCommandRing::setAccuracy(0.5));
+    EXPECT_TRUE(IPCCommandRing::setS2Level(12));
+    EXPECT_TRUE(IPCCommandRing::forceRefresh());
+    
+    ASSERT_TRUE(IPCCommandRing::pop(command));
+    EXPECT_EQ(command.type, CommandType::ActivateProvider);
+    EXPECT_STREQ(command.argument, "dating");
+    ASSERT_TRUE(IPCCommandRing::pop(command));
+    EXPECT_EQ(command.type, CommandType::SetAccuracy);
+    EXPECT_DOUBLE_EQ(command.value, 0.5);
+    ASSERT_TRUE(IPCCommandRing::pop(command));
+    EXPECT_EQ(command.type, CommandType::SetS2Level);
+    EXPECT_EQ(command.int_value, 12);
+    ASSERT_TRUE(IPCCommandRing::pop(command));
+    EXPECT_EQ(command.type, CommandType::ForceRefresh);
+    EXPECT_FALSE(IPCCommandRing::pop(command));
+}
+
+TEST_F(IPCTest, CommandRingFullTest) {
+    auto& mgr = SharedMemoryManager::getInstance();
+    ASSERT_TRUE(mgr.initializeServer());
+    
+    for (size_t i = 0; i < CommandRing::CAPACITY; ++i) {
+        EXPECT_TRUE(IPCCommandRing::setS2Level(static_cast<int>(i)));
+    }
+    EXPECT_FALSE(IPCCommandRing::forceRefresh());
+    EXPECT_EQ(mgr.getCommandRing()->dropped.load(), 1u);
+    
+    // Draining one entry frees one slot, and order is preserved across the wrap
+    CommandRecord command;
+    ASSERT_TRUE(IPCCommandRing::pop(command));
+    EXPECT_EQ(command.int_value, 0);
+    EXPECT_TRUE(IPCCommandRing::forceRefresh());
+    
+    size_t drained = 0;
+    while (IPCCommandRing::pop(command)) ++drained;
+    EXPECT_EQ(drained, CommandRing::CAPACITY);
+    EXPECT_EQ(command.type, CommandType::ForceRefresh);
+}
+
+TEST_F(IPCTest, CommandRingAcrossProcessesTest) {
+    constexpr int NUM_COMMANDS = 100000;
+    ASSERT_TRUE(SharedMemoryManager::getInstance().initializeServer());
+    
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        // Adapter: push a numbered stream, spinning while the ring is full
+        if (!SharedMemoryManager::getInstance().connectClient()) _exit(2);
+        for (int n = 0; n < NUM_COMMANDS; ++n) {
+            while (!IPCCommandRing::setS2Level(n)) {
+                std::this_thread::yield();
+            }
+        }
+        _exit(0);
+    }
+    
+    // Daemon: every command arrives exactly once, in order
+    int expected = 0;
+    bool in_order = true;
+    CommandRecord command;
+    while (expected < NUM_COMMANDS) {
+        if (IPCCommandRing::pop(command)) {
+            in_order = in_order && command.type == CommandType::SetS2Level &&
+                       command.int_value == expected;
+            ++expected;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    EXPECT_TRUE(in_order);
+    
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -4,8 +4,20 @@
  */
 
 #include "KalmanFilter.hpp"
+#include "KalmanBatch.hpp"
+#include "StationaryDetector.hpp"
+#include "StepDetector.hpp"
+#include "TrajectorySmoother.hpp"
 #include "gtest/gtest.h"
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <vector>
 
 using namespace s2sgeo;
 
@@ -76,6 +88,896 @@ TEST_F(KalmanFilterTest, ResetTest) {
     EXPECT_EQ(state.smoothed_lon, 0.0);
 }
 
+TEST_F(KalmanFilterTest, SnapshotRestoreTest) {
+    for (int i = 0; i < 10; ++i) {
+        kf_->update(LocationFix(37.7749 + i * 0.0001, -122.4194, 1000 + i * 100));
+    }
+    
+    // A restored filter continues exactly like the original
+    KalmanFilter restored;
+    restored.restore(kf_->snapshot());
+    
+    LocationFix next(37.7760, -122.4194, 2000);
+    kf_->update(next);
+    restored.update(next);
+    
+    WorldState expected = kf_->getSmoothedState();
+    WorldState state = restored.getSmoothedState();
+    EXPECT_EQ(state.smoothed_lat, expected.smoothed_lat);
+    EXPECT_EQ(state.smoothed_lon, expected.smoothed_lon);
+    EXPECT_EQ(state.last_update_ms, expected.last_update_ms);
+}
+
+TEST_F(KalmanFilterTest, CheckpointRestoreTest) {
+    KalmanTuning tuning;
+    tuning.adaptive_measurement_noise = true;
+    tuning.adaptive_process_noise = true;
+    kf_->setTuning(tuning);
+    kf_->setProcessNoise(0.3);
+    kf_->setMeasurementNoise(25.0);
+    for (int i = 0; i < 20; ++i) {
+        LocationFix fix(37.7749 + i * 0.00005, -122.4194 + i * 0.00002, 1000 + i * 1000);
+        fix.accuracy = 4.0 + (i % 3);
+        fix.accel_z = i % 2 ? 16.0 : 9.0;
+        kf_->update(fix);
+    }
+    
+    std::vector<uint8_t> bytes = kf_->checkpoint();
+    EXPECT_EQ(bytes.size(), sizeof(FilterCheckpointHeader) + (10 + 4 + 10 + 3) * sizeof(double));
+    
+    // Through the interface, into a filter with default settings
+    KalmanFilter restored;
+    restored.setTuning(tuning);
+    IKalmanFilter& target = restored;
+    ASSERT_TRUE(target.restore(bytes));
+    EXPECT_EQ(restored.checkpoint(), bytes);
+    
+    // Both continue identically, noise settings, adaptation and PDR included
+    for (int i = 20; i < 30; ++i) {
+        LocationFix fix(37.7749 + i * 0.00005, -122.4194 + i * 0.00002, 1000 + i * 1000);
+        fix.accel_z = i % 2 ? 16.0 : 9.0;
+        kf_->update(fix);
+        restored.update(fix);
+        EXPECT_EQ(restored.state(), kf_->state());
+        EXPECT_EQ(restored.covariance(), kf_->covariance());
+        EXPECT_EQ(restored.processNoiseScale(), kf_->processNoiseScale());
+    }
+    EXPECT_EQ(restored.getSmoothedState().step_count, kf_->getSmoothedState().step_count);
+    EXPECT_EQ(restored.getSmoothedState().last_update_ms, kf_->getSmoothedState().last_update_ms);
+}
+
+TEST_F(KalmanFilterTest, CheckpointRejectsForeignBytesTest) {
+    kf_->update(LocationFix(37.7749, -122.4194, 1000));
+    std::vector<uint8_t> bytes = kf_->checkpoint();
+    std::vector<uint8_t> before = kf_->checkpoint();
+    
+    std::vector<uint8_t> truncated(bytes.begin(), bytes.end() - 1);
+    EXPECT_FALSE(kf_->restore(truncated));
+    
+    std::vector<uint8_t> newer = bytes;
+    uint16_t version = FilterCheckpointHeader::VERSION + 1;
+    std::memcpy(newer.data() + offsetof(FilterCheckpointHeader, version), &version, sizeof(version));
+    EXPECT_FALSE(kf_->restore(newer));
+    
+    std::vector<uint8_t> corrupt = bytes;
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    std::memcpy(corrupt.data() + corrupt.size() - sizeof(double), &nan, sizeof(nan));
+    EXPECT_FALSE(kf_->restore(corrupt));
+    
+    // Finite but unusable: payload scalars in FilterCheckpointHeader's order, then x and P
+    auto withDouble = [&](size_t index, double value) {
+        std::vector<uint8_t> edited = bytes;
+        std::memcpy(edited.data() + sizeof(FilterCheckpointHeader) + index * sizeof(double), &value, sizeof(value));
+        return edited;
+    };
+    EXPECT_FALSE(kf_->restore(withDouble(0, 91.0)));   // Anchor latitude
+    EXPECT_FALSE(kf_->restore(withDouble(1, -181.0))); // Anchor longitude
+    EXPECT_FALSE(kf_->restore(withDouble(3, 0.0)));    // Process noise
+    EXPECT_FALSE(kf_->restore(withDouble(4, -1.0)));   // Measurement noise floor
+    EXPECT_FALSE(kf_->restore(withDouble(8, -0.5)));   // Q scale
+    EXPECT_FALSE(kf_->restore(withDouble(10 + 4, -1.0)));  // P(0, 0)
+    EXPECT_FALSE(kf_->restore(withDouble(10 + 4 + 1, 1e9)));  // P(0, 1) beyond sqrt(P00 P11)
+    
+    // Another filter type: same magic, other dimensions
+    AltitudeKalmanFilter altitude;
+    altitude.update(LocationFix(37.7749, -122.4194, 1000));
+    EXPECT_FALSE(kf_->restore(altitude.checkpoint()));
+    EXPECT_FALSE(altitude.restore(bytes));
+    
+    EXPECT_EQ(kf_->checkpoint(), before);
+}
+
+TEST_F(KalmanFilterTest, MatchesDenseReferenceTest) {
+    // Textbook dense Kalman equations with the default tuning
+    Eigen::Matrix4d A = Eigen::Matrix4d::Identity();
+    Eigen::Matrix<double, 2, 4> H = Eigen::Matrix<double, 2, 4>::Zero();
+    H(0, 0) = H(1, 1) = 1.0;
+    Eigen::Matrix4d Q = Eigen::Matrix4d::Identity() * 0.1;
+    Q(0, 0) *= 0.001;
+    Q(1, 1) *= 0.001;
+    Eigen::Vector4d x = Eigen::Vector4d::Zero();
+    Eigen::Matrix4d P = Eigen::Matrix4d::Identity() * 1e6;
+    LocalTangentFrame frame(37.7749, -122.4194);  // The first fix; the track stays within 1 km
+    
+    for (int i = 0; i < 50; ++i) {
+        LocationFix fix(37.7749 + i * 0.0001, -122.4194 + (i % 3) * 0.00005, 1000 + i * 150);
+        fix.accuracy = 5.0 + i % 20;
+        kf_->update(fix);
+        
+        double dt = i == 0 ? 0.1 : 0.15;
+        A(0, 2) = A(1, 3) = dt;
+        x = A * x;
+        P = A * P * A.transpose() + Q;
+        Eigen::Matrix2d R = Eigen::Matrix2d::Identity() * std::max(100.0, fix.accuracy * fix.accuracy);
+        Eigen::Matrix2d S = H * P * H.transpose() + R;
+        Eigen::Matrix<double, 4, 2> K = P * H.transpose() * S.inverse();
+        EnuPoint z = frame.toEnu(fix.latitude, fix.longitude);
+        x = x + K * (Eigen::Vector2d(z.east, z.north) - H * x);
+        P = (Eigen::Matrix4d::Identity() - K * H) * P;
+    }
+    
+    EXPECT_TRUE(kf_->state().isApprox(x, 1e-9));
+    EXPECT_TRUE(kf_->covariance().isApprox(P, 1e-9));
+}
+
+TEST(LocalTangentFrameTest, RoundTripTest) {
+    LocalTangentFrame frame(37.7749, -122.4194, 10.0);
+    
+    // 0.001 degrees of latitude is ~111 m; of longitude ~88 m at 37.8 N
+    EnuPoint enu = frame.toEnu(37.7759, -122.4184, 15.0);
+    EXPECT_NEAR(enu.north, 111.0, 0.5);
+    EXPECT_NEAR(enu.east, 88.2, 0.5);
+    EXPECT_DOUBLE_EQ(enu.up, 5.0);
+    
+    GeodeticPoint back = frame.toGeodetic(enu.east, enu.north, enu.up);
+    EXPECT_NEAR(back.latitude, 37.7759, 1e-12);
+    EXPECT_NEAR(back.longitude, -122.4184, 1e-12);
+    EXPECT_NEAR(back.altitude, 15.0, 1e-12);
+    
+    // Across the antimeridian
+    LocalTangentFrame dateline(0.0, 179.9995);
+    EXPECT_NEAR(dateline.toEnu(0.0, -179.9995).east, 111.3, 0.5);
+}
+
+TEST_F(KalmanFilterTest, VelocityAcrossReanchorTest) {
+    // 20 m/s due north for 5 minutes: six re-anchors
+    LocalTangentFrame start(37.7749, -122.4194);
+    GeodeticPoint truth{};
+    for (int i = 0; i <= 300; ++i) {
+        truth = start.toGeodetic(0.0, 20.0 * i);
+        LocationFix fix(truth.latitude, truth.longitude, 1000 + i * 1000);
+        fix.accuracy = 5.0;
+        kf_->update(fix);
+    }
+    
+    WorldState state = kf_->getSmoothedState();
+    EnuPoint error = start.toEnu(state.smoothed_lat, state.smoothed_lon);
+    EXPECT_NEAR(error.north, 6000.0, 2.0);
+    EXPECT_NEAR(error.east, 0.0, 2.0);
+    EXPECT_NEAR(state.velocity_north_mps, 20.0, 0.2);
+    EXPECT_NEAR(state.velocity_east_mps, 0.0, 0.2);
+    EXPECT_TRUE(state.is_moving);
+    EXPECT_LT(std::hypot(kf_->state()(0), kf_->state()(1)), LocalTangentFrame::REANCHOR_DISTANCE_M + 40.0);
+}
+
+TEST_F(KalmanFilterTest, GatesMultipathSpikeTest) {
+    // Walking east at 1.4 m/s, then one fix 150 m north of the path
+    LocalTangentFrame start(37.7749, -122.4194);
+    for (int i = 0; i < 20; ++i) {
+        GeodeticPoint truth = start.toGeodetic(1.4 * i, 0.0);
+        LocationFix fix(truth.latitude, truth.longitude, 1000 + i * 1000);
+        fix.accuracy = 5.0;
+        kf_->update(fix);
+        EXPECT_EQ(kf_->lastOutcome(), FixOutcome::Accepted);
+    }
+    
+    GeodeticPoint spike = start.toGeodetic(1.4 * 20, 150.0);
+    LocationFix fix(spike.latitude, spike.longitude, 21000);
+    fix.accuracy = 5.0;
+    kf_->update(fix);
+    
+    EXPECT_EQ(kf_->lastOutcome(), FixOutcome::Gated);
+    EXPECT_GT(kf_->lastInnovationDistance(), chiSquareGate(2));
+    EXPECT_EQ(kf_->counters().gated_fixes, 1u);
+    EXPECT_EQ(kf_->counters().accepted_fixes, 20u);
+    
+    // Predicted along the path, not pulled toward the spike
+    WorldState state = kf_->getSmoothedState();
+    EnuPoint position = start.toEnu(state.smoothed_lat, state.smoothed_lon);
+    EXPECT_NEAR(position.east, 1.4 * 20, 2.0);
+    EXPECT_NEAR(position.north, 0.0, 2.0);
+    EXPECT_EQ(state.last_update_ms, 21000);
+}
+
+TEST_F(KalmanFilterTest, RestartsAfterConsecutiveRejectionsTest) {
+    LocalTangentFrame start(37.7749, -122.4194);
+    for (int i = 0; i < 20; ++i) {
+        LocationFix fix(37.7749, -122.4194, 1000 + i * 1000);
+        fix.accuracy = 5.0;
+        kf_->update(fix);
+    }
+    
+    // A real 2 km jump (e.g. a cold start after a tunnel): gated, then taken
+    GeodeticPoint moved = start.toGeodetic(2000.0, 0.0);
+    uint32_t max_rejections = kf_->tuning().max_consecutive_rejections;
+    for (uint32_t i = 0; i <= max_rejections; ++i) {
+        LocationFix fix(moved.latitude, moved.longitude, 21000 + i * 1000);
+        fix.accuracy = 5.0;
+        kf_->update(fix);
+        EXPECT_EQ(kf_->lastOutcome(), i < max_rejections ? FixOutcome::Gated : FixOutcome::Reinitialized);
+    }
+    EXPECT_EQ(kf_->counters().gated_fixes, max_rejections);
+    EXPECT_EQ(kf_->counters().reinitializations, 1u);
+    
+    WorldState state = kf_->getSmoothedState();
+    EXPECT_NEAR(state.smoothed_lat, moved.latitude, 1e-5);
+    EXPECT_NEAR(state.smoothed_lon, moved.longitude, 1e-5);
+    EXPECT_DOUBLE_EQ(state.velocity_east_mps, 0.0);
+    
+    // Tracking resumes from the new position
+    LocationFix fix(moved.latitude, moved.longitude, 40000);
+    fix.accuracy = 5.0;
+    kf_->update(fix);
+    EXPECT_EQ(kf_->lastOutcome(), FixOutcome::Accepted);
+}
+
+TEST_F(KalmanFilterTest, GateDisabledTest) {
+    KalmanTuning tuning;
+    tuning.gate_threshold = -1.0;
+    kf_->setTuning(tuning);
+    
+    kf_->update(LocationFix(37.7749, -122.4194, 1000));
+    kf_->update(LocationFix(37.7749, -122.4194, 2000));
+    kf_->update(LocationFix(37.8749, -122.4194, 3000));
+    EXPECT_EQ(kf_->lastOutcome(), FixOutcome::Accepted);
+    EXPECT_EQ(kf_->counters().accepted_fixes, 3u);
+}
+
+TEST(KalmanVelocityTest, SpeedAndCourseConvergeFasterTest) {
+    // 15 m/s on a 60 degree course, 5 m position noise; Doppler 0.3 m/s and 2 degrees
+    const double speed = 15.0, course = 60.0 * std::numbers::pi / 180.0;
+    const double velocity_east = speed * std::sin(course), velocity_north = speed * std::cos(course);
+    std::mt19937 rng(5);
+    std::normal_distribution<double> position_noise(0.0, 5.0), speed_noise(0.0, 0.3), course_noise(0.0, 2.0);
+    LocalTangentFrame start(37.7749, -122.4194);
+    
+    KalmanFilter position_only, fused;
+    for (int i = 0; i < 3; ++i) {
+        GeodeticPoint measured = start.toGeodetic(velocity_east * i + position_noise(rng),
+                                                  velocity_north * i + position_noise(rng));
+        LocationFix fix(measured.latitude, measured.longitude, 1000 + i * 1000);
+        fix.accuracy = 5.0;
+        position_only.update(fix);
+        
+        fix.speed = speed + speed_noise(rng);
+        fix.heading = 60.0 + course_noise(rng);
+        fix.speed_accuracy = 0.3;
+        fix.heading_accuracy = 2.0;
+        fix.measured = LocationFix::HAS_SPEED | LocationFix::HAS_HEADING;
+        fused.update(fix);
+        EXPECT_EQ(fused.lastOutcome(), FixOutcome::Accepted);
+    }
+    
+    auto velocityError = [&](const KalmanFilter& filter) {
+        return std::hypot(filter.state()(2) - velocity_east, filter.state()(3) - velocity_north);
+    };
+    EXPECT_LT(velocityError(fused), 1.0);
+    EXPECT_GT(velocityError(position_only), 2.0 * velocityError(fused));
+    EXPECT_EQ(fused.counters().velocity_corrections, 3u);
+    EXPECT_EQ(position_only.counters().velocity_corrections, 0u);
+}
+
+TEST(KalmanVelocityTest, CourseWrapsAtNorthTest) {
+    // Heading north at 10 m/s; course alone, reported either side of 0/360
+    LocalTangentFrame start(37.7749, -122.4194);
+    KalmanFilter filter;
+    for (int i = 0; i < 30; ++i) {
+        GeodeticPoint at = start.toGeodetic(0.0, 10.0 * i);
+        LocationFix fix(at.latitude, at.longitude, 1000 + i * 1000);
+        fix.accuracy = 5.0;
+        fix.heading = i % 2 ? 358.0 : 2.0;
+        fix.heading_accuracy = 3.0;
+        fix.measured = LocationFix::HAS_HEADING;
+        filter.update(fix);
+    }
+    EXPECT_NEAR(filter.state()(2), 0.0, 0.3);
+    EXPECT_NEAR(filter.state()(3), 10.0, 0.3);
+    EXPECT_GT(filter.counters().velocity_corrections, 25u);
+    EXPECT_EQ(filter.counters().gated_velocity, 0u);
+}
+
+TEST(KalmanVelocityTest, SpeedAloneCorrectsMagnitudeTest) {
+    // Positions say 10 m/s east; the receiver's Doppler says 12
+    LocalTangentFrame start(37.7749, -122.4194);
+    KalmanFilter filter;
+    filter.setMeasurementNoise(400.0);
+    for (int i = 0; i < 10; ++i) {
+        GeodeticPoint at = start.toGeodetic(10.0 * i, 0.0);
+        LocationFix fix(at.latitude, at.longitude, 1000 + i * 1000);
+        fix.accuracy = 20.0;
+        fix.speed = 12.0;
+        fix.speed_accuracy = 0.2;
+        fix.measured = i < 5 ? 0 : LocationFix::HAS_SPEED;
+        filter.update(fix);
+    }
+    EXPECT_NEAR(std::hypot(filter.state()(2), filter.state()(3)), 12.0, 0.5);
+    EXPECT_NEAR(filter.state()(3), 0.0, 0.5);
+}
+
+TEST(KalmanVelocityTest, StoppedDopplerHoldsStillTest) {
+    // Standing with 10 m position noise: Doppler speed 0, course random
+    std::mt19937 rng(9);
+    std::normal_distribution<double> noise(0.0, 10.0);
+    std::uniform_real_distribution<double> course(0.0, 360.0);
+    LocalTangentFrame start(37.7749, -122.4194);
+    KalmanFilter position_only, fused;
+    double position_only_speed = 0.0, fused_speed = 0.0;
+    for (int i = 0; i < 60; ++i) {
+        GeodeticPoint measured = start.toGeodetic(noise(rng), noise(rng));
+        LocationFix fix(measured.latitude, measured.longitude, 1000 + i * 1000);
+        position_only.update(fix);
+        
+        fix.heading = course(rng);
+        fix.measured = LocationFix::HAS_SPEED | LocationFix::HAS_HEADING;
+        fused.update(fix);
+        if (i >= 10) {
+            position_only_speed = std::max(position_only_speed, std::hypot(position_only.state()(2), position_only.state()(3)));
+            fused_speed = std::max(fused_speed, std::hypot(fused.state()(2), fused.state()(3)));
+        }
+    }
+    EXPECT_LT(fused_speed, 0.2);
+    EXPECT_GT(position_only_speed, 1.0);
+    EXPECT_FALSE(fused.getSmoothedState().is_moving);
+}
+
+TEST(KalmanVelocityTest, TuningSelectsMeasurementsTest) {
+    KalmanFilter filter;
+    KalmanTuning tuning;
+    tuning.velocity_measurements = LocationFix::HAS_HEADING;
+    filter.setTuning(tuning);
+    
+    // Speed is masked out and a lone course cannot orient a stationary filter
+    LocationFix fix(37.7749, -122.4194, 1000);
+    fix.speed = 5.0;
+    fix.heading = 90.0;
+    fix.measured = LocationFix::HAS_SPEED | LocationFix::HAS_HEADING;
+    filter.update(fix);
+    EXPECT_EQ(filter.counters().velocity_corrections, 0u);
+    EXPECT_DOUBLE_EQ(filter.state()(2), 0.0);
+}
+
+TEST(KalmanTuningTest, AdaptiveMeasurementNoiseTest) {
+    // Fixes claim 3 m but scatter with 15 m std: a fixed R gates the tail
+    auto run = [](bool adaptive) {
+        KalmanFilter kf;
+        KalmanTuning tuning;
+        tuning.adaptive_measurement_noise = adaptive;
+        kf.setTuning(tuning);
+        
+        std::mt19937 rng(7);
+        std::normal_distribution<double> noise(0.0, 15.0);
+        LocalTangentFrame start(37.7749, -122.4194);
+        for (int i = 0; i < 600; ++i) {
+            GeodeticPoint measured = start.toGeodetic(0.7 * i + noise(rng), noise(rng));
+            LocationFix fix(measured.latitude, measured.longitude, 1000 + i * 500);
+            fix.accuracy = 3.0;
+            kf.update(fix);
+        }
+        return kf.counters();
+    };
+    
+    KalmanCounters fixed = run(false);
+    KalmanCounters adaptive = run(true);
+    EXPECT_GT(fixed.gated_fixes, 10u);
+    EXPECT_LT(adaptive.gated_fixes, fixed.gated_fixes / 4);
+    EXPECT_EQ(adaptive.reinitializations, 0u);
+}
+
+TEST(ImuPreintegratorTest, ConstantTurnTest) {
+    // 2 m/s^2 forward while turning at 0.5 rad/s for 1 s, sampled at 400 Hz
+    const double accel = 2.0, rate = 0.5, T = 1.0;
+    ImuPreintegrator imu;
+    for (int k = 0; k <= 400; ++k) {
+        imu.add({k * 2500, accel, 0.0, 9.81, 0.0, 0.0, rate});
+    }
+    ASSERT_EQ(imu.delta().samples, 400u);
+    ImuDelta delta = imu.take();
+    EXPECT_TRUE(imu.empty());
+    
+    // Closed form: v = a/w (sin wT, 1 - cos wT), p = a/w^2 (1 - cos wT, wT - sin wT)
+    EXPECT_NEAR(delta.duration_s, T, 1e-12);
+    EXPECT_NEAR(delta.delta_heading_rad, rate * T, 1e-9);
+    EXPECT_NEAR(delta.delta_velocity[0], accel / rate * std::sin(rate * T), 2e-3);
+    EXPECT_NEAR(delta.delta_velocity[1], accel / rate * (1.0 - std::cos(rate * T)), 2e-3);
+    EXPECT_NEAR(delta.delta_position[0], accel / (rate * rate) * (1.0 - std::cos(rate * T)), 2e-3);
+    EXPECT_NEAR(delta.delta_position[1], accel / (rate * rate) * (rate * T - std::sin(rate * T)), 2e-3);
+    
+    // White noise: var(v) = q T, var(p) = q T^3 / 3
+    double q = 0.5 * 0.5;
+    EXPECT_NEAR(delta.velocity_variance, q * T, 1e-9);
+    EXPECT_NEAR(delta.position_variance, q * T * T * T / 3.0, 1e-6);
+    
+    // The next batch continues from the last sample
+    imu.add({1002500, 0.0, 0.0, 9.81, 0.0, 0.0, 0.0});
+    EXPECT_EQ(imu.delta().samples, 1u);
+    EXPECT_NEAR(imu.delta().duration_s, 0.0025, 1e-12);
+}
+
+TEST(ImuFusionTest, NoHeadingMatchesGpsOnlyTest) {
+    // Standing still: no course, so the IMU batches cannot be rotated and only advance time
+    KalmanFilter with_imu, gps_only;
+    for (int second = 1; second <= 10; ++second) {
+        LocationFix fix(37.7749, -122.4194, second * 1000);
+        fix.accuracy = 5.0;
+        with_imu.update(fix);
+        gps_only.update(fix);
+        if (second == 10) break;
+        
+        // 200 Hz from the fix to 50 ms short of the next one, flushed every 100 ms like the service
+        ImuPreintegrator imu;
+        for (int k = 0; k <= 190; ++k) {
+            imu.add({second * 1000000LL + k * 5000, 0.0, 0.0, 9.81, 0.0, 0.0, 0.0});
+            if (k % 20 == 0 || k == 190) {
+                with_imu.predictImu(imu.take());
+            }
+        }
+    }
+    
+    EXPECT_TRUE(with_imu.covariance().isApprox(gps_only.covariance(), 1e-9))
+        << with_imu.covariance() << "\nvs\n" << gps_only.covariance();
+    EXPECT_LT((with_imu.state() - gps_only.state()).norm(), 1e-9);
+}
+
+TEST_F(KalmanFilterTest, ImuFillsBetweenFixesTest) {
+    // Circling at 6 m/s and 0.2 rad/s; GPS at 1 Hz with 4 m noise, IMU at 200 Hz
+    const double speed = 6.0, rate = 0.2, radius = speed / rate;
+    std::mt19937 rng(11);
+    std::normal_distribution<double> gps_noise(0.0, 4.0);
+    std::normal_distribution<double> accel_noise(0.0, 0.3);
+    LocalTangentFrame start(37.7749, -122.4194);
+    auto truthAt = [&](double t) {
+        return EnuPoint{radius * std::sin(rate * t), radius * (1.0 - std::cos(rate * t)), 0.0};
+    };
+    
+    KalmanFilter gps_only;
+    ImuPreintegrator imu;
+    double fused_sq = 0.0, gps_only_sq = 0.0;
+    int checks = 0;
+    for (int second = 0; second < 120; ++second) {
+        for (int half = 0; half < 2; ++half) {
+            // IMU up to the half second: body frame, centripetal acceleration to the left
+            for (int k = 1; k <= 100; ++k) {
+                int64_t t_us = (second * 1000000LL) + (half * 100 + k) * 5000;
+                imu.add({t_us, accel_noise(rng), speed * rate + accel_noise(rng), 9.81, 0.0, 0.0, rate});
+            }
+            kf_->predictImu(imu.take());
+            if (half == 1) {
+                double t = second + 1.0;
+                EnuPoint truth = truthAt(t);
+                GeodeticPoint measured = start.toGeodetic(truth.east + gps_noise(rng), truth.north + gps_noise(rng));
+                LocationFix fix(measured.latitude, measured.longitude, static_cast<int64_t>(t * 1000));
+                fix.accuracy = 4.0;
+                kf_->update(fix);
+                gps_only.update(fix);
+            }
+            
+            // Score after the heading has settled, at fixes and halfway between
+            if (second < 20) continue;
+            double t = second + 0.5 * (half + 1);
+            EnuPoint truth = truthAt(t);
+            WorldState fused = kf_->getSmoothedState();
+            WorldState held = gps_only.getSmoothedState();
+            EnuPoint f = start.toEnu(fused.smoothed_lat, fused.smoothed_lon);
+            EnuPoint g = start.toEnu(held.smoothed_lat, held.smoothed_lon);
+            fused_sq += std::pow(f.east - truth.east, 2) + std::pow(f.north - truth.north, 2);
+            gps_only_sq += std::pow(g.east - truth.east, 2) + std::pow(g.north - truth.north, 2);
+            ++checks;
+        }
+    }
+    double fused_rms = std::sqrt(fused_sq / checks);
+    double gps_only_rms = std::sqrt(gps_only_sq / checks);
+    std::cout << "[ImuFusion] RMS error " << fused_rms << " m fused, " << gps_only_rms << " m GPS only" << std::endl;
+    EXPECT_LT(fused_rms, 0.5 * gps_only_rms);
+    EXPECT_LT(fused_rms, 3.0);
+}
+
+TEST(StationaryDetectorTest, SettlesAndWakesOnImuTest) {
+    // 100 Hz: 5 s on a table (sensor noise only), then walking
+    std::mt19937 rng(3);
+    std::normal_distribution<double> accel_noise(0.0, 0.05), gyro_noise(0.0, 0.01);
+    StationaryDetector detector;
+    int64_t t_us = 1'000'000'000'000;
+    for (int k = 0; k < 500; ++k, t_us += 10'000) {
+        EXPECT_FALSE(detector.addImu({t_us, accel_noise(rng), accel_noise(rng), 9.81 + accel_noise(rng),
+                                      gyro_noise(rng), gyro_noise(rng), gyro_noise(rng)}));
+        EXPECT_EQ(detector.stationary(t_us / 1000), k >= 300) << "sample " << k;
+    }
+    
+    // First steps: a 2 Hz, 3 m/s^2 bounce is picked up within a tenth of a second
+    int woke_at = -1;
+    for (int k = 0; k < 50 && woke_at < 0; ++k, t_us += 10'000) {
+        double bounce = 3.0 * std::sin(2.0 * std::numbers::pi * 2.0 * k * 0.01);
+        if (detector.addImu({t_us, 0.0, 0.0, 9.81 + bounce, 0.0, 0.0, 0.0})) woke_at = k;
+    }
+    EXPECT_GE(woke_at, 0);
+    EXPECT_LT(woke_at, 10);
+    EXPECT_FALSE(detector.stationary(t_us / 1000));
+}
+
+TEST(StationaryDetectorTest, SpeedOnlyTest) {
+    StationaryDetector detector;
+    for (int i = 0; i <= 3; ++i) {
+        EXPECT_FALSE(detector.addSpeed(0.1, 1000 + i * 1000));
+    }
+    EXPECT_TRUE(detector.stationary(4000));
+    EXPECT_TRUE(detector.addSpeed(2.0, 5000));
+    EXPECT_FALSE(detector.stationary(5000));
+    
+    // A gated fix restarts the clock without further moving evidence
+    detector.addSpeed(0.0, 6000);
+    detector.addSpeed(0.0, 9000);
+    EXPECT_TRUE(detector.stationary(9000));
+    EXPECT_TRUE(detector.markMoving(9500));
+    detector.addSpeed(0.0, 12000);
+    EXPECT_FALSE(detector.stationary(12000));
+    detector.addSpeed(0.0, 12500);
+    EXPECT_TRUE(detector.stationary(12500));
+}
+
+TEST(StationaryDetectorTest, SilenceIsNotRestTest) {
+    // GPS outage on a track without an IMU: one still fix, then nothing
+    StationaryDetector detector;
+    detector.addSpeed(0.0, 1000);
+    EXPECT_FALSE(detector.stationary(4000));
+    EXPECT_FALSE(detector.stationary(10000));
+    
+    // Settled, then the fixes stop: the period ends once the evidence is stale
+    for (int64_t t = 20000; t <= 23000; t += 1000) {
+        detector.addSpeed(0.0, t);
+    }
+    EXPECT_TRUE(detector.stationary(23000));
+    EXPECT_TRUE(detector.stationary(23000 + StationaryDetector::EVIDENCE_TIMEOUT_MS));
+    EXPECT_FALSE(detector.stationary(23001 + StationaryDetector::EVIDENCE_TIMEOUT_MS));
+    
+    // Fixes resume still: a fresh SETTLE_MS is needed
+    detector.addSpeed(0.0, 30000);
+    EXPECT_FALSE(detector.stationary(30000));
+    detector.addSpeed(0.0, 33000);
+    EXPECT_TRUE(detector.stationary(33000));
+}
+
+namespace {
+
+/**
+ * @brief 200 Hz walk: a heel-strike bump in |accel| per step plus sway and noise
+ */
+std::vector<ImuSample> simulateWalk(double seconds, double steps_per_minute, double bounce,
+                                    int64_t start_us, std::mt19937& rng) {
+    std::normal_distribution<double> noise(0.0, 0.3);
+    std::vector<ImuSample> samples;
+    double step_hz = steps_per_minute / 60.0;
+    for (int k = 0; k < seconds * 200; ++k) {
+        double t = k / 200.0;
+        double phase = 2.0 * std::numbers::pi * step_hz * t;
+        double vertical = bounce * (std::sin(phase) + 0.3 * std::sin(2.0 * phase));
+        double sway = 0.5 * bounce * std::sin(0.5 * phase);
+        samples.push_back({start_us + k * 5000, noise(rng), sway + noise(rng), 9.81 + vertical + noise(rng),
+                           0.0, 0.0, 0.0});
+    }
+    return samples;
+}
+
+} // namespace
+
+TEST(StepDetectorTest, CountsWalkAndCadenceTest) {
+    std::mt19937 rng(5);
+    std::vector<ImuSample> walk = simulateWalk(30.0, 108.0, 3.0, 1'000'000, rng);
+    StepDetector detector;
+    std::vector<StepEvent> events;
+    // Uneven chunks, as a sensor HAL delivers them
+    for (size_t start = 0; start < walk.size(); start += 37) {
+        size_t n = std::min<size_t>(37, walk.size() - start);
+        detector.process(std::span(walk).subspan(start, n), events);
+    }
+    EXPECT_NEAR(static_cast<double>(detector.stepCount()), 54.0, 2.0);
+    EXPECT_EQ(events.size(), detector.stepCount());
+    EXPECT_NEAR(detector.cadence(), 108.0, 5.0);
+    for (size_t i = 1; i < events.size(); ++i) {
+        EXPECT_GE(events[i].timestamp_us - events[i - 1].timestamp_us, 250'000);
+        EXPECT_GT(events[i].peak_accel, 9.81);
+    }
+    
+    // The structure-of-arrays entry point finds the same steps
+    std::vector<int64_t> timestamps;
+    std::vector<double> ax, ay, az;
+    for (const ImuSample& sample : walk) {
+        timestamps.push_back(sample.timestamp_us);
+        ax.push_back(sample.accel_x);
+        ay.push_back(sample.accel_y);
+        az.push_back(sample.accel_z);
+    }
+    StepDetector soa;
+    std::vector<StepEvent> soa_events;
+    EXPECT_EQ(soa.process(timestamps, ax, ay, az, soa_events), events.size());
+    ASSERT_EQ(soa_events.size(), events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        EXPECT_EQ(soa_events[i].timestamp_us, events[i].timestamp_us);
+    }
+    
+    // The filter counts them only with PDR enabled
+    KalmanFilter filter;
+    filter.addSteps(static_cast<uint32_t>(events.size()));
+    EXPECT_EQ(filter.getSmoothedState().step_count, 0u);
+    filter.enablePDR(true);
+    filter.addSteps(static_cast<uint32_t>(events.size()));
+    EXPECT_EQ(filter.getSmoothedState().step_count, events.size());
+}
+
+TEST(StepDetectorTest, IgnoresStillAndStopsCadenceTest) {
+    std::mt19937 rng(6);
+    std::normal_distribution<double> noise(0.0, 0.3);
+    StepDetector detector;
+    std::vector<StepEvent> events;
+    std::vector<ImuSample> still;
+    for (int k = 0; k < 2000; ++k) {
+        still.push_back({k * 5000, noise(rng), noise(rng), 9.81 + noise(rng), 0.0, 0.0, 0.0});
+    }
+    EXPECT_EQ(detector.process(still, events), 0u);
+    
+    // Walk, then stand: cadence drops to 0 once MAX_STEP_INTERVAL_S passes
+    detector.process(simulateWalk(10.0, 120.0, 3.0, 10'000'000, rng), events);
+    EXPECT_NEAR(detector.cadence(), 120.0, 5.0);
+    for (ImuSample& sample : still) {
+        sample.timestamp_us += 20'000'000;
+    }
+    size_t walked = events.size();
+    EXPECT_EQ(detector.process(still, events), 0u);
+    EXPECT_EQ(events.size(), walked);
+    EXPECT_EQ(detector.cadence(), 0.0);
+}
+
+TEST(StepDetectorTest, AdaptsToSofterStepsTest) {
+    // Brisk steps, then soft ones a fixed threshold tuned for the first would miss
+    std::mt19937 rng(7);
+    StepDetector detector;
+    std::vector<StepEvent> events;
+    detector.process(simulateWalk(20.0, 120.0, 5.0, 1'000'000, rng), events);
+    EXPECT_NEAR(static_cast<double>(events.size()), 40.0, 2.0);
+    
+    events.clear();
+    detector.process(simulateWalk(20.0, 90.0, 1.2, 21'000'000, rng), events);
+    // The first few are missed while the statistics settle (STATS_TIME_CONSTANT_S)
+    EXPECT_GE(events.size(), 24u);
+    EXPECT_LE(events.size(), 31u);
+    size_t settled = 0;
+    for (const StepEvent& event : events) {
+        if (event.timestamp_us >= 26'000'000) settled++;
+    }
+    EXPECT_NEAR(static_cast<double>(settled), 22.5, 1.5);
+}
+
+TEST_F(KalmanFilterTest, ZeroVelocityUpdateTest) {
+    // Noisy fixes around a parked position leave a spurious velocity; ZUPT removes it
+    std::mt19937 rng(4);
+    std::normal_distribution<double> noise(0.0, 10.0);
+    LocalTangentFrame start(37.7749, -122.4194);
+    for (int i = 0; i < 30; ++i) {
+        GeodeticPoint measured = start.toGeodetic(noise(rng), noise(rng));
+        kf_->update(LocationFix(measured.latitude, measured.longitude, 1000 + i * 1000));
+    }
+    double velocity_variance = kf_->covariance()(2, 2);
+    kf_->correctZeroVelocity(0.05);
+    EXPECT_LT(std::hypot(kf_->state()(2), kf_->state()(3)), 0.05);
+    EXPECT_LT(kf_->covariance()(2, 2), 0.01 * velocity_variance);
+    EXPECT_FALSE(kf_->getSmoothedState().is_moving);
+    
+    // Position is kept, only refined through the position/velocity correlation
+    WorldState state = kf_->getSmoothedState();
+    EnuPoint position = start.toEnu(state.smoothed_lat, state.smoothed_lon);
+    EXPECT_LT(std::hypot(position.east, position.north), 10.0);
+}
+
+TEST(AltitudeKalmanFilterTest, TracksAltitudeTest) {
+    AltitudeKalmanFilter kf;
+    for (int i = 0; i < 20; ++i) {
+        LocationFix fix(37.7749, -122.4194, 1000 + i * 100);
+        fix.altitude = 50.0 + i * 0.5;
+        kf.update(fix);
+    }
+    
+    WorldState state = kf.getSmoothedState();
+    EXPECT_NEAR(state.smoothed_lat, 37.7749, 1e-5);
+    EXPECT_NEAR(state.smoothed_lon, -122.4194, 1e-5);
+    EXPECT_NEAR(state.smoothed_altitude, 59.5, 1.0);
+    EXPECT_GT(kf.state()(5), 0.0);  // Climbing
+}
+
+TEST(KalmanBatchTest, MatchesScalarFilterTest) {
+    const uint32_t TRACKS = 37;  // Not a multiple of any lane width
+    
+    for (SimdPath path : {SimdPath::Scalar, SimdPath::AVX2, SimdPath::AVX512}) {
+        KalmanBatch batch;
+        if (!batch.setSimdPath(path)) continue;
+        SCOPED_TRACE(simdPathName(path));
+        
+        std::vector<KalmanFilter> filters(TRACKS);
+        for (uint32_t t = 0; t < TRACKS; ++t) {
+            EXPECT_EQ(batch.addTrack(), t);
+        }
+        
+        for (int tick = 0; tick < 30; ++tick) {
+            // Alternate whole-fleet ticks (in place) with sparse, shuffled ones (gathered)
+            std::vector<uint32_t> tracks;
+            for (uint32_t t = 0; t < TRACKS; ++t) {
+                uint32_t track = tick % 2 == 0 ? t : (t * 7 + tick) % TRACKS;
+                if (tick % 2 == 0 || track % 3 != 0) tracks.push_back(track);
+            }
+            
+            std::vector<LocationFix> fixes;
+            for (uint32_t track : tracks) {
+                LocationFix fix(37.7749 + track * 0.001 + tick * 0.0001,
+                                -122.4194 - tick * 0.0005, 1000 + tick * 100 + track);  // ~1 km: re-anchors
+                fix.accuracy = 3.0 + (track + tick) % 15;
+                if (track == 5 && tick == 12) {
+                    fix.latitude += 0.01;  // One spike: gated
+                } else if (track == 8 && tick >= 14) {
+                    fix.longitude += 0.05;  // Jumps for good: gated, then restarted
+                }
+                fixes.push_back(fix);
+                filters[track].update(fix);
+            }
+            batch.update(tracks, fixes);
+        }
+        
+        KalmanCounters expected;
+        for (const KalmanFilter& filter : filters) {
+            expected.accepted_fixes += filter.counters().accepted_fixes;
+            expected.gated_fixes += filter.counters().gated_fixes;
+            expected.reinitializations += filter.counters().reinitializations;
+        }
+        EXPECT_EQ(batch.counters().accepted_fixes, expected.accepted_fixes);
+        EXPECT_EQ(batch.counters().gated_fixes, expected.gated_fixes);
+        EXPECT_EQ(batch.counters().reinitializations, expected.reinitializations);
+        EXPECT_GE(expected.gated_fixes, 4u);
+        EXPECT_EQ(expected.reinitializations, 1u);
+        
+        for (uint32_t t = 0; t < TRACKS; ++t) {
+            EXPECT_TRUE(batch.state(t).isApprox(filters[t].state(), 1e-9)) << "track " << t;
+            EXPECT_TRUE(batch.covariance(t).isApprox(filters[t].covariance(), 1e-9)) << "track " << t;
+            EXPECT_EQ(batch.getSmoothedState(t).last_update_ms,
+                      filters[t].getSmoothedState().last_update_ms);
+        }
+    }
+}
+
+TEST(TrajectorySmootherTest, MatchesDenseReferenceTest) {
+    // Textbook forward filter and RTS backward pass, ungated, within one frame
+    std::vector<LocationFix> fixes;
+    for (int i = 0; i < 50; ++i) {
+        LocationFix fix(37.7749 + i * 0.0001, -122.4194 + (i % 3) * 0.00005, 1000 + i * 150);
+        fix.accuracy = 5.0 + i % 20;
+        fixes.push_back(fix);
+    }
+    TrajectorySmoother smoother;
+    KalmanTuning tuning;
+    tuning.gate_threshold = -1.0;
+    smoother.setTuning(tuning);
+    std::vector<SmoothedFix> smoothed;
+    smoother.smooth(fixes, smoothed);
+    ASSERT_EQ(smoothed.size(), fixes.size());
+    
+    Eigen::Matrix4d A = Eigen::Matrix4d::Identity();
+    Eigen::Matrix<double, 2, 4> H = Eigen::Matrix<double, 2, 4>::Zero();
+    H(0, 0) = H(1, 1) = 1.0;
+    Eigen::Matrix4d Q = Eigen::Matrix4d::Identity() * 0.1;
+    Q(0, 0) *= 0.001;
+    Q(1, 1) *= 0.001;
+    Eigen::Vector4d x = Eigen::Vector4d::Zero();
+    Eigen::Matrix4d P = Eigen::Matrix4d::Identity() * 1e6;
+    LocalTangentFrame frame(fixes[0].latitude, fixes[0].longitude);
+    
+    std::vector<Eigen::Vector4d> x_filtered, x_predicted;
+    std::vector<Eigen::Matrix4d> P_filtered, P_predicted;
+    for (size_t i = 0; i < fixes.size(); ++i) {
+        A(0, 2) = A(1, 3) = i == 0 ? 0.1 : 0.15;
+        x = A * x;
+        P = A * P * A.transpose() + Q;
+        x_predicted.push_back(x);
+        P_predicted.push_back(P);
+        Eigen::Matrix2d R = Eigen::Matrix2d::Identity() * std::max(100.0, fixes[i].accuracy * fixes[i].accuracy);
+        Eigen::Matrix<double, 4, 2> K = P * H.transpose() * (H * P * H.transpose() + R).inverse();
+        EnuPoint z = frame.toEnu(fixes[i].latitude, fixes[i].longitude);
+        x = x + K * (Eigen::Vector2d(z.east, z.north) - H * x);
+        P = (Eigen::Matrix4d::Identity() - K * H) * P;
+        x_filtered.push_back(x);
+        P_filtered.push_back(P);
+    }
+    
+    A(0, 2) = A(1, 3) = 0.15;
+    Eigen::Vector4d x_smoothed = x_filtered.back();
+    for (size_t i = fixes.size(); i-- > 0;) {
+        if (i + 1 < fixes.size()) {
+            Eigen::Matrix4d C = P_filtered[i] * A.transpose() * P_predicted[i + 1].inverse();
+            x_smoothed = x_filtered[i] + C * (x_smoothed - x_predicted[i + 1]);
+        }
+        GeodeticPoint expected = frame.toGeodetic(x_smoothed(0), x_smoothed(1));
+        EXPECT_NEAR(smoothed[i].latitude, expected.latitude, 1e-10) << "fix " << i;
+        EXPECT_NEAR(smoothed[i].longitude, expected.longitude, 1e-10) << "fix " << i;
+        EXPECT_NEAR(smoothed[i].velocity_east_mps, x_smoothed(2), 1e-6) << "fix " << i;
+        EXPECT_NEAR(smoothed[i].velocity_north_mps, x_smoothed(3), 1e-6) << "fix " << i;
+        EXPECT_EQ(smoothed[i].timestamp_ms, fixes[i].timestamp_ms);
+    }
+}
+
+TEST(TrajectorySmootherTest, BeatsForwardFilterTest) {
+    // 5 m/s with a 90 degree turn every 100 s, 5 m GPS noise, across re-anchors
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 5.0);
+    LocalTangentFrame start(37.7749, -122.4194);
+    std::vector<LocationFix> fixes;
+    std::vector<EnuPoint> truth;
+    double east = 0.0, north = 0.0, velocity_east = 5.0, velocity_north = 0.0;
+    for (int i = 0; i < 2000; ++i) {
+        if (i % 100 == 50) {
+            std::swap(velocity_east, velocity_north);
+            velocity_east = -velocity_east;
+        }
+        east += velocity_east;
+        north += velocity_north;
+        GeodeticPoint measured = start.toGeodetic(east + noise(rng), north + noise(rng));
+        LocationFix fix(measured.latitude, measured.longitude, 1000 + i * 1000);
+        fix.accuracy = 5.0;
+        fixes.push_back(fix);
+        truth.push_back({east, north, 0.0});
+    }
+    
+    KalmanFilter filter;
+    TrajectorySmoother smoother;
+    std::vector<SmoothedFix> smoothed;
+    smoother.smooth(fixes, smoothed);
+    
+    double forward_sq = 0.0, smoothed_sq = 0.0;
+    for (size_t i = 0; i < fixes.size(); ++i) {
+        filter.update(fixes[i]);
+        WorldState state = filter.getSmoothedState();
+        EnuPoint f = start.toEnu(state.smoothed_lat, state.smoothed_lon);
+        EnuPoint s = start.toEnu(smoothed[i].latitude, smoothed[i].longitude);
+        forward_sq += std::pow(f.east - truth[i].east, 2) + std::pow(f.north - truth[i].north, 2);
+        smoothed_sq += std::pow(s.east - truth[i].east, 2) + std::pow(s.north - truth[i].north, 2);
+    }
+    double forward_rms = std::sqrt(forward_sq / fixes.size());
+    double smoothed_rms = std::sqrt(smoothed_sq / fixes.size());
+    EXPECT_LT(smoothed_rms, 0.7 * forward_rms);
+    EXPECT_LT(smoothed_rms, 4.0);
+}
+
+TEST(TrajectorySmootherTest, SplitsAtRestartTest) {
+    // Standing still, then a 2 km jump the gate restarts on
+    LocalTangentFrame start(37.7749, -122.4194);
+    GeodeticPoint moved = start.toGeodetic(2000.0, 0.0);
+    std::vector<LocationFix> fixes;
+    for (int i = 0; i < 40; ++i) {
+        GeodeticPoint at = i < 20 ? start.anchorPoint() : moved;
+        LocationFix fix(at.latitude, at.longitude, 1000 + i * 1000);
+        fix.accuracy = 5.0;
+        fixes.push_back(fix);
+    }
+    TrajectorySmoother smoother;
+    std::vector<SmoothedFix> smoothed;
+    smoother.smooth(fixes, smoothed);
+    
+    size_t restart = 20 + KalmanTuning{}.max_consecutive_rejections;
+    EXPECT_EQ(smoothed[restart].outcome, FixOutcome::Reinitialized);
+    EXPECT_EQ(smoothed[20].outcome, FixOutcome::Gated);
+    for (size_t i = 0; i < restart; ++i) {
+        // Gated fixes are bridged by the old segment, not pulled toward the jump
+        EXPECT_NEAR(start.toEnu(smoothed[i].latitude, smoothed[i].longitude).east, 0.0, 1.0) << "fix " << i;
+    }
+    for (size_t i = restart; i < fixes.size(); ++i) {
+        EXPECT_NEAR(start.toEnu(smoothed[i].latitude, smoothed[i].longitude).east, 2000.0, 1.0) << "fix " << i;
+    }
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
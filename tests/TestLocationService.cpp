@@ -0,0 +1,128 @@
+/**
+ * @file TestLocationService.cpp
+ * @brief Service loop tests for the location daemon
+ */
+
+#include "IPCCommandRing.hpp"
+#include "IPCManager.hpp"
+#include "IPCReader.hpp"
+#include "IPCStats.hpp"
+#include "LocationService.hpp"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace s2sgeo;
+
+namespace {
+
+/**
+ * @brief Context provider that only counts its fetches
+ */
+class CountingProvider : public IContextProvider {
+public:
+    void initialize(const std::string&) override {}
+    
+    ContextFrame getContext(double, double) override {
+        fetches++;
+        return ContextFrame{};
+    }
+    
+    void prefetchContext(double, double, double, double) override {}
+    
+    std::string getName() const override { return "counting"; }
+    
+    std::atomic<int> fetches = 0;
+};
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+uint64_t counter(StatCounter which) {
+    StatsSnapshot stats;
+    return IPCStats::snapshot(stats) ? stats.counter(which) : 0;
+}
+
+} // namespace
+
+class LocationServiceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        SharedMemoryManager::getInstance().cleanup();
+        ASSERT_TRUE(SharedMemoryManager::getInstance().initializeServer());
+    }
+    
+    void TearDown() override {
+        SharedMemoryManager::getInstance().cleanup();
+    }
+};
+
+TEST_F(LocationServiceTest, ForceRefreshOnStationaryTrackTest) {
+    CountingProvider provider;
+    LocationService service;
+    service.setContextProvider(&provider);
+    
+    // Parked for the last 4 s: Doppler says 0 m/s
+    int64_t now = nowMs();
+    for (int64_t t = now - 4000; t <= now; t += 500) {
+        LocationFix fix(37.7749, -122.4194, t);
+        fix.speed = 0.0;
+        fix.measured = LocationFix::HAS_SPEED;
+        service.injectFix("", fix);
+    }
+    
+    service.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_EQ(counter(StatCounter::StationaryPeriods), 1u);
+    int fetches = provider.fetches.load();
+    
+    // Still at rest: the refresh is served within a couple of active ticks, not the idle second
+    ASSERT_TRUE(IPCCommandRing::forceRefresh());
+    auto sent = std::chrono::steady_clock::now();
+    while (provider.fetches.load() == fetches &&
+           std::chrono::steady_clock::now() - sent < std::chrono::seconds(2)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(provider.fetches.load(), fetches + 1);
+    auto waited = std::chrono::steady_clock::now() - sent;
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(waited).count(), 500);
+    EXPECT_EQ(counter(StatCounter::StationaryPeriods), 1u);
+    
+    service.stop();
+}
+
+TEST_F(LocationServiceTest, DropsImuOnAnotherClockTest) {
+    LocationService service;
+    int64_t fix_ms = nowMs();
+    service.injectFix("", LocationFix(37.7749, -122.4194, fix_ms));
+    
+    // 100 ms at rest, 200 Hz, starting at `start_us`
+    auto still = [](int64_t start_us) {
+        std::vector<ImuSample> samples;
+        for (int64_t k = 0; k <= 20; ++k) {
+            samples.push_back({start_us + k * 5000, 0.0, 0.0, 9.81, 0.0, 0.0, 0.0});
+        }
+        return samples;
+    };
+    
+    // Microseconds since boot: must not drag the filter's clock back to 1970
+    service.injectImu("", still(5'000'000));
+    service.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    WorldState state;
+    ContextFrame context;
+    ASSERT_TRUE(IPCReader::readLatestState(state, context));
+    EXPECT_EQ(state.last_update_ms, fix_ms);
+    
+    // The same batch on the fixes' clock is applied
+    service.injectImu("", still(fix_ms * 1000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_TRUE(IPCReader::readLatestState(state, context));
+    EXPECT_EQ(state.last_update_ms, fix_ms + 100);
+    
+    service.stop();
+}
@@ -0,0 +1,315 @@
+/**
+ * @file TestReplication.cpp
+ * @brief Loopback tests for UDP ring replication
+ */
+
+#include "IPCManager.hpp"
+#include "IPCReader.hpp"
+#include "IPCReplication.hpp"
+#include "IPCWriter.hpp"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <boost/asio/ip/address.hpp>
+
+using namespace s2sgeo;
+using boost::asio::ip::udp;
+
+class ReplicationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        source_.cleanup();
+        replica_.cleanup();
+    }
+    
+    void TearDown() override {
+        source_.cleanup();
+        replica_.cleanup();
+    }
+    
+    /**
+     * @brief Publish update k on the source; the context changes every 50 updates
+     */
+    void publish(uint32_t k) {
+        WorldState state{};
+        state.smoothed_lat = 37.0 + k * 1e-5;
+        state.smoothed_lon = -122.0;
+        state.step_count = k;
+        state.last_update_ms = 1000 + k;
+        ContextFrame context{};
+        std::snprintf(context.road_name, sizeof(context.road_name), "Road %u", k / 50);
+        IPCWriter::writeState(state, context, source_);
+    }
+    
+    /**
+     * @brief Poll the receiver until it has republished `expected` records
+     */
+    void receive(ReplicationReceiver& receiver, uint64_t expected) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (receiver.stats().records < expected && std::chrono::steady_clock::now() < deadline) {
+            receiver.poll(std::chrono::milliseconds(10));
+        }
+    }
+    
+    udp::endpoint loopback(uint16_t port) {
+        return udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), port);
+    }
+    
+    SharedMemoryManager& source_ = SharedMemoryManager::getInstance("repl_source");
+    SharedMemoryManager& replica_ = SharedMemoryManager::getInstance("repl_replica");
+    boost::asio::io_context io_;
+};
+
+TEST_F(ReplicationTest, LoopbackRoundTripTest) {
+    ASSERT_TRUE(source_.initializeServer());
+    ASSERT_TRUE(replica_.initializeServer());
+    
+    ReplicationReceiver receiver(io_, loopback(0), replica_);
+    ReplicationSender sender(io_, loopback(receiver.port()), {}, source_);
+    
+    constexpr uint32_t COUNT = 500;
+    for (uint32_t k = 1; k <= COUNT; ++k) {
+        publish(k);
+        if (k % 100 == 0) sender.poll();
+    }
+    sender.flush();
+    receive(receiver, COUNT);
+    
+    EXPECT_EQ(sender.stats().records, COUNT);
+    EXPECT_EQ(sender.stats().lapped, 0u);
+    EXPECT_EQ(receiver.stats().records, COUNT);
+    EXPECT_EQ(receiver.stats().gaps, 0u);
+    EXPECT_EQ(receiver.stats().lost_packets, 0u);
+    EXPECT_EQ(receiver.stats().contexts, COUNT / 50 + 1);
+    EXPECT_TRUE(IPCReader::isLocationServiceAlive(replica_));
+    
+    // Every entry arrives in order with the context it was published under
+    std::vector<IPCUpdate> updates(COUNT);
+    DrainResult result = IPCReader::readSince(0, updates, replica_);
+    ASSERT_EQ(result.count, COUNT);
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        uint32_t k = i + 1;
+        EXPECT_EQ(updates[i].position.step_count, k);
+        EXPECT_EQ(updates[i].position.latitude, 37.0 + k * 1e-5);
+        EXPECT_EQ(updates[i].position.context_id, k / 50 + 1);
+    }
+    
+    WorldState state;
+    ContextFrame context;
+    ASSERT_TRUE(IPCReader::readLatestState(state, context, replica_));
+    EXPECT_EQ(state.step_count, COUNT);
+    EXPECT_STREQ(context.road_name, "Road 10");
+}
+
+TEST_F(ReplicationTest, DetectsGapsTest) {
+    SharedMemoryOptions small;
+    small.ring_capacity = 64;
+    ASSERT_TRUE(source_.initializeServer(small));
+    ASSERT_TRUE(replica_.initializeServer());
+    
+    ReplicationReceiver receiver(io_, loopback(0), replica_);
+    ReplicationSender sender(io_, loopback(receiver.port()), {}, source_);
+    
+    for (uint32_t k = 1; k <= 10; ++k) publish(k);
+    sender.poll();
+    receive(receiver, 10);
+    
+    // The bridge stalls while 200 entries go through a 64-slot ring
+    for (uint32_t k = 11; k <= 210; ++k) publish(k);
+    sender.poll();
+    receive(receiver, 10 + 64);
+    
+    EXPECT_EQ(sender.stats().lapped, 200u - 64u);
+    EXPECT_EQ(receiver.stats().records, 10u + 64u);
+    EXPECT_EQ(receiver.stats().gaps, 200u - 64u);
+    EXPECT_EQ(receiver.stats().lost_packets, 0u);
+}
+
+TEST_F(ReplicationTest, DropsUnresolvedDeltasTest) {
+    SharedMemoryOptions small;
+    small.ring_capacity = 16;
+    ASSERT_TRUE(source_.initializeServer(small));
+    ASSERT_TRUE(replica_.initializeServer());
+    
+    ReplicationReceiver receiver(io_, loopback(0), replica_);
+    ReplicationSender sender(io_, loopback(receiver.port()), {}, source_);
+    publish(1);
+    sender.poll();
+    receive(receiver, 1);
+    
+    // Deltas 2-9 on base 1, a full record at 10 (chain limit), deltas 11-17 on it;
+    // entry 17 overwrites base 1 before the bridge reads 2-9
+    for (int64_t k = 2; k <= 17; ++k) {
+        IPCWriter::updateLocation(37.0 + k * 1e-5, -122.0, 0.0, 1000 + k, source_);
+    }
+    sender.poll();
+    receive(receiver, 1 + 8);
+    
+    EXPECT_EQ(sender.stats().unresolved, 8u);
+    EXPECT_EQ(sender.stats().records, 1u + 8u);
+    EXPECT_EQ(receiver.stats().records, 1u + 8u);
+    EXPECT_EQ(receiver.stats().gaps, 8u);
+    
+    // Nothing republished lost the base's fields
+    std::vector<IPCUpdate> updates(16);
+    DrainResult result = IPCReader::readSince(0, updates, replica_);
+    ASSERT_EQ(result.count, 9u);
+    for (size_t i = 0; i < result.count; ++i) {
+        EXPECT_EQ(updates[i].position.step_count, 1u) << "update " << i;
+    }
+    EXPECT_EQ(updates[8].position.latitude, 37.0 + 17 * 1e-5);
+}
+
+TEST_F(ReplicationTest, HoldsRecordsUntilTheirContextTest) {
+    ASSERT_TRUE(replica_.initializeServer());
+    ReplicationReceiver receiver(io_, loopback(0), replica_);
+    udp::socket socket(io_, udp::v4());
+    
+    auto send = [&](uint64_t packet_sequence, uint32_t context_id, const char* road,
+                    std::initializer_list<uint64_t> sequences) {
+        ReplicationPacketHeader header{};
+        header.magic = ReplicationPacketHeader::MAGIC;
+        header.version = ReplicationPacketHeader::VERSION;
+        header.layout_hash = sharedMemoryLayoutHash();
+        header.packet_sequence = packet_sequence;
+        header.context_id = context_id;
+        header.record_count = static_cast<uint32_t>(sequences.size());
+        header.flags = road ? ReplicationPacketHeader::FLAG_HAS_CONTEXT : 0;
+        
+        std::vector<char> datagram(reinterpret_cast<const char*>(&header),
+                                   reinterpret_cast<const char*>(&header) + sizeof(header));
+        if (road) {
+            ContextPayload payload{};
+            std::snprintf(payload.frame.road_name, sizeof(payload.frame.road_name), "%s", road);
+            const char* bytes = reinterpret_cast<const char*>(&payload);
+            datagram.insert(datagram.end(), bytes, bytes + sizeof(payload));
+        }
+        for (uint64_t sequence : sequences) {
+            ReplicationRecord record{};
+            record.sequence = sequence;
+            record.position.step_count = static_cast<uint32_t>(sequence);
+            record.position.context_id = context_id;
+            const char* bytes = reinterpret_cast<const char*>(&record);
+            datagram.insert(datagram.end(), bytes, bytes + sizeof(record));
+        }
+        socket.send_to(boost::asio::buffer(datagram), loopback(receiver.port()));
+    };
+    
+    // Context 2's first datagram is lost: entries 3-4 arrive without it, then it is resent
+    send(0, 1, "Road A", {1, 2});
+    send(2, 2, nullptr, {3, 4});
+    send(3, 2, "Road B", {5});
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (receiver.stats().packets < 3 && std::chrono::steady_clock::now() < deadline) {
+        receiver.poll(std::chrono::milliseconds(10));
+    }
+    
+    EXPECT_EQ(receiver.stats().records, 3u);
+    EXPECT_EQ(receiver.stats().gaps, 2u);
+    EXPECT_EQ(receiver.stats().lost_packets, 1u);
+    
+    std::vector<IPCUpdate> updates(8);
+    DrainResult result = IPCReader::readSince(0, updates, replica_);
+    ASSERT_EQ(result.count, 3u);
+    ContextPayload payload;
+    for (size_t i = 0; i < result.count; ++i) {
+        uint32_t step = updates[i].position.step_count;
+        ASSERT_TRUE(IPCReader::readContext(updates[i].position.context_id, payload, replica_));
+        EXPECT_STREQ(payload.frame.road_name, step <= 2 ? "Road A" : "Road B") << "entry " << step;
+    }
+    EXPECT_EQ(updates[2].position.step_count, 5u);
+}
+
+TEST_F(ReplicationTest, RejectsMalformedAndStaleDatagramsTest) {
+    ASSERT_TRUE(replica_.initializeServer());
+    ReplicationReceiver receiver(io_, loopback(0), replica_);
+    udp::socket socket(io_, udp::v4());
+    
+    const char garbage[] = "not a replication packet at all, just bytes";
+    socket.send_to(boost::asio::buffer(garbage, sizeof(garbage)), loopback(receiver.port()));
+    
+    // A well-formed packet, then the same packet again (duplicate)
+    struct {
+        ReplicationPacketHeader header;
+        ReplicationRecord record;
+    } packet{};
+    packet.header.magic = ReplicationPacketHeader::MAGIC;
+    packet.header.version = ReplicationPacketHeader::VERSION;
+    packet.header.layout_hash = sharedMemoryLayoutHash();
+    packet.header.packet_sequence = 0;
+    packet.header.record_count = 1;
+    packet.record.sequence = 7;
+    packet.record.position.step_count = 7;
+    socket.send_to(boost::asio::buffer(&packet, sizeof(packet)), loopback(receiver.port()));
+    packet.header.packet_sequence = 3;
+    socket.send_to(boost::asio::buffer(&packet, sizeof(packet)), loopback(receiver.port()));
+    
+    // Truncated: header claims more records than the datagram holds
+    packet.header.record_count = 2;
+    socket.send_to(boost::asio::buffer(&packet, sizeof(packet)), loopback(receiver.port()));
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (receiver.stats().packets + receiver.stats().malformed < 4 &&
+           std::chrono::steady_clock::now() < deadline) {
+        receiver.poll(std::chrono::milliseconds(10));
+    }
+    
+    EXPECT_EQ(receiver.stats().malformed, 2u);
+    EXPECT_EQ(receiver.stats().records, 1u);
+    EXPECT_EQ(receiver.stats().stale_records, 1u);
+    EXPECT_EQ(receiver.stats().lost_packets, 2u);
+    EXPECT_EQ(IPCReader::latestSequence(replica_), 1u);
+}
+
+TEST_F(ReplicationTest, TerminatesUnterminatedContextStringsTest) {
+    ASSERT_TRUE(replica_.initializeServer());
+    ReplicationReceiver receiver(io_, loopback(0), replica_);
+    udp::socket socket(io_, udp::v4());
+    
+    // Every string of the context filled to the last byte, with no NUL anywhere
+    struct {
+        ReplicationPacketHeader header;
+        ContextPayload payload;
+        ReplicationRecord record;
+    } packet{};
+    packet.header.magic = ReplicationPacketHeader::MAGIC;
+    packet.header.version = ReplicationPacketHeader::VERSION;
+    packet.header.layout_hash = sharedMemoryLayoutHash();
+    packet.header.context_id = 1;
+    packet.header.record_count = 1;
+    packet.header.flags = ReplicationPacketHeader::FLAG_HAS_CONTEXT;
+    std::memset(packet.payload.context_json, 'j', sizeof(packet.payload.context_json));
+    std::memset(packet.payload.frame.road_name, 'r', sizeof(packet.payload.frame.road_name));
+    std::memset(packet.payload.frame.road_type, 't', sizeof(packet.payload.frame.road_type));
+    std::memset(packet.payload.frame.traffic_level, 'l', sizeof(packet.payload.frame.traffic_level));
+    std::memset(packet.payload.frame.hazards, 'h', sizeof(packet.payload.frame.hazards));
+    packet.record.sequence = 1;
+    packet.record.position.context_id = 1;
+    socket.send_to(boost::asio::buffer(&packet, sizeof(packet)), loopback(receiver.port()));
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (receiver.stats().packets < 1 && std::chrono::steady_clock::now() < deadline) {
+        receiver.poll(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(receiver.stats().records, 1u);
+    
+    // Truncated by one byte each, not read past
+    uint32_t context_id = IPCReader::readLatestField(&PositionData::context_id, replica_).value_or(0);
+    ContextPayload payload;
+    ASSERT_TRUE(IPCReader::readContext(context_id, payload, replica_));
+    EXPECT_EQ(std::string_view(payload.context_json), std::string(sizeof(payload.context_json) - 1, 'j'));
+    EXPECT_EQ(std::string_view(payload.frame.road_name), std::string(sizeof(payload.frame.road_name) - 1, 'r'));
+    EXPECT_EQ(std::strlen(payload.frame.road_type), sizeof(payload.frame.road_type) - 1);
+    EXPECT_EQ(std::strlen(payload.frame.traffic_level), sizeof(payload.frame.traffic_level) - 1);
+    EXPECT_EQ(std::strlen(payload.frame.hazards), sizeof(payload.frame.hazards) - 1);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}